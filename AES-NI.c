@@ -1,22 +1,60 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #include <x86intrin.h>
 #include <wmmintrin.h>
 
-#define ENCRYPTION_UNIT_SIZE 16
-#define NUM_ROUNDS 10
+#include "AES.h"
+#include "fast_prng.h"
+#include "bench_harness.h"
 
-typedef struct {
-    __m128i sch_words[NUM_ROUNDS + 1];
-} aes_ctx_data;
+// Lets the library build compile this file without -march flags; the
+// dispatcher only binds it on CPUs that report these extensions.
+#pragma GCC target("aes,pclmul,ssse3,sse4.1")
+
+#define ENCRYPTION_UNIT_SIZE AES_BLOCK_SIZE
+#define PIPELINE_DEPTH 8
+
+// Bulk kernels are written once as always-inlined bodies whose last parameter
+// is the round count. AES_KERNEL_FAMILY stamps out a _128/_192/_256 copy of a
+// body with that parameter fixed to a literal, so each copy has a fully
+// unrolled round loop and no key-size branch. AES_KERNEL_DISPATCH chooses the
+// copy once per call.
+#define AES_KERNEL static inline __attribute__((always_inline))
+#define AES_UNPACK(...) __VA_ARGS__
+#define AES_KERNEL_FAMILY(name, params, args) \
+    static void name##_128 params { name##_body(AES_UNPACK args, AES128_ROUNDS); } \
+    static void name##_192 params { name##_body(AES_UNPACK args, AES192_ROUNDS); } \
+    static void name##_256 params { name##_body(AES_UNPACK args, AES256_ROUNDS); }
+#define AES_KERNEL_DISPATCH(context, name, ...) \
+    do { \
+        switch ((context)->num_rounds) { \
+        case AES192_ROUNDS: name##_192(__VA_ARGS__); break; \
+        case AES256_ROUNDS: name##_256(__VA_ARGS__); break; \
+        default: name##_128(__VA_ARGS__); break; \
+        } \
+    } while (0)
+
+static void derive_inverse_schedule(aes_ctx_data *context) {
+    const int num_rounds = context->num_rounds;
+    context->dec_words[0] = context->sch_words[num_rounds];
+    for (int round_idx = 1; round_idx < num_rounds; ++round_idx) {
+        context->dec_words[round_idx] = _mm_aesimc_si128(context->sch_words[num_rounds - round_idx]);
+    }
+    context->dec_words[num_rounds] = context->sch_words[0];
+}
 
 void generate_schedule(const uint8_t *secret_key, aes_ctx_data *context) {
     __m128i k_reg, temp_reg;
     k_reg = _mm_loadu_si128((const __m128i*)secret_key);
     context->sch_words[0] = k_reg;
+    context->num_rounds = AES128_ROUNDS;
 
     #define KEY_ASSIST_HELPER(rcon_val) \
         temp_reg = _mm_aeskeygenassist_si128(k_reg, rcon_val); \
@@ -38,18 +76,128 @@ void generate_schedule(const uint8_t *secret_key, aes_ctx_data *context) {
     KEY_ASSIST_HELPER(0x36); context->sch_words[10] = k_reg;
 
     #undef KEY_ASSIST_HELPER
+
+    derive_inverse_schedule(context);
 }
 
-static inline void process_block(aes_ctx_data *context, uint8_t *data_ptr) {
-    __m128i data_reg = _mm_loadu_si128((__m128i*)data_ptr);
+// AES-192 produces six schedule words per step, i.e. one and a half round
+// keys, so every other round key is stitched from two registers.
+void generate_schedule_192(const uint8_t *secret_key, aes_ctx_data *context) {
+    __m128i k_low, k_high, temp_reg;
+    k_low = _mm_loadu_si128((const __m128i*)secret_key);
+    k_high = _mm_loadl_epi64((const __m128i*)(secret_key + 16));
+    context->sch_words[0] = k_low;
+    context->sch_words[1] = k_high;
+    context->num_rounds = AES192_ROUNDS;
+
+    #define KEY_192_ASSIST(rcon_val) \
+        temp_reg = _mm_aeskeygenassist_si128(k_high, rcon_val); \
+        temp_reg = _mm_shuffle_epi32(temp_reg, 0x55); \
+        k_low = _mm_xor_si128(k_low, _mm_slli_si128(k_low, 0x4)); \
+        k_low = _mm_xor_si128(k_low, _mm_slli_si128(k_low, 0x4)); \
+        k_low = _mm_xor_si128(k_low, _mm_slli_si128(k_low, 0x4)); \
+        k_low = _mm_xor_si128(k_low, temp_reg); \
+        temp_reg = _mm_shuffle_epi32(k_low, 0xFF); \
+        k_high = _mm_xor_si128(k_high, _mm_slli_si128(k_high, 0x4)); \
+        k_high = _mm_xor_si128(k_high, temp_reg);
+    #define STITCH_64(low_src, high_src, imm) \
+        _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(low_src), _mm_castsi128_pd(high_src), imm))
+
+    KEY_192_ASSIST(0x01);
+    context->sch_words[1] = STITCH_64(context->sch_words[1], k_low, 0);
+    context->sch_words[2] = STITCH_64(k_low, k_high, 1);
+    KEY_192_ASSIST(0x02); context->sch_words[3] = k_low; context->sch_words[4] = k_high;
+    KEY_192_ASSIST(0x04);
+    context->sch_words[4] = STITCH_64(context->sch_words[4], k_low, 0);
+    context->sch_words[5] = STITCH_64(k_low, k_high, 1);
+    KEY_192_ASSIST(0x08); context->sch_words[6] = k_low; context->sch_words[7] = k_high;
+    KEY_192_ASSIST(0x10);
+    context->sch_words[7] = STITCH_64(context->sch_words[7], k_low, 0);
+    context->sch_words[8] = STITCH_64(k_low, k_high, 1);
+    KEY_192_ASSIST(0x20); context->sch_words[9] = k_low; context->sch_words[10] = k_high;
+    KEY_192_ASSIST(0x40);
+    context->sch_words[10] = STITCH_64(context->sch_words[10], k_low, 0);
+    context->sch_words[11] = STITCH_64(k_low, k_high, 1);
+    KEY_192_ASSIST(0x80); context->sch_words[12] = k_low;
+
+    #undef STITCH_64
+    #undef KEY_192_ASSIST
+
+    derive_inverse_schedule(context);
+}
+
+void generate_schedule_256(const uint8_t *secret_key, aes_ctx_data *context) {
+    __m128i k_low, k_high, temp_reg;
+    k_low = _mm_loadu_si128((const __m128i*)secret_key);
+    k_high = _mm_loadu_si128((const __m128i*)(secret_key + 16));
+    context->sch_words[0] = k_low;
+    context->sch_words[1] = k_high;
+    context->num_rounds = AES256_ROUNDS;
+
+    #define KEY_256_ASSIST_EVEN(rcon_val) \
+        temp_reg = _mm_aeskeygenassist_si128(k_high, rcon_val); \
+        temp_reg = _mm_shuffle_epi32(temp_reg, 0xFF); \
+        k_low = _mm_xor_si128(k_low, _mm_slli_si128(k_low, 0x4)); \
+        k_low = _mm_xor_si128(k_low, _mm_slli_si128(k_low, 0x4)); \
+        k_low = _mm_xor_si128(k_low, _mm_slli_si128(k_low, 0x4)); \
+        k_low = _mm_xor_si128(k_low, temp_reg);
+    #define KEY_256_ASSIST_ODD() \
+        temp_reg = _mm_aeskeygenassist_si128(k_low, 0x00); \
+        temp_reg = _mm_shuffle_epi32(temp_reg, 0xAA); \
+        k_high = _mm_xor_si128(k_high, _mm_slli_si128(k_high, 0x4)); \
+        k_high = _mm_xor_si128(k_high, _mm_slli_si128(k_high, 0x4)); \
+        k_high = _mm_xor_si128(k_high, _mm_slli_si128(k_high, 0x4)); \
+        k_high = _mm_xor_si128(k_high, temp_reg);
+
+    KEY_256_ASSIST_EVEN(0x01); context->sch_words[2] = k_low;
+    KEY_256_ASSIST_ODD();      context->sch_words[3] = k_high;
+    KEY_256_ASSIST_EVEN(0x02); context->sch_words[4] = k_low;
+    KEY_256_ASSIST_ODD();      context->sch_words[5] = k_high;
+    KEY_256_ASSIST_EVEN(0x04); context->sch_words[6] = k_low;
+    KEY_256_ASSIST_ODD();      context->sch_words[7] = k_high;
+    KEY_256_ASSIST_EVEN(0x08); context->sch_words[8] = k_low;
+    KEY_256_ASSIST_ODD();      context->sch_words[9] = k_high;
+    KEY_256_ASSIST_EVEN(0x10); context->sch_words[10] = k_low;
+    KEY_256_ASSIST_ODD();      context->sch_words[11] = k_high;
+    KEY_256_ASSIST_EVEN(0x20); context->sch_words[12] = k_low;
+    KEY_256_ASSIST_ODD();      context->sch_words[13] = k_high;
+    KEY_256_ASSIST_EVEN(0x40); context->sch_words[14] = k_low;
+
+    #undef KEY_256_ASSIST_ODD
+    #undef KEY_256_ASSIST_EVEN
+
+    derive_inverse_schedule(context);
+}
+
+// Expands a 128-, 192- or 256-bit key. Returns 0 on success, -1 for any
+// other key size.
+int aes_expand_key(const uint8_t *secret_key, int key_bits, aes_ctx_data *context) {
+    switch (key_bits) {
+    case 128: generate_schedule(secret_key, context); return 0;
+    case 192: generate_schedule_192(secret_key, context); return 0;
+    case 256: generate_schedule_256(secret_key, context); return 0;
+    default: return -1;
+    }
+}
+
+AES_KERNEL __m128i encrypt_lane_rounds(const aes_ctx_data *context, __m128i data_reg, const int num_rounds) {
     data_reg = _mm_xor_si128(data_reg, context->sch_words[0]);
 
     int round_idx;
-    for (round_idx = 1; round_idx < NUM_ROUNDS; ++round_idx) {
+    for (round_idx = 1; round_idx < num_rounds; ++round_idx) {
         data_reg = _mm_aesenc_si128(data_reg, context->sch_words[round_idx]);
     }
     
-    data_reg = _mm_aesenclast_si128(data_reg, context->sch_words[NUM_ROUNDS]);
+    return _mm_aesenclast_si128(data_reg, context->sch_words[num_rounds]);
+}
+
+static inline __m128i encrypt_lane(const aes_ctx_data *context, __m128i data_reg) {
+    return encrypt_lane_rounds(context, data_reg, context->num_rounds);
+}
+
+static inline void process_block(aes_ctx_data *context, uint8_t *data_ptr) {
+    __m128i data_reg = _mm_loadu_si128((__m128i*)data_ptr);
+    data_reg = encrypt_lane(context, data_reg);
     _mm_storeu_si128((__m128i*)data_ptr, data_reg);
 }
 
@@ -60,41 +208,1842 @@ void process_data_buffer(aes_ctx_data *context, uint8_t *data_buffer, size_t buf
     }
 }
 
-static uint32_t prng_state = 123456789;
-uint32_t prng_next() {
-    prng_state = (1103515245 * prng_state + 12345) & 0x7fffffff;
-    return prng_state;
+// Applies one AES round instruction to all PIPELINE_DEPTH lanes. The lanes are
+// independent, so the aesenc latency of one block is hidden behind the others.
+#define AES_ROUND_X8(op, lanes, round_key) \
+    lanes[0] = op(lanes[0], round_key); \
+    lanes[1] = op(lanes[1], round_key); \
+    lanes[2] = op(lanes[2], round_key); \
+    lanes[3] = op(lanes[3], round_key); \
+    lanes[4] = op(lanes[4], round_key); \
+    lanes[5] = op(lanes[5], round_key); \
+    lanes[6] = op(lanes[6], round_key); \
+    lanes[7] = op(lanes[7], round_key);
+
+AES_KERNEL void encrypt_lanes_x8(const aes_ctx_data *context, __m128i lanes[PIPELINE_DEPTH], const int num_rounds) {
+    AES_ROUND_X8(_mm_xor_si128, lanes, context->sch_words[0]);
+
+    int round_idx;
+    #pragma GCC unroll 14
+    for (round_idx = 1; round_idx < num_rounds; ++round_idx) {
+        AES_ROUND_X8(_mm_aesenc_si128, lanes, context->sch_words[round_idx]);
+    }
+
+    AES_ROUND_X8(_mm_aesenclast_si128, lanes, context->sch_words[num_rounds]);
+}
+
+AES_KERNEL void process_blocks_x8(const aes_ctx_data *context, uint8_t *data_ptr, const int num_rounds) {
+    __m128i lanes[PIPELINE_DEPTH];
+    for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+        lanes[lane] = _mm_loadu_si128((const __m128i*)(data_ptr + lane * ENCRYPTION_UNIT_SIZE));
+    }
+
+    encrypt_lanes_x8(context, lanes, num_rounds);
+
+    for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+        _mm_storeu_si128((__m128i*)(data_ptr + lane * ENCRYPTION_UNIT_SIZE), lanes[lane]);
+    }
+}
+
+AES_KERNEL void ecb_pipelined_body(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length,
+                                   const int num_rounds) {
+    const size_t stride = PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+    size_t block_offset = 0;
+    for (; block_offset + stride <= buffer_length; block_offset += stride) {
+        process_blocks_x8(context, data_buffer + block_offset, num_rounds);
+    }
+    for (; block_offset < buffer_length; block_offset += ENCRYPTION_UNIT_SIZE) {
+        __m128i data_reg = _mm_loadu_si128((const __m128i*)(data_buffer + block_offset));
+        _mm_storeu_si128((__m128i*)(data_buffer + block_offset),
+                         encrypt_lane_rounds(context, data_reg, num_rounds));
+    }
+}
+
+AES_KERNEL_FAMILY(ecb_pipelined,
+                  (const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length),
+                  (context, data_buffer, buffer_length))
+
+// Same result as process_data_buffer, but keeps PIPELINE_DEPTH blocks in flight
+// and finishes the leftover tail one block at a time.
+void process_data_buffer_pipelined(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length) {
+    AES_KERNEL_DISPATCH(context, ecb_pipelined, context, data_buffer, buffer_length);
+}
+
+AES_KERNEL __m128i decrypt_lane_rounds(const aes_ctx_data *context, __m128i data_reg, const int num_rounds) {
+    data_reg = _mm_xor_si128(data_reg, context->dec_words[0]);
+
+    int round_idx;
+    for (round_idx = 1; round_idx < num_rounds; ++round_idx) {
+        data_reg = _mm_aesdec_si128(data_reg, context->dec_words[round_idx]);
+    }
+
+    return _mm_aesdeclast_si128(data_reg, context->dec_words[num_rounds]);
+}
+
+static inline __m128i decrypt_lane(const aes_ctx_data *context, __m128i data_reg) {
+    return decrypt_lane_rounds(context, data_reg, context->num_rounds);
+}
+
+AES_KERNEL void decrypt_lanes_x8(const aes_ctx_data *context, __m128i lanes[PIPELINE_DEPTH], const int num_rounds) {
+    AES_ROUND_X8(_mm_xor_si128, lanes, context->dec_words[0]);
+
+    int round_idx;
+    #pragma GCC unroll 14
+    for (round_idx = 1; round_idx < num_rounds; ++round_idx) {
+        AES_ROUND_X8(_mm_aesdec_si128, lanes, context->dec_words[round_idx]);
+    }
+
+    AES_ROUND_X8(_mm_aesdeclast_si128, lanes, context->dec_words[num_rounds]);
+}
+
+// One block at a time; the decryption counterpart of process_data_buffer.
+void process_data_buffer_decrypt(aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length) {
+    for (size_t block_offset = 0; block_offset < buffer_length; block_offset += ENCRYPTION_UNIT_SIZE) {
+        __m128i data_reg = _mm_loadu_si128((const __m128i*)(data_buffer + block_offset));
+        _mm_storeu_si128((__m128i*)(data_buffer + block_offset), decrypt_lane(context, data_reg));
+    }
+}
+
+AES_KERNEL void ecb_decrypt_pipelined_body(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length,
+                                           const int num_rounds) {
+    const size_t stride = PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+    size_t block_offset = 0;
+    for (; block_offset + stride <= buffer_length; block_offset += stride) {
+        __m128i lanes[PIPELINE_DEPTH];
+        for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+            lanes[lane] = _mm_loadu_si128((const __m128i*)(data_buffer + block_offset + lane * ENCRYPTION_UNIT_SIZE));
+        }
+        decrypt_lanes_x8(context, lanes, num_rounds);
+        for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+            _mm_storeu_si128((__m128i*)(data_buffer + block_offset + lane * ENCRYPTION_UNIT_SIZE), lanes[lane]);
+        }
+    }
+    for (; block_offset < buffer_length; block_offset += ENCRYPTION_UNIT_SIZE) {
+        __m128i data_reg = _mm_loadu_si128((const __m128i*)(data_buffer + block_offset));
+        _mm_storeu_si128((__m128i*)(data_buffer + block_offset),
+                         decrypt_lane_rounds(context, data_reg, num_rounds));
+    }
+}
+
+AES_KERNEL_FAMILY(ecb_decrypt_pipelined,
+                  (const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length),
+                  (context, data_buffer, buffer_length))
+
+void process_data_buffer_decrypt_pipelined(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length) {
+    AES_KERNEL_DISPATCH(context, ecb_decrypt_pipelined, context, data_buffer, buffer_length);
+}
+
+// CBC works in place on whole blocks. `iv` is updated to the last ciphertext
+// block so a long message can be processed in several calls. Encryption is
+// inherently serial; decryption has no chain dependency and runs
+// PIPELINE_DEPTH blocks at a time.
+void aes_cbc_encrypt(const aes_ctx_data *context, uint8_t *iv, uint8_t *data_buffer, size_t buffer_length) {
+    __m128i chain = _mm_loadu_si128((const __m128i*)iv);
+    for (size_t block_offset = 0; block_offset < buffer_length; block_offset += ENCRYPTION_UNIT_SIZE) {
+        __m128i data_reg = _mm_loadu_si128((const __m128i*)(data_buffer + block_offset));
+        chain = encrypt_lane(context, _mm_xor_si128(data_reg, chain));
+        _mm_storeu_si128((__m128i*)(data_buffer + block_offset), chain);
+    }
+    _mm_storeu_si128((__m128i*)iv, chain);
+}
+
+AES_KERNEL void cbc_decrypt_body(const aes_ctx_data *context, uint8_t *iv, uint8_t *data_buffer,
+                                 size_t buffer_length, const int num_rounds) {
+    const size_t stride = PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+    __m128i chain = _mm_loadu_si128((const __m128i*)iv);
+    size_t block_offset = 0;
+
+    for (; block_offset + stride <= buffer_length; block_offset += stride) {
+        __m128i lanes[PIPELINE_DEPTH], cipher[PIPELINE_DEPTH];
+        for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+            cipher[lane] = _mm_loadu_si128((const __m128i*)(data_buffer + block_offset + lane * ENCRYPTION_UNIT_SIZE));
+            lanes[lane] = cipher[lane];
+        }
+        decrypt_lanes_x8(context, lanes, num_rounds);
+        _mm_storeu_si128((__m128i*)(data_buffer + block_offset), _mm_xor_si128(lanes[0], chain));
+        for (int lane = 1; lane < PIPELINE_DEPTH; ++lane) {
+            _mm_storeu_si128((__m128i*)(data_buffer + block_offset + lane * ENCRYPTION_UNIT_SIZE),
+                             _mm_xor_si128(lanes[lane], cipher[lane - 1]));
+        }
+        chain = cipher[PIPELINE_DEPTH - 1];
+    }
+    for (; block_offset < buffer_length; block_offset += ENCRYPTION_UNIT_SIZE) {
+        __m128i cipher = _mm_loadu_si128((const __m128i*)(data_buffer + block_offset));
+        _mm_storeu_si128((__m128i*)(data_buffer + block_offset),
+                         _mm_xor_si128(decrypt_lane_rounds(context, cipher, num_rounds), chain));
+        chain = cipher;
+    }
+    _mm_storeu_si128((__m128i*)iv, chain);
+}
+
+AES_KERNEL_FAMILY(cbc_decrypt,
+                  (const aes_ctx_data *context, uint8_t *iv, uint8_t *data_buffer, size_t buffer_length),
+                  (context, iv, data_buffer, buffer_length))
+
+void aes_cbc_decrypt(const aes_ctx_data *context, uint8_t *iv, uint8_t *data_buffer, size_t buffer_length) {
+    AES_KERNEL_DISPATCH(context, cbc_decrypt, context, iv, data_buffer, buffer_length);
+}
+
+// Counter mode (aes_ctr_state is declared in AES.h).
+
+static inline uint64_t load_be64(const uint8_t *src) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) value = (value << 8) | src[i];
+    return value;
+}
+
+static inline __m128i byte_swap_128(__m128i value) {
+    const __m128i byte_swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(value, byte_swap);
+}
+
+static inline __m128i ctr_next_block(aes_ctr_state *state) {
+    __m128i block = byte_swap_128(_mm_set_epi64x((long long)state->counter_hi,
+                                                 (long long)state->counter_lo));
+    if (++state->counter_lo == 0) {
+        ++state->counter_hi;
+    }
+    return block;
+}
+
+void aes_ctr_init(aes_ctr_state *state, const aes_ctx_data *context, const uint8_t *initial_counter) {
+    state->context = context;
+    state->counter_hi = load_be64(initial_counter);
+    state->counter_lo = load_be64(initial_counter + 8);
+    state->keystream_used = ENCRYPTION_UNIT_SIZE;
+}
+
+AES_KERNEL void ctr_update_body(aes_ctr_state *state, const uint8_t *input, uint8_t *output, size_t length,
+                                const int num_rounds) {
+    const aes_ctx_data *context = state->context;
+
+    while (length > 0 && state->keystream_used < ENCRYPTION_UNIT_SIZE) {
+        *output++ = *input++ ^ state->keystream[state->keystream_used++];
+        length--;
+    }
+
+    while (length >= PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE) {
+        __m128i lanes[PIPELINE_DEPTH];
+        for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+            lanes[lane] = ctr_next_block(state);
+        }
+
+        encrypt_lanes_x8(context, lanes, num_rounds);
+
+        for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+            __m128i data_reg = _mm_loadu_si128((const __m128i*)(input + lane * ENCRYPTION_UNIT_SIZE));
+            _mm_storeu_si128((__m128i*)(output + lane * ENCRYPTION_UNIT_SIZE),
+                             _mm_xor_si128(data_reg, lanes[lane]));
+        }
+        input += PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+        output += PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+        length -= PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+    }
+
+    while (length >= ENCRYPTION_UNIT_SIZE) {
+        __m128i key_reg = encrypt_lane_rounds(context, ctr_next_block(state), num_rounds);
+        __m128i data_reg = _mm_loadu_si128((const __m128i*)input);
+        _mm_storeu_si128((__m128i*)output, _mm_xor_si128(data_reg, key_reg));
+        input += ENCRYPTION_UNIT_SIZE;
+        output += ENCRYPTION_UNIT_SIZE;
+        length -= ENCRYPTION_UNIT_SIZE;
+    }
+
+    if (length > 0) {
+        _mm_storeu_si128((__m128i*)state->keystream, encrypt_lane_rounds(context, ctr_next_block(state), num_rounds));
+        state->keystream_used = 0;
+        while (length > 0) {
+            *output++ = *input++ ^ state->keystream[state->keystream_used++];
+            length--;
+        }
+    }
+}
+
+AES_KERNEL_FAMILY(ctr_update,
+                  (aes_ctr_state *state, const uint8_t *input, uint8_t *output, size_t length),
+                  (state, input, output, length))
+
+// VAES (AVX-512) kernels. Each zmm register carries four independent blocks
+// and VAES_LANES registers are kept in flight, so one loop iteration covers
+// VAES_BLOCKS blocks with the same round-key-major ordering as the 128-bit
+// x8 path. The round keys are broadcast to all four 128-bit lanes once per
+// call. These functions must only run when aes_ni_select_kernels() has been
+// told the CPU supports VAES with AVX-512F/BW.
+#define VAES_TARGET __attribute__((target("vaes,avx512f,avx512bw")))
+#define VAES_KERNEL static inline __attribute__((always_inline)) VAES_TARGET
+#define VAES_LANES 8
+#define VAES_BLOCKS (VAES_LANES * 4)
+#define VAES_STRIDE (VAES_BLOCKS * ENCRYPTION_UNIT_SIZE)
+#define VAES_KERNEL_FAMILY(name, params, args) \
+    VAES_TARGET static void name##_128 params { name##_body(AES_UNPACK args, AES128_ROUNDS); } \
+    VAES_TARGET static void name##_192 params { name##_body(AES_UNPACK args, AES192_ROUNDS); } \
+    VAES_TARGET static void name##_256 params { name##_body(AES_UNPACK args, AES256_ROUNDS); }
+
+static int use_vaes_kernels;
+
+VAES_KERNEL void vaes_broadcast_schedule(const __m128i *schedule, __m512i *round_keys, const int num_rounds) {
+    for (int round_idx = 0; round_idx <= num_rounds; ++round_idx) {
+        round_keys[round_idx] = _mm512_broadcast_i32x4(schedule[round_idx]);
+    }
 }
+
+// AES_ROUND_X8 works on zmm lanes unchanged; VAES_LANES matches its width.
+VAES_KERNEL void vaes_encrypt_x8(const __m512i *round_keys, __m512i lanes[VAES_LANES], const int num_rounds) {
+    AES_ROUND_X8(_mm512_xor_si512, lanes, round_keys[0]);
+
+    int round_idx;
+    #pragma GCC unroll 14
+    for (round_idx = 1; round_idx < num_rounds; ++round_idx) {
+        AES_ROUND_X8(_mm512_aesenc_epi128, lanes, round_keys[round_idx]);
+    }
+
+    AES_ROUND_X8(_mm512_aesenclast_epi128, lanes, round_keys[num_rounds]);
+}
+
+VAES_KERNEL void vaes_decrypt_x8(const __m512i *round_keys, __m512i lanes[VAES_LANES], const int num_rounds) {
+    AES_ROUND_X8(_mm512_xor_si512, lanes, round_keys[0]);
+
+    int round_idx;
+    #pragma GCC unroll 14
+    for (round_idx = 1; round_idx < num_rounds; ++round_idx) {
+        AES_ROUND_X8(_mm512_aesdec_epi128, lanes, round_keys[round_idx]);
+    }
+
+    AES_ROUND_X8(_mm512_aesdeclast_epi128, lanes, round_keys[num_rounds]);
+}
+
+VAES_KERNEL __m512i vaes_crypt_x1(const __m512i *round_keys, __m512i lane, const int num_rounds, const int decrypt) {
+    lane = _mm512_xor_si512(lane, round_keys[0]);
+    #pragma GCC unroll 14
+    for (int round_idx = 1; round_idx < num_rounds; ++round_idx) {
+        lane = decrypt ? _mm512_aesdec_epi128(lane, round_keys[round_idx])
+                       : _mm512_aesenc_epi128(lane, round_keys[round_idx]);
+    }
+    return decrypt ? _mm512_aesdeclast_epi128(lane, round_keys[num_rounds])
+                   : _mm512_aesenclast_epi128(lane, round_keys[num_rounds]);
+}
+
+// Whole VAES_STRIDE groups first, then single zmm groups of four blocks, then
+// the last one to three blocks through the 128-bit lane.
+VAES_KERNEL void ecb_vaes_common(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length,
+                                 const int num_rounds, const int decrypt) {
+    const __m128i *schedule = decrypt ? context->dec_words : context->sch_words;
+    __m512i round_keys[MAX_ROUNDS + 1];
+    size_t block_offset = 0;
+
+    vaes_broadcast_schedule(schedule, round_keys, num_rounds);
+
+    for (; block_offset + VAES_STRIDE <= buffer_length; block_offset += VAES_STRIDE) {
+        __m512i lanes[VAES_LANES];
+        for (int lane = 0; lane < VAES_LANES; ++lane) {
+            lanes[lane] = _mm512_loadu_si512(data_buffer + block_offset + 64 * lane);
+        }
+        if (decrypt) {
+            vaes_decrypt_x8(round_keys, lanes, num_rounds);
+        } else {
+            vaes_encrypt_x8(round_keys, lanes, num_rounds);
+        }
+        for (int lane = 0; lane < VAES_LANES; ++lane) {
+            _mm512_storeu_si512(data_buffer + block_offset + 64 * lane, lanes[lane]);
+        }
+    }
+    for (; block_offset + 64 <= buffer_length; block_offset += 64) {
+        __m512i lane = _mm512_loadu_si512(data_buffer + block_offset);
+        _mm512_storeu_si512(data_buffer + block_offset, vaes_crypt_x1(round_keys, lane, num_rounds, decrypt));
+    }
+    for (; block_offset < buffer_length; block_offset += ENCRYPTION_UNIT_SIZE) {
+        __m128i data_reg = _mm_loadu_si128((const __m128i*)(data_buffer + block_offset));
+        data_reg = decrypt ? decrypt_lane_rounds(context, data_reg, num_rounds)
+                           : encrypt_lane_rounds(context, data_reg, num_rounds);
+        _mm_storeu_si128((__m128i*)(data_buffer + block_offset), data_reg);
+    }
+}
+
+VAES_KERNEL void ecb_vaes_body(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length,
+                               const int num_rounds) {
+    ecb_vaes_common(context, data_buffer, buffer_length, num_rounds, 0);
+}
+
+VAES_KERNEL void ecb_decrypt_vaes_body(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length,
+                                       const int num_rounds) {
+    ecb_vaes_common(context, data_buffer, buffer_length, num_rounds, 1);
+}
+
+VAES_KERNEL_FAMILY(ecb_vaes,
+                   (const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length),
+                   (context, data_buffer, buffer_length))
+VAES_KERNEL_FAMILY(ecb_decrypt_vaes,
+                   (const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length),
+                   (context, data_buffer, buffer_length))
+
+void process_data_buffer_vaes(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length) {
+    AES_KERNEL_DISPATCH(context, ecb_vaes, context, data_buffer, buffer_length);
+}
+
+void process_data_buffer_decrypt_vaes(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length) {
+    AES_KERNEL_DISPATCH(context, ecb_decrypt_vaes, context, data_buffer, buffer_length);
+}
+
+// Counter blocks for one stride are built in the host-order layout, four per
+// zmm, and byte-swapped per 128-bit lane. The vector add does not carry from
+// counter_lo into counter_hi, so a stride that would wrap counter_lo is left
+// to the 128-bit body, which handles the carry.
+VAES_KERNEL void ctr_vaes_body(aes_ctr_state *state, const uint8_t *input, uint8_t *output, size_t length,
+                               const int num_rounds) {
+    const __m512i byte_swap = _mm512_broadcast_i32x4(
+        _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    const __m512i lane_step = _mm512_set_epi64(0, 4, 0, 4, 0, 4, 0, 4);
+    __m512i round_keys[MAX_ROUNDS + 1];
+
+    while (length > 0 && state->keystream_used < ENCRYPTION_UNIT_SIZE) {
+        *output++ = *input++ ^ state->keystream[state->keystream_used++];
+        length--;
+    }
+
+    vaes_broadcast_schedule(state->context->sch_words, round_keys, num_rounds);
+
+    while (length >= VAES_STRIDE && state->counter_lo <= UINT64_MAX - VAES_BLOCKS) {
+        __m512i counters = _mm512_add_epi64(
+            _mm512_broadcast_i32x4(_mm_set_epi64x((long long)state->counter_hi, (long long)state->counter_lo)),
+            _mm512_set_epi64(0, 3, 0, 2, 0, 1, 0, 0));
+        __m512i lanes[VAES_LANES];
+        for (int lane = 0; lane < VAES_LANES; ++lane) {
+            lanes[lane] = _mm512_shuffle_epi8(counters, byte_swap);
+            counters = _mm512_add_epi64(counters, lane_step);
+        }
+        state->counter_lo += VAES_BLOCKS;
+
+        vaes_encrypt_x8(round_keys, lanes, num_rounds);
+
+        for (int lane = 0; lane < VAES_LANES; ++lane) {
+            __m512i data_reg = _mm512_loadu_si512(input + 64 * lane);
+            _mm512_storeu_si512(output + 64 * lane, _mm512_xor_si512(data_reg, lanes[lane]));
+        }
+        input += VAES_STRIDE;
+        output += VAES_STRIDE;
+        length -= VAES_STRIDE;
+    }
+
+    ctr_update_body(state, input, output, length, num_rounds);
+}
+
+VAES_KERNEL_FAMILY(ctr_vaes,
+                   (aes_ctr_state *state, const uint8_t *input, uint8_t *output, size_t length),
+                   (state, input, output, length))
+
+// Same contract as aes_ctr_update, always on the VAES kernel.
+void aes_ctr_update_vaes(aes_ctr_state *state, const uint8_t *input, uint8_t *output, size_t length) {
+    AES_KERNEL_DISPATCH(state->context, ctr_vaes, state, input, output, length);
+}
+
+// Routes aes_ctr_update and the parallel ECB/CTR chunk kernels to the VAES
+// kernels. Called by the dispatcher after CPUID; pass 0 to force the 128-bit
+// path.
+void aes_ni_select_kernels(int has_vaes) {
+    use_vaes_kernels = has_vaes;
+}
+
+// Encrypts or decrypts `length` bytes. Calls may be split at any byte
+// boundary: unused keystream from a partial block carries over to the next call.
+// `input` and `output` may point to the same buffer.
+void aes_ctr_update(aes_ctr_state *state, const uint8_t *input, uint8_t *output, size_t length) {
+    if (use_vaes_kernels && length >= VAES_STRIDE) {
+        aes_ctr_update_vaes(state, input, output, length);
+        return;
+    }
+    AES_KERNEL_DISPATCH(state->context, ctr_update, state, input, output, length);
+}
+
+// GCM. GHASH values are kept byte-reversed in registers, which lets
+// PCLMULQDQ work on them directly; the product is then shifted left by one
+// bit and reduced modulo x^128 + x^7 + x^2 + x + 1 (Intel GCM white paper).
+_Static_assert(AES_GCM_HASH_POWERS == PIPELINE_DEPTH, "one hash power per pipeline lane");
+
+static inline void clmul_accumulate(__m128i a, __m128i b, __m128i *lo, __m128i *mid, __m128i *hi) {
+    *lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+    *hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+    *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(a, b, 0x10));
+    *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(a, b, 0x01));
+}
+
+static inline __m128i ghash_reduce(__m128i lo, __m128i mid, __m128i hi) {
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    __m128i lo_carry = _mm_srli_epi32(lo, 31);
+    __m128i hi_carry = _mm_srli_epi32(hi, 31);
+    __m128i cross_carry = _mm_srli_si128(lo_carry, 12);
+    lo = _mm_or_si128(_mm_slli_epi32(lo, 1), _mm_slli_si128(lo_carry, 4));
+    hi = _mm_or_si128(_mm_slli_epi32(hi, 1), _mm_slli_si128(hi_carry, 4));
+    hi = _mm_or_si128(hi, cross_carry);
+
+    __m128i fold = _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30));
+    fold = _mm_xor_si128(fold, _mm_slli_epi32(lo, 25));
+    __m128i fold_high = _mm_srli_si128(fold, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(fold, 12));
+
+    __m128i shifted = _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2));
+    shifted = _mm_xor_si128(shifted, _mm_srli_epi32(lo, 7));
+    shifted = _mm_xor_si128(shifted, fold_high);
+    lo = _mm_xor_si128(lo, shifted);
+    return _mm_xor_si128(hi, lo);
+}
+
+static inline __m128i gf_multiply(__m128i a, __m128i b) {
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    clmul_accumulate(a, b, &lo, &mid, &hi);
+    return ghash_reduce(lo, mid, hi);
+}
+
+// Folds PIPELINE_DEPTH blocks into the accumulator with a single reduction:
+// acc = (acc ^ B0)*H^8 ^ B1*H^7 ^ ... ^ B7*H.
+static inline __m128i ghash_fold_x8(const aes_gcm_key *key, __m128i hash_acc, const __m128i blocks[PIPELINE_DEPTH]) {
+    __m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+    clmul_accumulate(_mm_xor_si128(hash_acc, byte_swap_128(blocks[0])),
+                     key->hash_powers[PIPELINE_DEPTH - 1], &lo, &mid, &hi);
+    for (int lane = 1; lane < PIPELINE_DEPTH; ++lane) {
+        clmul_accumulate(byte_swap_128(blocks[lane]), key->hash_powers[PIPELINE_DEPTH - 1 - lane],
+                         &lo, &mid, &hi);
+    }
+    return ghash_reduce(lo, mid, hi);
+}
+
+// Hashes `length` bytes; a trailing partial block is zero-padded.
+static __m128i ghash_update(const aes_gcm_key *key, __m128i hash_acc, const uint8_t *data, size_t length) {
+    while (length >= PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE) {
+        __m128i blocks[PIPELINE_DEPTH];
+        for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+            blocks[lane] = _mm_loadu_si128((const __m128i*)(data + lane * ENCRYPTION_UNIT_SIZE));
+        }
+        hash_acc = ghash_fold_x8(key, hash_acc, blocks);
+        data += PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+        length -= PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+    }
+    while (length >= ENCRYPTION_UNIT_SIZE) {
+        __m128i block = byte_swap_128(_mm_loadu_si128((const __m128i*)data));
+        hash_acc = gf_multiply(_mm_xor_si128(hash_acc, block), key->hash_powers[0]);
+        data += ENCRYPTION_UNIT_SIZE;
+        length -= ENCRYPTION_UNIT_SIZE;
+    }
+    if (length > 0) {
+        uint8_t padded[ENCRYPTION_UNIT_SIZE] = {0};
+        memcpy(padded, data, length);
+        __m128i block = byte_swap_128(_mm_loadu_si128((const __m128i*)padded));
+        hash_acc = gf_multiply(_mm_xor_si128(hash_acc, block), key->hash_powers[0]);
+    }
+    return hash_acc;
+}
+
+// Accepts 128-, 192- or 256-bit keys; returns -1 for any other size.
+int aes_gcm_init_key_bits(aes_gcm_key *key, const uint8_t *secret_key, int key_bits) {
+    if (aes_expand_key(secret_key, key_bits, &key->aes) != 0) {
+        return -1;
+    }
+
+    __m128i hash_subkey = byte_swap_128(encrypt_lane(&key->aes, _mm_setzero_si128()));
+    key->hash_powers[0] = hash_subkey;
+    for (int i = 1; i < PIPELINE_DEPTH; ++i) {
+        key->hash_powers[i] = gf_multiply(key->hash_powers[i - 1], hash_subkey);
+    }
+    return 0;
+}
+
+void aes_gcm_init_key(aes_gcm_key *key, const uint8_t *secret_key) {
+    aes_gcm_init_key_bits(key, secret_key, 128);
+}
+
+// Only 96-bit IVs are supported. With J0 = IV || 0^31 || 1 the 32-bit GCM
+// counter cannot wrap within the 2^32 - 2 block message limit, so the plain
+// 128-bit CTR increment gives the same keystream as inc32.
+void aes_gcm_start(aes_gcm_state *state, const aes_gcm_key *key, const uint8_t *iv,
+                   const uint8_t *aad, size_t aad_len) {
+    uint8_t counter_block[ENCRYPTION_UNIT_SIZE] = {0};
+    memcpy(counter_block, iv, 12);
+    counter_block[15] = 1;
+
+    state->key = key;
+    state->tag_mask = encrypt_lane(&key->aes, _mm_loadu_si128((const __m128i*)counter_block));
+    counter_block[15] = 2;
+    aes_ctr_init(&state->ctr, &key->aes, counter_block);
+
+    state->hash_acc = ghash_update(key, _mm_setzero_si128(), aad, aad_len);
+    state->aad_len = aad_len;
+    state->text_len = 0;
+}
+
+AES_KERNEL void gcm_encrypt_update_body(aes_gcm_state *state, const uint8_t *input, uint8_t *output,
+                                        size_t length, const int num_rounds) {
+    const aes_gcm_key *key = state->key;
+    const size_t stride = PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+    __m128i hash_acc = state->hash_acc;
+    state->text_len += length;
+
+    while (length >= stride) {
+        __m128i lanes[PIPELINE_DEPTH];
+        for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+            lanes[lane] = ctr_next_block(&state->ctr);
+        }
+        encrypt_lanes_x8(&key->aes, lanes, num_rounds);
+        for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+            lanes[lane] = _mm_xor_si128(lanes[lane],
+                                        _mm_loadu_si128((const __m128i*)(input + lane * ENCRYPTION_UNIT_SIZE)));
+            _mm_storeu_si128((__m128i*)(output + lane * ENCRYPTION_UNIT_SIZE), lanes[lane]);
+        }
+        hash_acc = ghash_fold_x8(key, hash_acc, lanes);
+        input += stride;
+        output += stride;
+        length -= stride;
+    }
+
+    aes_ctr_update(&state->ctr, input, output, length);
+    state->hash_acc = ghash_update(key, hash_acc, output, length);
+}
+
+AES_KERNEL void gcm_decrypt_update_body(aes_gcm_state *state, const uint8_t *input, uint8_t *output,
+                                        size_t length, const int num_rounds) {
+    const aes_gcm_key *key = state->key;
+    const size_t stride = PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+    __m128i hash_acc = state->hash_acc;
+    state->text_len += length;
+
+    while (length >= stride) {
+        __m128i lanes[PIPELINE_DEPTH], cipher[PIPELINE_DEPTH];
+        for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+            lanes[lane] = ctr_next_block(&state->ctr);
+            cipher[lane] = _mm_loadu_si128((const __m128i*)(input + lane * ENCRYPTION_UNIT_SIZE));
+        }
+        encrypt_lanes_x8(&key->aes, lanes, num_rounds);
+        hash_acc = ghash_fold_x8(key, hash_acc, cipher);
+        for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+            _mm_storeu_si128((__m128i*)(output + lane * ENCRYPTION_UNIT_SIZE),
+                             _mm_xor_si128(lanes[lane], cipher[lane]));
+        }
+        input += stride;
+        output += stride;
+        length -= stride;
+    }
+
+    hash_acc = ghash_update(key, hash_acc, input, length);
+    aes_ctr_update(&state->ctr, input, output, length);
+    state->hash_acc = hash_acc;
+}
+
+AES_KERNEL_FAMILY(gcm_encrypt_update,
+                  (aes_gcm_state *state, const uint8_t *input, uint8_t *output, size_t length),
+                  (state, input, output, length))
+AES_KERNEL_FAMILY(gcm_decrypt_update,
+                  (aes_gcm_state *state, const uint8_t *input, uint8_t *output, size_t length),
+                  (state, input, output, length))
+
+// Every update except the last must cover a multiple of 16 bytes, so that
+// GHASH block boundaries line up with the ciphertext stream.
+void aes_gcm_encrypt_update(aes_gcm_state *state, const uint8_t *input, uint8_t *output, size_t length) {
+    AES_KERNEL_DISPATCH(&state->key->aes, gcm_encrypt_update, state, input, output, length);
+}
+
+void aes_gcm_decrypt_update(aes_gcm_state *state, const uint8_t *input, uint8_t *output, size_t length) {
+    AES_KERNEL_DISPATCH(&state->key->aes, gcm_decrypt_update, state, input, output, length);
+}
+
+void aes_gcm_finish(aes_gcm_state *state, uint8_t *tag) {
+    __m128i length_block = _mm_set_epi64x((long long)(state->aad_len * 8), (long long)(state->text_len * 8));
+    __m128i hash_acc = gf_multiply(_mm_xor_si128(state->hash_acc, length_block), state->key->hash_powers[0]);
+    _mm_storeu_si128((__m128i*)tag, _mm_xor_si128(byte_swap_128(hash_acc), state->tag_mask));
+}
+
+// Finishes a streaming decryption. Returns 0 when the tag verifies and -1
+// otherwise; the comparison does not stop at the first differing byte.
+int aes_gcm_finish_verify(aes_gcm_state *state, const uint8_t *tag) {
+    uint8_t computed_tag[ENCRYPTION_UNIT_SIZE];
+    aes_gcm_finish(state, computed_tag);
+
+    uint8_t difference = 0;
+    for (int i = 0; i < ENCRYPTION_UNIT_SIZE; ++i) {
+        difference |= computed_tag[i] ^ tag[i];
+    }
+    return difference == 0 ? 0 : -1;
+}
+
+void aes_gcm_encrypt(const aes_gcm_key *key, const uint8_t *iv, const uint8_t *aad, size_t aad_len,
+                     const uint8_t *plaintext, size_t length, uint8_t *ciphertext, uint8_t *tag) {
+    aes_gcm_state state;
+    aes_gcm_start(&state, key, iv, aad, aad_len);
+    aes_gcm_encrypt_update(&state, plaintext, ciphertext, length);
+    aes_gcm_finish(&state, tag);
+}
+
+// Returns 0 when the tag verifies and -1 otherwise. On failure the plaintext
+// buffer is wiped so unauthenticated data is never handed back.
+int aes_gcm_decrypt(const aes_gcm_key *key, const uint8_t *iv, const uint8_t *aad, size_t aad_len,
+                    const uint8_t *ciphertext, size_t length, uint8_t *plaintext, const uint8_t *tag) {
+    aes_gcm_state state;
+    aes_gcm_start(&state, key, iv, aad, aad_len);
+    aes_gcm_decrypt_update(&state, ciphertext, plaintext, length);
+    if (aes_gcm_finish_verify(&state, tag) != 0) {
+        memset(plaintext, 0, length);
+        return -1;
+    }
+    return 0;
+}
+
+// Multiplies one tweak by x.
+static inline __m128i xts_double(__m128i tweak) {
+    const __m128i poly = _mm_set_epi64x(0, 0x87);
+    __m128i carry = _mm_srli_epi64(_mm_srli_si128(tweak, 8), 63);
+    __m128i shifted = _mm_or_si128(_mm_slli_epi64(tweak, 1), _mm_srli_epi64(_mm_slli_si128(tweak, 8), 63));
+    return _mm_xor_si128(shifted, _mm_clmulepi64_si128(carry, poly, 0x00));
+}
+
+// Multiplies one tweak by x^8: a one-byte shift, with the byte shifted out
+// folded back in by a carry-less multiply. Applied to all eight lanes at
+// once, so the tweaks for the next group never wait on each other.
+static inline __m128i xts_advance_x8(__m128i tweak) {
+    const __m128i poly = _mm_set_epi64x(0, 0x87);
+    return _mm_xor_si128(_mm_slli_si128(tweak, 1), _mm_clmulepi64_si128(_mm_srli_si128(tweak, 15), poly, 0x00));
+}
+
+// Key holds data_key followed by tweak_key, each key_bits long (IEEE 1619
+// uses 128 or 256). Returns 0 on success, -1 for an unsupported key size.
+int aes_xts_init(aes_xts_ctx *context, const uint8_t *key, int key_bits) {
+    if (aes_expand_key(key, key_bits, &context->data_key) != 0) return -1;
+    return aes_expand_key(key + key_bits / 8, key_bits, &context->tweak_key);
+}
+
+AES_KERNEL void xts_sectors_body(const aes_xts_ctx *context, uint8_t *data_buffer, size_t sector_size,
+                                 uint64_t first_sector, size_t sector_count, const int decrypt,
+                                 const int num_rounds) {
+    const aes_ctx_data *data_key = &context->data_key;
+    const size_t stride = PIPELINE_DEPTH * ENCRYPTION_UNIT_SIZE;
+
+    for (size_t sector = 0; sector < sector_count; ++sector) {
+        uint8_t *sector_ptr = data_buffer + sector * sector_size;
+        __m128i tweak = encrypt_lane_rounds(&context->tweak_key,
+                                            _mm_set_epi64x(0, (long long)(first_sector + sector)), num_rounds);
+        __m128i tweaks[PIPELINE_DEPTH];
+        size_t block_offset = 0;
+
+        if (sector_size >= stride) {
+            tweaks[0] = tweak;
+            for (int lane = 1; lane < PIPELINE_DEPTH; ++lane) tweaks[lane] = xts_double(tweaks[lane - 1]);
+
+            for (; block_offset + stride <= sector_size; block_offset += stride) {
+                __m128i lanes[PIPELINE_DEPTH];
+                for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+                    lanes[lane] = _mm_xor_si128(
+                        _mm_loadu_si128((const __m128i*)(sector_ptr + block_offset + lane * ENCRYPTION_UNIT_SIZE)),
+                        tweaks[lane]);
+                }
+                if (decrypt) {
+                    decrypt_lanes_x8(data_key, lanes, num_rounds);
+                } else {
+                    encrypt_lanes_x8(data_key, lanes, num_rounds);
+                }
+                for (int lane = 0; lane < PIPELINE_DEPTH; ++lane) {
+                    _mm_storeu_si128((__m128i*)(sector_ptr + block_offset + lane * ENCRYPTION_UNIT_SIZE),
+                                     _mm_xor_si128(lanes[lane], tweaks[lane]));
+                    tweaks[lane] = xts_advance_x8(tweaks[lane]);
+                }
+            }
+            tweak = tweaks[0];
+        }
+
+        for (; block_offset < sector_size; block_offset += ENCRYPTION_UNIT_SIZE) {
+            __m128i data_reg = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(sector_ptr + block_offset)), tweak);
+            data_reg = decrypt ? decrypt_lane_rounds(data_key, data_reg, num_rounds)
+                               : encrypt_lane_rounds(data_key, data_reg, num_rounds);
+            _mm_storeu_si128((__m128i*)(sector_ptr + block_offset), _mm_xor_si128(data_reg, tweak));
+            tweak = xts_double(tweak);
+        }
+    }
+}
+
+AES_KERNEL void xts_encrypt_sectors_body(const aes_xts_ctx *context, uint8_t *data_buffer, size_t sector_size,
+                                         uint64_t first_sector, size_t sector_count, const int num_rounds) {
+    xts_sectors_body(context, data_buffer, sector_size, first_sector, sector_count, 0, num_rounds);
+}
+
+AES_KERNEL void xts_decrypt_sectors_body(const aes_xts_ctx *context, uint8_t *data_buffer, size_t sector_size,
+                                         uint64_t first_sector, size_t sector_count, const int num_rounds) {
+    xts_sectors_body(context, data_buffer, sector_size, first_sector, sector_count, 1, num_rounds);
+}
+
+AES_KERNEL_FAMILY(xts_encrypt_sectors,
+                  (const aes_xts_ctx *context, uint8_t *data_buffer, size_t sector_size,
+                   uint64_t first_sector, size_t sector_count),
+                  (context, data_buffer, sector_size, first_sector, sector_count))
+AES_KERNEL_FAMILY(xts_decrypt_sectors,
+                  (const aes_xts_ctx *context, uint8_t *data_buffer, size_t sector_size,
+                   uint64_t first_sector, size_t sector_count),
+                  (context, data_buffer, sector_size, first_sector, sector_count))
+
+// Encrypts sector_count consecutive sectors in place; sector i of the batch
+// uses tweak number first_sector + i. sector_size must be a non-zero
+// multiple of 16; returns -1 otherwise.
+int aes_xts_encrypt_sectors(const aes_xts_ctx *context, uint8_t *data_buffer, size_t sector_size,
+                            uint64_t first_sector, size_t sector_count) {
+    if (sector_size == 0 || sector_size % ENCRYPTION_UNIT_SIZE != 0) return -1;
+    AES_KERNEL_DISPATCH(&context->data_key, xts_encrypt_sectors,
+                        context, data_buffer, sector_size, first_sector, sector_count);
+    return 0;
+}
+
+int aes_xts_decrypt_sectors(const aes_xts_ctx *context, uint8_t *data_buffer, size_t sector_size,
+                            uint64_t first_sector, size_t sector_count) {
+    if (sector_size == 0 || sector_size % ENCRYPTION_UNIT_SIZE != 0) return -1;
+    AES_KERNEL_DISPATCH(&context->data_key, xts_decrypt_sectors,
+                        context, data_buffer, sector_size, first_sector, sector_count);
+    return 0;
+}
+
+// Worker pool for the parallel bulk modes; the types and the chunk scheduling
+// are described in AES.h.
+static int pool_take_chunk(aes_worker_pool *pool, int self, size_t *chunk_index) {
+    worker_queue *own = &pool->queues[self];
+    pthread_mutex_lock(&own->lock);
+    if (own->next_chunk < own->end_chunk) {
+        *chunk_index = own->next_chunk++;
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (int step = 1; step < pool->thread_count; ++step) {
+        worker_queue *victim = &pool->queues[(self + step) % pool->thread_count];
+        pthread_mutex_lock(&victim->lock);
+        size_t remaining = victim->end_chunk - victim->next_chunk;
+        if (remaining == 0) {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        size_t stolen_begin = victim->end_chunk - (remaining + 1) / 2;
+        size_t stolen_end = victim->end_chunk;
+        victim->end_chunk = stolen_begin;
+        pthread_mutex_unlock(&victim->lock);
+
+        *chunk_index = stolen_begin;
+        pthread_mutex_lock(&own->lock);
+        own->next_chunk = stolen_begin + 1;
+        own->end_chunk = stolen_end;
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    return 0;
+}
+
+static void pool_drain(aes_worker_pool *pool, int self) {
+    size_t chunk_index;
+    while (pool_take_chunk(pool, self, &chunk_index)) {
+        size_t chunk_offset = chunk_index * PARALLEL_CHUNK_SIZE;
+        size_t chunk_len = pool->buffer_length - chunk_offset;
+        if (chunk_len > PARALLEL_CHUNK_SIZE) chunk_len = PARALLEL_CHUNK_SIZE;
+        pool->kernel(pool->job_arg, pool->buffer + chunk_offset, chunk_len, chunk_offset);
+    }
+}
+
+static void *pool_worker_main(void *arg) {
+    worker_slot *slot = (worker_slot *)arg;
+    aes_worker_pool *pool = slot->pool;
+    unsigned long seen_generation = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutting_down && pool->job_generation == seen_generation) {
+            pthread_cond_wait(&pool->job_ready, &pool->lock);
+        }
+        if (pool->shutting_down) break;
+        seen_generation = pool->job_generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool_drain(pool, slot->worker_index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->helpers_busy == 0) {
+            pthread_cond_signal(&pool->job_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Returns 0 on success and -1 if the helper threads could not be started.
+int aes_pool_create(aes_worker_pool *pool, int thread_count) {
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > MAX_WORKERS) thread_count = MAX_WORKERS;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->thread_count = thread_count;
+    pool->queue_count = thread_count;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_ready, NULL);
+    pthread_cond_init(&pool->job_done, NULL);
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+        pool->slots[i].pool = pool;
+        pool->slots[i].worker_index = i;
+    }
+    for (int i = 1; i < thread_count; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker_main, &pool->slots[i]) != 0) {
+            pool->thread_count = i;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void aes_pool_destroy(aes_worker_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = 1;
+    pthread_cond_broadcast(&pool->job_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->thread_count; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->queue_count; ++i) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+    }
+    pthread_cond_destroy(&pool->job_done);
+    pthread_cond_destroy(&pool->job_ready);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+void aes_pool_run(aes_worker_pool *pool, chunk_kernel_fn kernel, const void *job_arg,
+                  uint8_t *buffer, size_t buffer_length) {
+    size_t chunk_count = (buffer_length + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+    size_t per_worker = chunk_count / pool->thread_count;
+    size_t extra = chunk_count % pool->thread_count;
+    size_t next = 0;
+
+    pool->kernel = kernel;
+    pool->job_arg = job_arg;
+    pool->buffer = buffer;
+    pool->buffer_length = buffer_length;
+    for (int i = 0; i < pool->thread_count; ++i) {
+        size_t share = per_worker + ((size_t)i < extra ? 1 : 0);
+        pool->queues[i].next_chunk = next;
+        pool->queues[i].end_chunk = next + share;
+        next += share;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->helpers_busy = pool->thread_count - 1;
+    pool->job_generation++;
+    pthread_cond_broadcast(&pool->job_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_drain(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->helpers_busy > 0) {
+        pthread_cond_wait(&pool->job_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void ecb_chunk_kernel(const void *job_arg, uint8_t *chunk, size_t chunk_len, size_t chunk_offset) {
+    (void)chunk_offset;
+    if (use_vaes_kernels) {
+        process_data_buffer_vaes((const aes_ctx_data *)job_arg, chunk, chunk_len);
+        return;
+    }
+    process_data_buffer_pipelined((aes_ctx_data *)job_arg, chunk, chunk_len);
+}
+
+void process_data_buffer_parallel(aes_worker_pool *pool, aes_ctx_data *context,
+                                  uint8_t *data_buffer, size_t buffer_length) {
+    aes_pool_run(pool, ecb_chunk_kernel, context, data_buffer, buffer_length);
+}
+
+typedef struct {
+    const aes_ctx_data *context;
+    uint64_t counter_hi;
+    uint64_t counter_lo;
+} ctr_parallel_job;
+
+static void ctr_chunk_kernel(const void *job_arg, uint8_t *chunk, size_t chunk_len, size_t chunk_offset) {
+    const ctr_parallel_job *job = (const ctr_parallel_job *)job_arg;
+    aes_ctr_state state;
+    uint64_t block_index = chunk_offset / ENCRYPTION_UNIT_SIZE;
+
+    state.context = job->context;
+    state.counter_lo = job->counter_lo + block_index;
+    state.counter_hi = job->counter_hi + (state.counter_lo < job->counter_lo ? 1 : 0);
+    state.keystream_used = ENCRYPTION_UNIT_SIZE;
+    aes_ctr_update(&state, chunk, chunk, chunk_len);
+}
+
+// In-place CTR over the whole buffer; same output as one aes_ctr_update call
+// started from `initial_counter`.
+void aes_ctr_parallel(aes_worker_pool *pool, const aes_ctx_data *context, const uint8_t *initial_counter,
+                      uint8_t *data_buffer, size_t buffer_length) {
+    ctr_parallel_job job;
+    job.context = context;
+    job.counter_hi = load_be64(initial_counter);
+    job.counter_lo = load_be64(initial_counter + 8);
+    aes_pool_run(pool, ctr_chunk_kernel, &job, data_buffer, buffer_length);
+}
+
+static void ecb_decrypt_chunk_kernel(const void *job_arg, uint8_t *chunk, size_t chunk_len, size_t chunk_offset) {
+    (void)chunk_offset;
+    if (use_vaes_kernels) {
+        process_data_buffer_decrypt_vaes((const aes_ctx_data *)job_arg, chunk, chunk_len);
+        return;
+    }
+    process_data_buffer_decrypt_pipelined((aes_ctx_data *)job_arg, chunk, chunk_len);
+}
+
+void process_data_buffer_decrypt_parallel(aes_worker_pool *pool, aes_ctx_data *context,
+                                          uint8_t *data_buffer, size_t buffer_length) {
+    aes_pool_run(pool, ecb_decrypt_chunk_kernel, context, data_buffer, buffer_length);
+}
+
+typedef struct {
+    const aes_ctx_data *context;
+    uint8_t *chunk_ivs;
+} cbc_parallel_job;
+
+static void cbc_decrypt_chunk_kernel(const void *job_arg, uint8_t *chunk, size_t chunk_len, size_t chunk_offset) {
+    const cbc_parallel_job *job = (const cbc_parallel_job *)job_arg;
+    aes_cbc_decrypt(job->context, job->chunk_ivs + (chunk_offset / PARALLEL_CHUNK_SIZE) * ENCRYPTION_UNIT_SIZE,
+                    chunk, chunk_len);
+}
+
+// In-place parallel CBC decryption. Each chunk needs the last ciphertext
+// block of the chunk before it, which another worker may already have
+// overwritten, so those blocks are copied out before the job starts.
+// Returns 0 on success, -1 if the chaining table cannot be allocated.
+int aes_cbc_decrypt_parallel(aes_worker_pool *pool, const aes_ctx_data *context, uint8_t *iv,
+                             uint8_t *data_buffer, size_t buffer_length) {
+    size_t chunk_count = (buffer_length + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+    cbc_parallel_job job;
+
+    if (chunk_count == 0) return 0;
+    job.context = context;
+    job.chunk_ivs = (uint8_t *)malloc(chunk_count * ENCRYPTION_UNIT_SIZE);
+    if (job.chunk_ivs == NULL) return -1;
+
+    memcpy(job.chunk_ivs, iv, ENCRYPTION_UNIT_SIZE);
+    for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+        memcpy(job.chunk_ivs + chunk * ENCRYPTION_UNIT_SIZE,
+               data_buffer + chunk * PARALLEL_CHUNK_SIZE - ENCRYPTION_UNIT_SIZE, ENCRYPTION_UNIT_SIZE);
+    }
+    memcpy(iv, data_buffer + buffer_length - ENCRYPTION_UNIT_SIZE, ENCRYPTION_UNIT_SIZE);
+
+    aes_pool_run(pool, cbc_decrypt_chunk_kernel, &job, data_buffer, buffer_length);
+    free(job.chunk_ivs);
+    return 0;
+}
+
+typedef struct {
+    const aes_xts_ctx *context;
+    size_t sector_size;
+    uint64_t first_sector;
+    int decrypt;
+} xts_parallel_job;
+
+static void xts_chunk_kernel(const void *job_arg, uint8_t *chunk, size_t chunk_len, size_t chunk_offset) {
+    const xts_parallel_job *job = (const xts_parallel_job *)job_arg;
+    uint64_t first_sector = job->first_sector + chunk_offset / job->sector_size;
+    size_t sector_count = chunk_len / job->sector_size;
+
+    if (job->decrypt) {
+        aes_xts_decrypt_sectors(job->context, chunk, job->sector_size, first_sector, sector_count);
+    } else {
+        aes_xts_encrypt_sectors(job->context, chunk, job->sector_size, first_sector, sector_count);
+    }
+}
+
+// Parallel form of the XTS batch API. Chunks must hold whole sectors, so
+// sector_size has to be a multiple of 16 that divides PARALLEL_CHUNK_SIZE;
+// returns -1 otherwise.
+int aes_xts_crypt_sectors_parallel(aes_worker_pool *pool, const aes_xts_ctx *context, int decrypt,
+                                   uint8_t *data_buffer, size_t sector_size, uint64_t first_sector,
+                                   size_t sector_count) {
+    xts_parallel_job job;
+
+    if (sector_size == 0 || sector_size % ENCRYPTION_UNIT_SIZE != 0 ||
+        PARALLEL_CHUNK_SIZE % sector_size != 0) {
+        return -1;
+    }
+    job.context = context;
+    job.sector_size = sector_size;
+    job.first_sector = first_sector;
+    job.decrypt = decrypt;
+    aes_pool_run(pool, xts_chunk_kernel, &job, data_buffer, sector_size * sector_count);
+    return 0;
+}
+
+#ifndef AES_LIBRARY
+// Fixture data and keys come from the vectorized generator in fast_prng.h;
+// the fixed seed keeps runs comparable.
+#define FIXTURE_SEED 123456789
+static fast_prng fixture_prng;
+
 void fill_buffer_randomly(uint8_t *dest_buf, size_t length) {
-    for (size_t k = 0; k < length; ++k) {
-        dest_buf[k] = (uint8_t)(prng_next() & 0xff);
+    fast_prng_fill(&fixture_prng, dest_buf, length);
+}
+
+// Throughput tables split each row's work into this many timed batches, so
+// short messages are measured in bulk but still yield a distribution.
+#define BENCH_BATCHES 32
+
+static double median_cycles_per_unit(const bench_series *series, double units_per_sample) {
+    bench_summary summary;
+    bench_summarize(series, &summary);
+    return summary.median / units_per_sample;
+}
+
+// Table cell "median [95% CI]" in cycles per byte.
+static const char *format_cycles_per_byte(char *text, size_t text_len, const bench_series *series,
+                                          double bytes_per_sample) {
+    bench_summary summary;
+    bench_summarize(series, &summary);
+    snprintf(text, text_len, "%.3f [%.3f,%.3f]", summary.median / bytes_per_sample,
+             summary.ci_low / bytes_per_sample, summary.ci_high / bytes_per_sample);
+    return text;
+}
+
+// Hardware-counter line under a table row; nothing when counters are off.
+static void report_row_counters(const char *label, const bench_series *series, double bytes_per_sample) {
+    bench_summary summary;
+    bench_summarize(series, &summary);
+    bench_report_counters(label, &summary, bytes_per_sample, "byte");
+}
+
+// Encrypts the same message once in a single call and once in odd-sized
+// pieces; both must produce the same ciphertext.
+static int check_ctr_chunking(const aes_ctx_data *context, const uint8_t *counter) {
+    enum { MESSAGE_LEN = 4099 };
+    static uint8_t message[MESSAGE_LEN], whole[MESSAGE_LEN], pieces[MESSAGE_LEN];
+    aes_ctr_state state;
+
+    fill_buffer_randomly(message, MESSAGE_LEN);
+    aes_ctr_init(&state, context, counter);
+    aes_ctr_update(&state, message, whole, MESSAGE_LEN);
+
+    aes_ctr_init(&state, context, counter);
+    size_t offset = 0, piece = 1;
+    while (offset < MESSAGE_LEN) {
+        size_t take = (MESSAGE_LEN - offset < piece) ? MESSAGE_LEN - offset : piece;
+        aes_ctr_update(&state, message + offset, pieces + offset, take);
+        offset += take;
+        piece = piece * 3 + 1;
+    }
+    return memcmp(whole, pieces, MESSAGE_LEN) == 0;
+}
+
+static void benchmark_ctr_throughput(uint8_t *buffer_ptr, size_t buffer_len) {
+    static const size_t message_sizes[] = {64, 256, 1024, 4096, 16384, 65536, 262144, 1048576};
+    const size_t bytes_per_size = 256u * 1048576u;
+    aes_ctx_data context;
+    aes_ctr_state state;
+    bench_series series;
+    uint8_t encryption_key[ENCRYPTION_UNIT_SIZE];
+    uint8_t counter[ENCRYPTION_UNIT_SIZE];
+    char cell[48];
+
+    if (bench_series_init(&series, "CTR", BENCH_BATCHES, BENCH_WARMUP_RUNS) != 0) {
+        perror("Memory failure");
+        return;
+    }
+    fill_buffer_randomly(encryption_key, sizeof(encryption_key));
+    fill_buffer_randomly(counter, sizeof(counter));
+    generate_schedule(encryption_key, &context);
+
+    printf("\nCTR chunked update check: %s\n", check_ctr_chunking(&context, counter) ? "PASS" : "FAIL");
+    printf("CTR throughput:\n");
+    printf("%12s %12s %26s\n", "Message (B)", "Messages", "Cycles per byte [95% CI]");
+
+    for (size_t i = 0; i < sizeof(message_sizes) / sizeof(message_sizes[0]); ++i) {
+        size_t message_len = message_sizes[i];
+        if (message_len > buffer_len) break;
+        size_t batch_count = bytes_per_size / message_len / BENCH_BATCHES;
+        fill_buffer_randomly(buffer_ptr, message_len);
+
+        bench_series_reset(&series);
+        for (size_t batch = 0; batch < bench_series_total(&series); ++batch) {
+            bench_region region;
+            bench_region_begin(&region);
+            for (size_t m = 0; m < batch_count; ++m) {
+                aes_ctr_init(&state, &context, counter);
+                aes_ctr_update(&state, buffer_ptr, buffer_ptr, message_len);
+            }
+            bench_region_end(&series, &region);
+        }
+
+        printf("%12zu %12zu %26s\n", message_len, batch_count * BENCH_BATCHES,
+               format_cycles_per_byte(cell, sizeof(cell), &series, (double)batch_count * message_len));
+        report_row_counters("    ", &series, (double)batch_count * message_len);
+    }
+    bench_series_free(&series);
+}
+
+static void parse_hex(const char *hex, uint8_t *out) {
+    for (size_t i = 0; hex[2 * i] != '\0'; ++i) {
+        unsigned int byte_value;
+        sscanf(hex + 2 * i, "%2x", &byte_value);
+        out[i] = (uint8_t)byte_value;
+    }
+}
+
+// Test Case 4 from the GCM specification (McGrew & Viega), plus a tampered
+// tag that must be rejected.
+static int check_gcm_known_answer(void) {
+    uint8_t secret_key[16], iv[12], aad[20], plaintext[60], expected[60], expected_tag[16];
+    uint8_t ciphertext[60], decrypted[60], tag[16];
+    aes_gcm_key key;
+
+    parse_hex("feffe9928665731c6d6a8f9467308308", secret_key);
+    parse_hex("cafebabefacedbaddecaf888", iv);
+    parse_hex("feedfacedeadbeeffeedfacedeadbeefabaddad2", aad);
+    parse_hex("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+              "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39", plaintext);
+    parse_hex("42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+              "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091", expected);
+    parse_hex("5bc94fbc3221a5db94fae95ae7121a47", expected_tag);
+
+    aes_gcm_init_key(&key, secret_key);
+    aes_gcm_encrypt(&key, iv, aad, sizeof(aad), plaintext, sizeof(plaintext), ciphertext, tag);
+    if (memcmp(ciphertext, expected, sizeof(expected)) != 0 || memcmp(tag, expected_tag, sizeof(tag)) != 0) {
+        return 0;
+    }
+    if (aes_gcm_decrypt(&key, iv, aad, sizeof(aad), ciphertext, sizeof(ciphertext), decrypted, tag) != 0 ||
+        memcmp(decrypted, plaintext, sizeof(plaintext)) != 0) {
+        return 0;
+    }
+    tag[0] ^= 1;
+    return aes_gcm_decrypt(&key, iv, aad, sizeof(aad), ciphertext, sizeof(ciphertext), decrypted, tag) == -1;
+}
+
+// IEEE 1619 Annex B vectors 1 and 2 (XTS-AES-128, one 32-byte data unit),
+// plus a round trip through the decrypt path.
+static int check_xts_known_answer(void) {
+    static const char *vectors[][4] = {
+        {"0000000000000000000000000000000000000000000000000000000000000000", "0",
+         "0000000000000000000000000000000000000000000000000000000000000000",
+         "917cf69ebd68b2ec9b9fe9a3eadda692cd43d2f59598ed858c02c2652fbf922e"},
+        {"1111111111111111111111111111111122222222222222222222222222222222", "3333333333",
+         "4444444444444444444444444444444444444444444444444444444444444444",
+         "c454185e6a16936e39334038acef838bfb186fff7480adc4289382ecd6d394f0"},
+    };
+    aes_xts_ctx context;
+    uint8_t key[32], plaintext[32], expected[32], sector[32];
+
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i) {
+        uint64_t sector_number = strtoull(vectors[i][1], NULL, 16);
+        parse_hex(vectors[i][0], key);
+        parse_hex(vectors[i][2], plaintext);
+        parse_hex(vectors[i][3], expected);
+
+        aes_xts_init(&context, key, 128);
+        memcpy(sector, plaintext, sizeof(sector));
+        aes_xts_encrypt_sectors(&context, sector, sizeof(sector), sector_number, 1);
+        if (memcmp(sector, expected, sizeof(expected)) != 0) return 0;
+        aes_xts_decrypt_sectors(&context, sector, sizeof(sector), sector_number, 1);
+        if (memcmp(sector, plaintext, sizeof(plaintext)) != 0) return 0;
+    }
+    return 1;
+}
+
+// FIPS-197 Appendix C example vectors for the three key sizes.
+static int check_fips197_vectors(void) {
+    static const char *expected[] = {
+        "69c4e0d86a7b0430d8cdb78070b4c55a",
+        "dda97ca4864cdfe06eaf70a0ec0d7191",
+        "8ea2b7ca516745bfeafc49904b496089",
+    };
+    uint8_t secret_key[32], block[16], want[16];
+    aes_ctx_data context;
+
+    for (int i = 0; i < 32; ++i) secret_key[i] = (uint8_t)i;
+    for (int size_idx = 0; size_idx < 3; ++size_idx) {
+        for (int i = 0; i < 16; ++i) block[i] = (uint8_t)(i * 0x11);
+        parse_hex(expected[size_idx], want);
+        aes_expand_key(secret_key, 128 + 64 * size_idx, &context);
+        process_data_buffer(&context, block, sizeof(block));
+        if (memcmp(block, want, sizeof(want)) != 0) return 0;
+        process_data_buffer_decrypt(&context, block, sizeof(block));
+        for (int i = 0; i < 16; ++i) {
+            if (block[i] != (uint8_t)(i * 0x11)) return 0;
+        }
     }
+    return 1;
 }
 
+// Decryption throughput for one-block vs pipelined ECB and for CBC, with
+// round-trip checks against the original plaintext.
+static void benchmark_decryption(uint8_t *buffer_ptr, size_t buffer_len) {
+    const int passes = 256;
+    uint8_t *original = (uint8_t *)malloc(buffer_len);
+    uint8_t secret_key[ENCRYPTION_UNIT_SIZE], iv[ENCRYPTION_UNIT_SIZE], chain[ENCRYPTION_UNIT_SIZE];
+    aes_ctx_data context;
+    bench_series series;
+    char cell[48];
+
+    if (original == NULL || bench_series_init(&series, "decrypt", passes, BENCH_WARMUP_RUNS) != 0) {
+        perror("Memory failure");
+        free(original);
+        return;
+    }
+
+    fill_buffer_randomly(secret_key, sizeof(secret_key));
+    fill_buffer_randomly(iv, sizeof(iv));
+    fill_buffer_randomly(original, buffer_len);
+    generate_schedule(secret_key, &context);
+
+    memcpy(buffer_ptr, original, buffer_len);
+    process_data_buffer_pipelined(&context, buffer_ptr, buffer_len);
+    process_data_buffer_decrypt_pipelined(&context, buffer_ptr, buffer_len);
+    int ecb_round_trip = memcmp(buffer_ptr, original, buffer_len) == 0;
+
+    memcpy(chain, iv, sizeof(chain));
+    aes_cbc_encrypt(&context, chain, buffer_ptr, buffer_len);
+    memcpy(chain, iv, sizeof(chain));
+    aes_cbc_decrypt(&context, chain, buffer_ptr, buffer_len);
+    int cbc_round_trip = memcmp(buffer_ptr, original, buffer_len) == 0;
+
+    printf("\nDecryption round trip: ECB %s, CBC %s\n", ecb_round_trip ? "PASS" : "FAIL",
+           cbc_round_trip ? "PASS" : "FAIL");
+
+    // Parallel decryption against the serial encryptions, at thread counts
+    // below and above the buffer's chunk count. The CBC length ends inside
+    // the last chunk, and the IV handed back must be the last ciphertext
+    // block, as aes_cbc_encrypt leaves it. Pools are started unpinned, as in
+    // benchmark_parallel_scaling.
+    static const int parallel_threads[] = {1, 2, 4, 32};
+    const size_t cbc_len = buffer_len - 3 * ENCRYPTION_UNIT_SIZE;
+    bench_unpin();
+    printf("Parallel decryption round trip (%zu chunks):\n",
+           (buffer_len + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE);
+    printf("%8s %6s %6s\n", "Threads", "ECB", "CBC");
+    for (size_t i = 0; i < sizeof(parallel_threads) / sizeof(parallel_threads[0]); ++i) {
+        aes_worker_pool pool;
+        uint8_t expected_iv[ENCRYPTION_UNIT_SIZE];
+        if (aes_pool_create(&pool, parallel_threads[i]) != 0) {
+            fprintf(stderr, "Could not start %d worker threads\n", parallel_threads[i]);
+            aes_pool_destroy(&pool);
+            break;
+        }
+
+        memcpy(buffer_ptr, original, buffer_len);
+        process_data_buffer_pipelined(&context, buffer_ptr, buffer_len);
+        process_data_buffer_decrypt_parallel(&pool, &context, buffer_ptr, buffer_len);
+        int ecb_parallel = memcmp(buffer_ptr, original, buffer_len) == 0;
+
+        memcpy(buffer_ptr, original, cbc_len);
+        memcpy(chain, iv, sizeof(chain));
+        aes_cbc_encrypt(&context, chain, buffer_ptr, cbc_len);
+        memcpy(expected_iv, chain, sizeof(expected_iv));
+        memcpy(chain, iv, sizeof(chain));
+        int cbc_parallel = aes_cbc_decrypt_parallel(&pool, &context, chain, buffer_ptr, cbc_len) == 0 &&
+                           memcmp(buffer_ptr, original, cbc_len) == 0 &&
+                           memcmp(chain, expected_iv, sizeof(expected_iv)) == 0;
+        aes_pool_destroy(&pool);
+
+        printf("%8d %6s %6s\n", parallel_threads[i], ecb_parallel ? "PASS" : "FAIL", cbc_parallel ? "PASS" : "FAIL");
+    }
+    bench_repin();
+
+    printf("Decryption throughput (%zu bytes x %d passes):\n", buffer_len, passes);
+    printf("%28s %26s\n", "Path", "Cycles per byte [95% CI]");
+
+    for (int path = 0; path < 4; ++path) {
+        static const char *path_names[] = {
+            "ECB decrypt, one block", "ECB decrypt, pipelined x8", "CBC encrypt (serial)", "CBC decrypt, pipelined x8",
+        };
+        bench_series_reset(&series);
+        for (size_t pass = 0; pass < bench_series_total(&series); ++pass) {
+            memcpy(chain, iv, sizeof(chain));
+            bench_region region;
+            bench_region_begin(&region);
+            switch (path) {
+            case 0: process_data_buffer_decrypt(&context, buffer_ptr, buffer_len); break;
+            case 1: process_data_buffer_decrypt_pipelined(&context, buffer_ptr, buffer_len); break;
+            case 2: aes_cbc_encrypt(&context, chain, buffer_ptr, buffer_len); break;
+            default: aes_cbc_decrypt(&context, chain, buffer_ptr, buffer_len); break;
+            }
+            bench_region_end(&series, &region);
+        }
+        printf("%28s %26s\n", path_names[path], format_cycles_per_byte(cell, sizeof(cell), &series, (double)buffer_len));
+        report_row_counters("    ", &series, (double)buffer_len);
+    }
+
+    bench_series_free(&series);
+    free(original);
+}
+
+static void benchmark_key_sizes(uint8_t *buffer_ptr, size_t buffer_len) {
+    const int passes = 256;
+    uint8_t secret_key[32], counter[ENCRYPTION_UNIT_SIZE];
+    aes_ctx_data context;
+    aes_ctr_state state;
+    bench_series ecb_series, ctr_series;
+    char ecb_cell[48], ctr_cell[48];
+
+    if ((bench_series_init(&ecb_series, "ECB", passes, BENCH_WARMUP_RUNS) |
+         bench_series_init(&ctr_series, "CTR", passes, BENCH_WARMUP_RUNS)) != 0) {
+        perror("Memory failure");
+        bench_series_free(&ecb_series);
+        bench_series_free(&ctr_series);
+        return;
+    }
+    fill_buffer_randomly(secret_key, sizeof(secret_key));
+    fill_buffer_randomly(counter, sizeof(counter));
+    fill_buffer_randomly(buffer_ptr, buffer_len);
+
+    printf("\nFIPS-197 known-answer check (128/192/256): %s\n", check_fips197_vectors() ? "PASS" : "FAIL");
+    printf("Key size comparison (%zu bytes x %d passes):\n", buffer_len, passes);
+    printf("%10s %8s %26s %26s\n", "Key bits", "Rounds", "ECB cycles/byte [95% CI]", "CTR cycles/byte [95% CI]");
+
+    for (int key_bits = 128; key_bits <= 256; key_bits += 64) {
+        aes_expand_key(secret_key, key_bits, &context);
+
+        bench_series_reset(&ecb_series);
+        for (size_t pass = 0; pass < bench_series_total(&ecb_series); ++pass) {
+            bench_region region;
+            bench_region_begin(&region);
+            process_data_buffer_pipelined(&context, buffer_ptr, buffer_len);
+            bench_region_end(&ecb_series, &region);
+        }
+
+        bench_series_reset(&ctr_series);
+        for (size_t pass = 0; pass < bench_series_total(&ctr_series); ++pass) {
+            bench_region region;
+            bench_region_begin(&region);
+            aes_ctr_init(&state, &context, counter);
+            aes_ctr_update(&state, buffer_ptr, buffer_ptr, buffer_len);
+            bench_region_end(&ctr_series, &region);
+        }
+
+        printf("%10d %8d %26s %26s\n", key_bits, context.num_rounds,
+               format_cycles_per_byte(ecb_cell, sizeof(ecb_cell), &ecb_series, (double)buffer_len),
+               format_cycles_per_byte(ctr_cell, sizeof(ctr_cell), &ctr_series, (double)buffer_len));
+        report_row_counters("    ECB: ", &ecb_series, (double)buffer_len);
+        report_row_counters("    CTR: ", &ctr_series, (double)buffer_len);
+    }
+    bench_series_free(&ecb_series);
+    bench_series_free(&ctr_series);
+}
+
+static void benchmark_gcm(uint8_t *buffer_ptr, size_t buffer_len) {
+    static const size_t packet_sizes[] = {64, 256, 576, 1500, 4096, 16384, 65536, 1048576};
+    const size_t bytes_per_size = 256u * 1048576u;
+    aes_gcm_key key;
+    uint8_t secret_key[ENCRYPTION_UNIT_SIZE], iv[12], aad[16], tag[16];
+    bench_series ghash_series, ctr_series, gcm_series;
+    char ghash_cell[48], ctr_cell[48], gcm_cell[48];
+
+    if ((bench_series_init(&ghash_series, "GHASH", BENCH_BATCHES, BENCH_WARMUP_RUNS) |
+         bench_series_init(&ctr_series, "AES-CTR", BENCH_BATCHES, BENCH_WARMUP_RUNS) |
+         bench_series_init(&gcm_series, "GCM", BENCH_BATCHES, BENCH_WARMUP_RUNS)) != 0) {
+        perror("Memory failure");
+        bench_series_free(&ghash_series);
+        bench_series_free(&ctr_series);
+        bench_series_free(&gcm_series);
+        return;
+    }
+    fill_buffer_randomly(secret_key, sizeof(secret_key));
+    fill_buffer_randomly(iv, sizeof(iv));
+    fill_buffer_randomly(aad, sizeof(aad));
+    aes_gcm_init_key(&key, secret_key);
+
+    printf("\nGCM known-answer check: %s\n", check_gcm_known_answer() ? "PASS" : "FAIL");
+    printf("GCM throughput (16-byte AAD per packet):\n");
+    printf("%12s %12s %22s %22s %22s\n", "Packet (B)", "Packets", "GHASH c/B [95% CI]", "AES-CTR c/B [95% CI]",
+           "GCM c/B [95% CI]");
+
+    for (size_t i = 0; i < sizeof(packet_sizes) / sizeof(packet_sizes[0]); ++i) {
+        size_t packet_len = packet_sizes[i];
+        if (packet_len > buffer_len) break;
+        size_t batch_count = bytes_per_size / packet_len / BENCH_BATCHES;
+        double batch_bytes = (double)batch_count * packet_len;
+        volatile uint64_t hash_sink = 0;
+        fill_buffer_randomly(buffer_ptr, packet_len);
+
+        bench_series_reset(&ghash_series);
+        for (size_t batch = 0; batch < bench_series_total(&ghash_series); ++batch) {
+            bench_region region;
+            bench_region_begin(&region);
+            for (size_t m = 0; m < batch_count; ++m) {
+                __m128i hash_acc = ghash_update(&key, _mm_setzero_si128(), buffer_ptr, packet_len);
+                hash_sink += (uint64_t)_mm_cvtsi128_si64(hash_acc);
+            }
+            bench_region_end(&ghash_series, &region);
+        }
+
+        bench_series_reset(&ctr_series);
+        for (size_t batch = 0; batch < bench_series_total(&ctr_series); ++batch) {
+            bench_region region;
+            bench_region_begin(&region);
+            for (size_t m = 0; m < batch_count; ++m) {
+                aes_ctr_state ctr;
+                aes_ctr_init(&ctr, &key.aes, buffer_ptr);
+                aes_ctr_update(&ctr, buffer_ptr, buffer_ptr, packet_len);
+            }
+            bench_region_end(&ctr_series, &region);
+        }
+
+        bench_series_reset(&gcm_series);
+        for (size_t batch = 0; batch < bench_series_total(&gcm_series); ++batch) {
+            bench_region region;
+            bench_region_begin(&region);
+            for (size_t m = 0; m < batch_count; ++m) {
+                aes_gcm_encrypt(&key, iv, aad, sizeof(aad), buffer_ptr, packet_len, buffer_ptr, tag);
+            }
+            bench_region_end(&gcm_series, &region);
+        }
+
+        printf("%12zu %12zu %22s %22s %22s\n", packet_len, batch_count * BENCH_BATCHES,
+               format_cycles_per_byte(ghash_cell, sizeof(ghash_cell), &ghash_series, batch_bytes),
+               format_cycles_per_byte(ctr_cell, sizeof(ctr_cell), &ctr_series, batch_bytes),
+               format_cycles_per_byte(gcm_cell, sizeof(gcm_cell), &gcm_series, batch_bytes));
+        report_row_counters("    GHASH: ", &ghash_series, batch_bytes);
+        report_row_counters("    AES-CTR: ", &ctr_series, batch_bytes);
+        report_row_counters("    GCM: ", &gcm_series, batch_bytes);
+    }
+    bench_series_free(&ghash_series);
+    bench_series_free(&ctr_series);
+    bench_series_free(&gcm_series);
+}
+
+// Scaling curve for the parallel ECB and CTR paths on a buffer much larger
+// than the last-level cache. Throughput that stops improving by at least 10%
+// per added thread is reported as the memory-bandwidth ceiling.
+static void replicate_pattern(uint8_t *dest, size_t length, const uint8_t *pattern, size_t pattern_len) {
+    for (size_t offset = 0; offset < length; offset += pattern_len) {
+        size_t take = (length - offset < pattern_len) ? length - offset : pattern_len;
+        memcpy(dest + offset, pattern, take);
+    }
+}
+
+static void benchmark_parallel_scaling(void) {
+    const size_t buffer_len = 256u * 1048576u;
+    const int passes = 8;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = (online > MAX_WORKERS) ? MAX_WORKERS : (online < 1 ? 1 : (int)online);
+    uint8_t *work = (uint8_t *)malloc(buffer_len);
+    uint8_t *reference = (uint8_t *)malloc(buffer_len);
+    uint8_t pattern[4096];
+    uint8_t encryption_key[ENCRYPTION_UNIT_SIZE], counter[ENCRYPTION_UNIT_SIZE];
+    aes_ctx_data context;
+    bench_series series;
+
+    if (work == NULL || reference == NULL || bench_series_init(&series, "parallel", passes, 1) != 0) {
+        perror("Memory failure");
+        free(work);
+        free(reference);
+        return;
+    }
+
+    fill_buffer_randomly(pattern, sizeof(pattern));
+    fill_buffer_randomly(encryption_key, sizeof(encryption_key));
+    fill_buffer_randomly(counter, sizeof(counter));
+    generate_schedule(encryption_key, &context);
+
+    printf("\nParallel scaling (%zu MiB buffer, %d KiB chunks, %d passes, up to %d threads):\n",
+           buffer_len / 1048576, PARALLEL_CHUNK_SIZE / 1024, passes, max_threads);
+    printf("%8s %6s %12s %12s %10s %12s\n", "Threads", "Mode", "GB/s", "Cycles/byte", "Speedup", "Matches 1T");
+
+    // Workers inherit the creating thread's affinity, so the pool must not be
+    // started from the pinned benchmark thread. The perf counters only follow
+    // this thread, so the rows have no counter lines.
+    bench_unpin();
+
+    for (int mode = 0; mode < 2; ++mode) {
+        const char *mode_name = (mode == 0) ? "ECB" : "CTR";
+        double single_thread_rate = 0.0;
+        int plateau_threads = 0;
+
+        replicate_pattern(reference, buffer_len, pattern, sizeof(pattern));
+        if (mode == 0) {
+            process_data_buffer_pipelined(&context, reference, buffer_len);
+        } else {
+            aes_ctr_state state;
+            aes_ctr_init(&state, &context, counter);
+            aes_ctr_update(&state, reference, reference, buffer_len);
+        }
+
+        for (int threads = 1; threads <= max_threads; ++threads) {
+            aes_worker_pool pool;
+            if (aes_pool_create(&pool, threads) != 0) {
+                fprintf(stderr, "Could not start %d worker threads\n", threads);
+                aes_pool_destroy(&pool);
+                break;
+            }
+
+            replicate_pattern(work, buffer_len, pattern, sizeof(pattern));
+            if (mode == 0) process_data_buffer_parallel(&pool, &context, work, buffer_len);
+            else aes_ctr_parallel(&pool, &context, counter, work, buffer_len);
+            int matches = memcmp(work, reference, buffer_len) == 0;
+
+            bench_series_reset(&series);
+            for (size_t pass = 0; pass < bench_series_total(&series); ++pass) {
+                bench_region region;
+                bench_region_begin(&region);
+                if (mode == 0) process_data_buffer_parallel(&pool, &context, work, buffer_len);
+                else aes_ctr_parallel(&pool, &context, counter, work, buffer_len);
+                bench_region_end(&series, &region);
+            }
+            aes_pool_destroy(&pool);
+
+            double cycles_per_byte = median_cycles_per_unit(&series, (double)buffer_len);
+            double rate = 1.0 / bench_ticks_to_ns(cycles_per_byte);
+            if (threads == 1) single_thread_rate = rate;
+            // Scaling has stopped once a thread delivers less than 80% of what
+            // the single-threaded run did. (The step-to-step gain is no test:
+            // even linear scaling only adds 1/threads per extra thread.)
+            if (threads > 1 && plateau_threads == 0 && rate < 0.8 * threads * single_thread_rate) {
+                plateau_threads = threads - 1;
+            }
+
+            printf("%8d %6s %12.2f %12.3f %9.2fx %12s\n", threads, mode_name, rate, cycles_per_byte,
+                   rate / single_thread_rate, matches ? "yes" : "NO");
+        }
+
+        if (plateau_threads > 0) {
+            printf("%s throughput stops scaling at %d threads: memory bandwidth bound\n", mode_name, plateau_threads);
+        } else {
+            printf("%s throughput did not plateau up to %d threads: compute bound\n", mode_name, max_threads);
+        }
+    }
+
+    bench_repin();
+    bench_series_free(&series);
+    free(work);
+    free(reference);
+}
+
+// XTS batch throughput for 512-byte and 4 KiB sectors. The batch covers a
+// 4 MiB region per call, like a large sequential disk request.
+static void benchmark_xts(void) {
+    static const size_t sector_sizes[] = {512, 4096};
+    const size_t region_len = 4u * 1048576u;
+    const size_t bytes_per_size = 512u * 1048576u;
+    const size_t passes = bytes_per_size / region_len;
+    aes_xts_ctx context;
+    bench_series series;
+    uint8_t xts_key[32];
+    uint8_t *region_ptr = (uint8_t *)malloc(region_len);
+    uint8_t *reference_ptr = (uint8_t *)malloc(region_len);
+
+    printf("\nXTS known-answer check (IEEE 1619): %s\n", check_xts_known_answer() ? "PASS" : "FAIL");
+    if (region_ptr == NULL || reference_ptr == NULL || bench_series_init(&series, "XTS", passes, BENCH_WARMUP_RUNS) != 0) {
+        perror("Memory failure");
+        free(region_ptr);
+        free(reference_ptr);
+        return;
+    }
+
+    fill_buffer_randomly(xts_key, sizeof(xts_key));
+    fill_buffer_randomly(reference_ptr, region_len);
+    aes_xts_init(&context, xts_key, 128);
+
+    printf("XTS-AES-128 batch throughput (%zu MiB per size):\n", bytes_per_size / 1048576u);
+    printf("%12s %10s %16s %14s %14s %10s\n", "Sector (B)", "Direction", "Sectors/s", "Cycles/byte", "Cycles/sector",
+           "Roundtrip");
+    for (size_t i = 0; i < sizeof(sector_sizes) / sizeof(sector_sizes[0]); ++i) {
+        size_t sector_size = sector_sizes[i];
+        size_t sector_count = region_len / sector_size;
+        memcpy(region_ptr, reference_ptr, region_len);
+
+        // Encrypt and decrypt run the same number of passes, so the region is
+        // back to the reference after the decrypt row.
+        for (int decrypt = 0; decrypt < 2; ++decrypt) {
+            bench_series_reset(&series);
+            for (size_t pass = 0; pass < bench_series_total(&series); ++pass) {
+                bench_region region;
+                bench_region_begin(&region);
+                if (decrypt) {
+                    aes_xts_decrypt_sectors(&context, region_ptr, sector_size, 0, sector_count);
+                } else {
+                    aes_xts_encrypt_sectors(&context, region_ptr, sector_size, 0, sector_count);
+                }
+                bench_region_end(&series, &region);
+            }
+
+            double cycles_per_sector = median_cycles_per_unit(&series, (double)sector_count);
+            printf("%12zu %10s %16.0f %14.3f %14.1f %10s\n", sector_size, decrypt ? "decrypt" : "encrypt",
+                   1e9 / bench_ticks_to_ns(cycles_per_sector), cycles_per_sector / sector_size, cycles_per_sector,
+                   decrypt ? (memcmp(region_ptr, reference_ptr, region_len) == 0 ? "PASS" : "FAIL") : "-");
+            report_row_counters("    ", &series, (double)region_len);
+        }
+    }
+
+    // The parallel batch must match the serial one sector for sector. Pools
+    // are started unpinned, as in benchmark_parallel_scaling.
+    bench_unpin();
+    printf("XTS parallel vs serial (4 KiB sectors):\n");
+    printf("%8s %10s %12s\n", "Threads", "Direction", "Matches 1T");
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        aes_worker_pool pool;
+        size_t sector_count = region_len / 4096;
+        if (aes_pool_create(&pool, threads) != 0) {
+            fprintf(stderr, "Could not start %d worker threads\n", threads);
+            aes_pool_destroy(&pool);
+            break;
+        }
+        for (int decrypt = 0; decrypt < 2; ++decrypt) {
+            memcpy(region_ptr, reference_ptr, region_len);
+            aes_xts_crypt_sectors_parallel(&pool, &context, decrypt, region_ptr, 4096, 7, sector_count);
+            if (decrypt) aes_xts_decrypt_sectors(&context, reference_ptr, 4096, 7, sector_count);
+            else aes_xts_encrypt_sectors(&context, reference_ptr, 4096, 7, sector_count);
+            printf("%8d %10s %12s\n", threads, decrypt ? "decrypt" : "encrypt",
+                   memcmp(region_ptr, reference_ptr, region_len) == 0 ? "yes" : "NO");
+        }
+        aes_pool_destroy(&pool);
+    }
+    bench_repin();
+
+    bench_series_free(&series);
+    free(region_ptr);
+    free(reference_ptr);
+}
+
+// VAES against the 128-bit pipelined path for ECB and CTR. Both outputs are
+// compared before timing so a broken wide kernel cannot report a speedup.
+static void benchmark_vaes(int vaes_supported) {
+    static const size_t buffer_sizes[] = {1048576, 64u * 1048576u};
+    const size_t bytes_per_size = 1024u * 1048576u;
+    aes_ctx_data context;
+    aes_ctr_state state;
+    bench_series narrow_series = {0}, wide_series = {0};
+    uint8_t encryption_key[ENCRYPTION_UNIT_SIZE];
+    uint8_t counter[ENCRYPTION_UNIT_SIZE];
+    char narrow_cell[48], wide_cell[48];
+
+    printf("\nVAES vs 128-bit pipelined (%d blocks per VAES iteration):\n", VAES_BLOCKS);
+    if (!vaes_supported) {
+        printf("Not supported on this CPU\n");
+        return;
+    }
+
+    fill_buffer_randomly(encryption_key, sizeof(encryption_key));
+    fill_buffer_randomly(counter, sizeof(counter));
+    generate_schedule(encryption_key, &context);
+
+    printf("%12s %6s %22s %22s %10s %9s\n", "Buffer (B)", "Mode", "x8 c/B [95% CI]", "VAES c/B [95% CI]",
+           "Speedup", "Outputs");
+    for (size_t i = 0; i < sizeof(buffer_sizes) / sizeof(buffer_sizes[0]); ++i) {
+        size_t buffer_len = buffer_sizes[i];
+        size_t passes = bytes_per_size / buffer_len;
+        uint8_t *narrow_ptr = (uint8_t *)malloc(buffer_len);
+        uint8_t *wide_ptr = (uint8_t *)malloc(buffer_len);
+        if (narrow_ptr == NULL || wide_ptr == NULL ||
+            (bench_series_init(&narrow_series, "x8", passes, BENCH_WARMUP_RUNS) |
+             bench_series_init(&wide_series, "VAES", passes, BENCH_WARMUP_RUNS)) != 0) {
+            perror("Memory failure");
+            bench_series_free(&narrow_series);
+            bench_series_free(&wide_series);
+            free(narrow_ptr);
+            free(wide_ptr);
+            return;
+        }
+        fill_buffer_randomly(narrow_ptr, buffer_len);
+        memcpy(wide_ptr, narrow_ptr, buffer_len);
+
+        for (int mode = 0; mode < 2; ++mode) {
+            aes_ni_select_kernels(0);
+            bench_series_reset(&narrow_series);
+            for (size_t pass = 0; pass < bench_series_total(&narrow_series); ++pass) {
+                bench_region region;
+                bench_region_begin(&region);
+                if (mode == 0) {
+                    process_data_buffer_pipelined(&context, narrow_ptr, buffer_len);
+                } else {
+                    aes_ctr_init(&state, &context, counter);
+                    aes_ctr_update(&state, narrow_ptr, narrow_ptr, buffer_len);
+                }
+                bench_region_end(&narrow_series, &region);
+            }
+
+            aes_ni_select_kernels(1);
+            bench_series_reset(&wide_series);
+            for (size_t pass = 0; pass < bench_series_total(&wide_series); ++pass) {
+                bench_region region;
+                bench_region_begin(&region);
+                if (mode == 0) {
+                    process_data_buffer_vaes(&context, wide_ptr, buffer_len);
+                } else {
+                    aes_ctr_init(&state, &context, counter);
+                    aes_ctr_update(&state, wide_ptr, wide_ptr, buffer_len);
+                }
+                bench_region_end(&wide_series, &region);
+            }
+
+            // Both sides ran the same number of passes on identical input, so
+            // the buffers must still agree.
+            double narrow_cpb = median_cycles_per_unit(&narrow_series, (double)buffer_len);
+            double wide_cpb = median_cycles_per_unit(&wide_series, (double)buffer_len);
+            printf("%12zu %6s %22s %22s %9.2fx %9s\n", buffer_len, mode == 0 ? "ECB" : "CTR",
+                   format_cycles_per_byte(narrow_cell, sizeof(narrow_cell), &narrow_series, (double)buffer_len),
+                   format_cycles_per_byte(wide_cell, sizeof(wide_cell), &wide_series, (double)buffer_len),
+                   narrow_cpb / wide_cpb, memcmp(narrow_ptr, wide_ptr, buffer_len) == 0 ? "match" : "MISMATCH");
+            report_row_counters("    x8: ", &narrow_series, (double)buffer_len);
+            report_row_counters("    VAES: ", &wide_series, (double)buffer_len);
+        }
+
+        bench_series_free(&narrow_series);
+        bench_series_free(&wide_series);
+        free(narrow_ptr);
+        free(wide_ptr);
+    }
+}
+
+BENCH_HOST_DEFINE;
+
 int main() {
     aes_ctx_data context;
     const size_t buffer_len = 1048576;
     uint8_t *buffer_ptr = (uint8_t *)malloc(buffer_len);
+    uint8_t *pipelined_ptr = (uint8_t *)malloc(buffer_len);
     uint8_t encryption_key[ENCRYPTION_UNIT_SIZE];
 
-    if (buffer_ptr == NULL) {
+    if (buffer_ptr == NULL || pipelined_ptr == NULL) {
         perror("Memory failure");
+        free(buffer_ptr);
+        free(pipelined_ptr);
         return 1;
     }
 
+    fast_prng_seed(&fixture_prng, FIXTURE_SEED);
+    const int vaes_supported = __builtin_cpu_supports("vaes") && __builtin_cpu_supports("avx512f") &&
+                               __builtin_cpu_supports("avx512bw");
+    aes_ni_select_kernels(vaes_supported);
+
     const int test_iterations = 10000;
-    uint64_t accumulated_cycles = 0;
+    bench_series block_series, pipelined_series;
+    int mismatched_runs = 0;
 
-    for (int run_index = 0; run_index < test_iterations; ++run_index) {
+    if ((bench_series_init(&block_series, "one block at a time", test_iterations, BENCH_WARMUP_RUNS) |
+         bench_series_init(&pipelined_series, "pipelined x8", test_iterations, BENCH_WARMUP_RUNS)) != 0) {
+        perror("Memory failure");
+        bench_series_free(&block_series);
+        bench_series_free(&pipelined_series);
+        free(buffer_ptr);
+        free(pipelined_ptr);
+        return 1;
+    }
+    bench_init();
+    bench_print_environment();
+
+    for (size_t run_index = 0; run_index < bench_series_total(&block_series); ++run_index) {
         fill_buffer_randomly(buffer_ptr, buffer_len);
         fill_buffer_randomly(encryption_key, sizeof(encryption_key));
         generate_schedule(encryption_key, &context);
+        memcpy(pipelined_ptr, buffer_ptr, buffer_len);
 
-        uint64_t timer_start = __rdtsc();
+        bench_region region;
+        bench_region_begin(&region);
         process_data_buffer(&context, buffer_ptr, buffer_len);
-        uint64_t timer_end = __rdtsc();
+        bench_region_end(&block_series, &region);
+
+        bench_region_begin(&region);
+        process_data_buffer_pipelined(&context, pipelined_ptr, buffer_len);
+        bench_region_end(&pipelined_series, &region);
 
-        accumulated_cycles += (timer_end - timer_start);
+        if (memcmp(buffer_ptr, pipelined_ptr, buffer_len) != 0) {
+            mismatched_runs++;
+        }
     }
 
     printf("Sample encrypted output (first 16 bytes): ");
@@ -102,10 +2051,26 @@ int main() {
     printf("\n");
 
     printf("Data size: %zu bytes\n", buffer_len);
-    printf("Total runs: %d\n", test_iterations);
-    printf("Average cycles (AES only): %.2f\n", (double)accumulated_cycles / test_iterations);
-    printf("Average cycles per byte: %.2f\n", ((double)accumulated_cycles / test_iterations) / buffer_len);
+    printf("Total runs: %d (+%d warm-up)\n", test_iterations, BENCH_WARMUP_RUNS);
+    printf("Pipelined output mismatches: %d\n", mismatched_runs);
+    bench_report(&block_series, (double)buffer_len, "byte");
+    bench_report(&pipelined_series, (double)buffer_len, "byte");
+    printf("Pipelined speedup (medians): %.2fx\n",
+           median_cycles_per_unit(&block_series, 1.0) / median_cycles_per_unit(&pipelined_series, 1.0));
+    bench_series_free(&block_series);
+    bench_series_free(&pipelined_series);
+
+    benchmark_key_sizes(buffer_ptr, buffer_len);
+    benchmark_decryption(buffer_ptr, buffer_len);
+    benchmark_ctr_throughput(buffer_ptr, buffer_len);
+    benchmark_gcm(buffer_ptr, buffer_len);
+    benchmark_xts();
+    benchmark_parallel_scaling();
+    benchmark_vaes(vaes_supported);
+    aes_ni_select_kernels(vaes_supported);
 
     free(buffer_ptr);
+    free(pipelined_ptr);
     return 0;
 }
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -5,6 +6,10 @@
 #include <string.h>
 #include <x86intrin.h>
 
+#include "AES.h"
+#include "fast_prng.h"
+#include "bench_harness.h"
+
 #define WORDS_IN_STATE 4
 #define KEY_WORDS 4
 #define ROUND_COUNT 10
@@ -16,8 +21,52 @@ typedef struct {
 static const uint8_t substitution_box[256] = {
     0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
     0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static const uint32_t round_constants[ROUND_COUNT] = {
+    0x01000000, 0x02000000, 0x04000000, 0x08000000, 0x10000000,
+    0x20000000, 0x40000000, 0x80000000, 0x1b000000, 0x36000000,
 };
 
+// T-tables: each entry combines SubBytes and one MixColumns column for one
+// input byte position. Te1..Te3 are byte rotations of Te0 (4 x 1 KiB).
+static uint32_t Te0[256], Te1[256], Te2[256], Te3[256];
+
+static inline uint8_t gf_double(uint8_t value) {
+    return (uint8_t)((value << 1) ^ ((value & 0x80) ? 0x1b : 0x00));
+}
+
+static inline uint32_t rotate_right(uint32_t word, int bits) {
+    return (word >> bits) | (word << (32 - bits));
+}
+
+void init_t_tables(void) {
+    for (int i = 0; i < 256; ++i) {
+        uint8_t s = substitution_box[i];
+        uint8_t s2 = gf_double(s);
+        uint8_t s3 = (uint8_t)(s2 ^ s);
+        uint32_t word = ((uint32_t)s2 << 24) | ((uint32_t)s << 16) | ((uint32_t)s << 8) | s3;
+        Te0[i] = word;
+        Te1[i] = rotate_right(word, 8);
+        Te2[i] = rotate_right(word, 16);
+        Te3[i] = rotate_right(word, 24);
+    }
+}
+
 void expand_aes_key(const uint8_t *input_key, aes_crypto_ctx_t *context) {
     uint32_t *working_keys = context->key_schedule_words;
     const int total_words = WORDS_IN_STATE * (ROUND_COUNT + 1);
@@ -39,26 +88,62 @@ void expand_aes_key(const uint8_t *input_key, aes_crypto_ctx_t *context) {
                 (substitution_box[t & 0xFF] << 8) |
                 substitution_box[(t >> 24) & 0xFF];
 
-            t = sub_result ^ (0x1000000);
+            t = sub_result ^ round_constants[i / KEY_WORDS - 1];
         }
         working_keys[i] = working_keys[i - KEY_WORDS] ^ t;
     }
 }
 
+static inline uint32_t load_be32(const uint8_t *src) {
+    return ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 8) | src[3];
+}
+
+static inline void store_be32(uint8_t *dst, uint32_t word) {
+    dst[0] = (uint8_t)(word >> 24);
+    dst[1] = (uint8_t)(word >> 16);
+    dst[2] = (uint8_t)(word >> 8);
+    dst[3] = (uint8_t)word;
+}
+
+// One full round (SubBytes, ShiftRows, MixColumns, AddRoundKey) on the column
+// words s0..s3, writing t0..t3. ShiftRows is folded into which column each
+// table lookup reads from.
+#define T_TABLE_ROUND(s0, s1, s2, s3, t0, t1, t2, t3, rk) \
+    t0 = Te0[s0 >> 24] ^ Te1[(s1 >> 16) & 0xff] ^ Te2[(s2 >> 8) & 0xff] ^ Te3[s3 & 0xff] ^ (rk)[0]; \
+    t1 = Te0[s1 >> 24] ^ Te1[(s2 >> 16) & 0xff] ^ Te2[(s3 >> 8) & 0xff] ^ Te3[s0 & 0xff] ^ (rk)[1]; \
+    t2 = Te0[s2 >> 24] ^ Te1[(s3 >> 16) & 0xff] ^ Te2[(s0 >> 8) & 0xff] ^ Te3[s1 & 0xff] ^ (rk)[2]; \
+    t3 = Te0[s3 >> 24] ^ Te1[(s0 >> 16) & 0xff] ^ Te2[(s1 >> 8) & 0xff] ^ Te3[s2 & 0xff] ^ (rk)[3];
+
+// The last round has no MixColumns, so it uses the plain S-box.
+#define FINAL_ROUND_WORD(a, b, c, d, rk_word) \
+    (((uint32_t)substitution_box[a >> 24] << 24) ^ \
+     ((uint32_t)substitution_box[(b >> 16) & 0xff] << 16) ^ \
+     ((uint32_t)substitution_box[(c >> 8) & 0xff] << 8) ^ \
+     (uint32_t)substitution_box[d & 0xff] ^ (rk_word))
+
 void encrypt_single_block(aes_crypto_ctx_t *context, uint8_t *data_block) {
-    uint32_t *round_keys_ptr = context->key_schedule_words;
-    uint8_t current_state[16];
-    memcpy(current_state, data_block, 16);
+    const uint32_t *rk = context->key_schedule_words;
+    uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
 
-    for (int byte_idx = 0; byte_idx < 16; ++byte_idx) {
-        current_state[byte_idx] ^= ((uint8_t *)round_keys_ptr)[byte_idx];
-    }
+    s0 = load_be32(data_block) ^ rk[0];
+    s1 = load_be32(data_block + 4) ^ rk[1];
+    s2 = load_be32(data_block + 8) ^ rk[2];
+    s3 = load_be32(data_block + 12) ^ rk[3];
 
-    for (int j = 0; j < 16; ++j) {
-        current_state[j] ^= ((uint8_t *)round_keys_ptr)[16 + j];
-    }
+    T_TABLE_ROUND(s0, s1, s2, s3, t0, t1, t2, t3, rk + 4);
+    T_TABLE_ROUND(t0, t1, t2, t3, s0, s1, s2, s3, rk + 8);
+    T_TABLE_ROUND(s0, s1, s2, s3, t0, t1, t2, t3, rk + 12);
+    T_TABLE_ROUND(t0, t1, t2, t3, s0, s1, s2, s3, rk + 16);
+    T_TABLE_ROUND(s0, s1, s2, s3, t0, t1, t2, t3, rk + 20);
+    T_TABLE_ROUND(t0, t1, t2, t3, s0, s1, s2, s3, rk + 24);
+    T_TABLE_ROUND(s0, s1, s2, s3, t0, t1, t2, t3, rk + 28);
+    T_TABLE_ROUND(t0, t1, t2, t3, s0, s1, s2, s3, rk + 32);
+    T_TABLE_ROUND(s0, s1, s2, s3, t0, t1, t2, t3, rk + 36);
 
-    memcpy(data_block, current_state, 16);
+    store_be32(data_block, FINAL_ROUND_WORD(t0, t1, t2, t3, rk[40]));
+    store_be32(data_block + 4, FINAL_ROUND_WORD(t1, t2, t3, t0, rk[41]));
+    store_be32(data_block + 8, FINAL_ROUND_WORD(t2, t3, t0, t1, rk[42]));
+    store_be32(data_block + 12, FINAL_ROUND_WORD(t3, t0, t1, t2, rk[43]));
 }
 
 void encrypt_data_buffer(aes_crypto_ctx_t *context, uint8_t *data_ptr, size_t buffer_len) {
@@ -67,41 +152,596 @@ void encrypt_data_buffer(aes_crypto_ctx_t *context, uint8_t *data_ptr, size_t bu
     }
 }
 
-static uint32_t prng_state = 123456789;
-uint32_t prng_get_rand() {
-    prng_state = (1103515245 * prng_state + 12345) & 0x7fffffff;
-    return prng_state;
+// Constant-time bitsliced AES-128 (the "ct64" layout used by BearSSL). Eight
+// blocks are processed together: each of the eight __m128i slices holds one
+// bit position of every byte, with blocks 0-3 in the low 64-bit lane and
+// blocks 4-7 in the high lane. SubBytes is the Boyar-Peralta circuit, so no
+// memory address depends on key or data, and the key schedule uses the same
+// circuit instead of the S-box table.
+#define BITSLICE_BLOCKS 8
+
+static inline uint32_t load_le32(const uint8_t *src) {
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+static inline void store_le32(uint8_t *dst, uint32_t word) {
+    dst[0] = (uint8_t)word;
+    dst[1] = (uint8_t)(word >> 8);
+    dst[2] = (uint8_t)(word >> 16);
+    dst[3] = (uint8_t)(word >> 24);
+}
+
+static void bitslice_sbox(__m128i *q) {
+    const __m128i ones = _mm_set1_epi32(-1);
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7;
+    __m128i y1, y2, y3, y4, y5, y6, y7, y8, y9, y10, y11, y12, y13, y14, y15, y16, y17, y18, y19, y20, y21;
+    __m128i z0, z1, z2, z3, z4, z5, z6, z7, z8, z9, z10, z11, z12, z13, z14, z15, z16, z17;
+    __m128i t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    __m128i t20, t21, t22, t23, t24, t25, t26, t27, t28, t29, t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    __m128i t40, t41, t42, t43, t44, t45, t46, t47, t48, t49, t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    __m128i t60, t61, t62, t63, t64, t65, t66, t67;
+    __m128i s0, s1, s2, s3, s4, s5, s6, s7;
+
+    #define XOR(a, b) _mm_xor_si128(a, b)
+    #define AND(a, b) _mm_and_si128(a, b)
+    #define XNOR(a, b) _mm_xor_si128(a, _mm_xor_si128(b, ones))
+
+    x0 = q[7]; x1 = q[6]; x2 = q[5]; x3 = q[4];
+    x4 = q[3]; x5 = q[2]; x6 = q[1]; x7 = q[0];
+
+    // Top linear transformation.
+    y14 = XOR(x3, x5);   y13 = XOR(x0, x6);   y9 = XOR(x0, x3);    y8 = XOR(x0, x5);
+    t0 = XOR(x1, x2);    y1 = XOR(t0, x7);    y4 = XOR(y1, x3);    y12 = XOR(y13, y14);
+    y2 = XOR(y1, x0);    y5 = XOR(y1, x6);    y3 = XOR(y5, y8);    t1 = XOR(x4, y12);
+    y15 = XOR(t1, x5);   y20 = XOR(t1, x1);   y6 = XOR(y15, x7);   y10 = XOR(y15, t0);
+    y11 = XOR(y20, y9);  y7 = XOR(x7, y11);   y17 = XOR(y10, y11); y19 = XOR(y10, y8);
+    y16 = XOR(t0, y11);  y21 = XOR(y13, y16); y18 = XOR(x0, y16);
+
+    // Non-linear section: inversion in GF(2^8) through GF(2^4).
+    t2 = AND(y12, y15);  t3 = AND(y3, y6);    t4 = XOR(t3, t2);    t5 = AND(y4, x7);
+    t6 = XOR(t5, t2);    t7 = AND(y13, y16);  t8 = AND(y5, y1);    t9 = XOR(t8, t7);
+    t10 = AND(y2, y7);   t11 = XOR(t10, t7);  t12 = AND(y9, y11);  t13 = AND(y14, y17);
+    t14 = XOR(t13, t12); t15 = AND(y8, y10);  t16 = XOR(t15, t12); t17 = XOR(t4, t14);
+    t18 = XOR(t6, t16);  t19 = XOR(t9, t14);  t20 = XOR(t11, t16); t21 = XOR(t17, y20);
+    t22 = XOR(t18, y19); t23 = XOR(t19, y21); t24 = XOR(t20, y18);
+
+    t25 = XOR(t21, t22); t26 = AND(t21, t23); t27 = XOR(t24, t26); t28 = AND(t25, t27);
+    t29 = XOR(t28, t22); t30 = XOR(t23, t24); t31 = XOR(t22, t26); t32 = AND(t31, t30);
+    t33 = XOR(t32, t24); t34 = XOR(t23, t33); t35 = XOR(t27, t33); t36 = AND(t24, t35);
+    t37 = XOR(t36, t34); t38 = XOR(t27, t36); t39 = AND(t29, t38); t40 = XOR(t25, t39);
+
+    t41 = XOR(t40, t37); t42 = XOR(t29, t33); t43 = XOR(t29, t40); t44 = XOR(t33, t37);
+    t45 = XOR(t42, t41);
+    z0 = AND(t44, y15);  z1 = AND(t37, y6);   z2 = AND(t33, x7);   z3 = AND(t43, y16);
+    z4 = AND(t40, y1);   z5 = AND(t29, y7);   z6 = AND(t42, y11);  z7 = AND(t45, y17);
+    z8 = AND(t41, y10);  z9 = AND(t44, y12);  z10 = AND(t37, y3);  z11 = AND(t33, y4);
+    z12 = AND(t43, y13); z13 = AND(t40, y5);  z14 = AND(t29, y2);  z15 = AND(t42, y9);
+    z16 = AND(t45, y14); z17 = AND(t41, y8);
+
+    // Bottom linear transformation.
+    t46 = XOR(z15, z16); t47 = XOR(z10, z11); t48 = XOR(z5, z13);  t49 = XOR(z9, z10);
+    t50 = XOR(z2, z12);  t51 = XOR(z2, z5);   t52 = XOR(z7, z8);   t53 = XOR(z0, z3);
+    t54 = XOR(z6, z7);   t55 = XOR(z16, z17); t56 = XOR(z12, t48); t57 = XOR(t50, t53);
+    t58 = XOR(z4, t46);  t59 = XOR(z3, t54);  t60 = XOR(t46, t57); t61 = XOR(z14, t57);
+    t62 = XOR(t52, t58); t63 = XOR(t49, t58); t64 = XOR(z4, t59);  t65 = XOR(t61, t62);
+    t66 = XOR(z1, t63);  s0 = XOR(t59, t63);  s6 = XNOR(t56, t62); s7 = XNOR(t48, t60);
+    t67 = XOR(t64, t65); s3 = XOR(t53, t66);  s4 = XOR(t51, t66);  s5 = XOR(t47, t65);
+    s1 = XNOR(t64, s3);  s2 = XNOR(t55, t67);
+
+    q[7] = s0; q[6] = s1; q[5] = s2; q[4] = s3;
+    q[3] = s4; q[2] = s5; q[1] = s6; q[0] = s7;
+
+    #undef XNOR
+    #undef AND
+    #undef XOR
+}
+
+// Transposes between byte order and bit slices within each 64-bit lane.
+static void bitslice_ortho(__m128i *q) {
+    #define SWAP_SLICES(x, y, low_mask, shift) do { \
+        const __m128i lo_ = _mm_set1_epi64x((long long)(low_mask)); \
+        const __m128i hi_ = _mm_set1_epi64x((long long)~(uint64_t)(low_mask)); \
+        __m128i a_ = (x), b_ = (y); \
+        (x) = _mm_or_si128(_mm_and_si128(a_, lo_), _mm_slli_epi64(_mm_and_si128(b_, lo_), shift)); \
+        (y) = _mm_or_si128(_mm_srli_epi64(_mm_and_si128(a_, hi_), shift), _mm_and_si128(b_, hi_)); \
+    } while (0)
+
+    SWAP_SLICES(q[0], q[1], 0x5555555555555555ULL, 1);
+    SWAP_SLICES(q[2], q[3], 0x5555555555555555ULL, 1);
+    SWAP_SLICES(q[4], q[5], 0x5555555555555555ULL, 1);
+    SWAP_SLICES(q[6], q[7], 0x5555555555555555ULL, 1);
+
+    SWAP_SLICES(q[0], q[2], 0x3333333333333333ULL, 2);
+    SWAP_SLICES(q[1], q[3], 0x3333333333333333ULL, 2);
+    SWAP_SLICES(q[4], q[6], 0x3333333333333333ULL, 2);
+    SWAP_SLICES(q[5], q[7], 0x3333333333333333ULL, 2);
+
+    SWAP_SLICES(q[0], q[4], 0x0F0F0F0F0F0F0F0FULL, 4);
+    SWAP_SLICES(q[1], q[5], 0x0F0F0F0F0F0F0F0FULL, 4);
+    SWAP_SLICES(q[2], q[6], 0x0F0F0F0F0F0F0F0FULL, 4);
+    SWAP_SLICES(q[3], q[7], 0x0F0F0F0F0F0F0F0FULL, 4);
+
+    #undef SWAP_SLICES
+}
+
+// Spreads one block (four little-endian words) across two 64-bit words so
+// that four blocks can share a slice.
+static void bitslice_interleave_in(uint64_t *q0, uint64_t *q1, const uint32_t *w) {
+    uint64_t x0 = w[0], x1 = w[1], x2 = w[2], x3 = w[3];
+    x0 |= (x0 << 16); x1 |= (x1 << 16); x2 |= (x2 << 16); x3 |= (x3 << 16);
+    x0 &= 0x0000FFFF0000FFFFULL; x1 &= 0x0000FFFF0000FFFFULL;
+    x2 &= 0x0000FFFF0000FFFFULL; x3 &= 0x0000FFFF0000FFFFULL;
+    x0 |= (x0 << 8); x1 |= (x1 << 8); x2 |= (x2 << 8); x3 |= (x3 << 8);
+    x0 &= 0x00FF00FF00FF00FFULL; x1 &= 0x00FF00FF00FF00FFULL;
+    x2 &= 0x00FF00FF00FF00FFULL; x3 &= 0x00FF00FF00FF00FFULL;
+    *q0 = x0 | (x2 << 8);
+    *q1 = x1 | (x3 << 8);
+}
+
+static void bitslice_interleave_out(uint32_t *w, uint64_t q0, uint64_t q1) {
+    uint64_t x0 = q0 & 0x00FF00FF00FF00FFULL;
+    uint64_t x1 = q1 & 0x00FF00FF00FF00FFULL;
+    uint64_t x2 = (q0 >> 8) & 0x00FF00FF00FF00FFULL;
+    uint64_t x3 = (q1 >> 8) & 0x00FF00FF00FF00FFULL;
+    x0 |= (x0 >> 8); x1 |= (x1 >> 8); x2 |= (x2 >> 8); x3 |= (x3 >> 8);
+    x0 &= 0x0000FFFF0000FFFFULL; x1 &= 0x0000FFFF0000FFFFULL;
+    x2 &= 0x0000FFFF0000FFFFULL; x3 &= 0x0000FFFF0000FFFFULL;
+    w[0] = (uint32_t)x0 | (uint32_t)(x0 >> 16);
+    w[1] = (uint32_t)x1 | (uint32_t)(x1 >> 16);
+    w[2] = (uint32_t)x2 | (uint32_t)(x2 >> 16);
+    w[3] = (uint32_t)x3 | (uint32_t)(x3 >> 16);
+}
+
+static uint32_t bitsliced_sub_word(uint32_t word) {
+    __m128i q[8];
+    for (int i = 0; i < 8; ++i) q[i] = _mm_setzero_si128();
+    q[0] = _mm_cvtsi32_si128((int)word);
+    bitslice_ortho(q);
+    bitslice_sbox(q);
+    bitslice_ortho(q);
+    return (uint32_t)_mm_cvtsi128_si32(q[0]);
+}
+
+// Expands a 128-, 192- or 256-bit key. Returns 0 on success, -1 for any
+// other key size.
+int expand_bitsliced_key_bits(const uint8_t *input_key, int key_bits, aes_bitsliced_ctx_t *context) {
+    if (key_bits != 128 && key_bits != 192 && key_bits != 256) return -1;
+
+    const int key_words = key_bits / 32;
+    const int num_rounds = key_words + 6;
+    const int total_words = WORDS_IN_STATE * (num_rounds + 1);
+    uint32_t words[WORDS_IN_STATE * (MAX_ROUNDS + 1)];
+
+    for (int i = 0; i < key_words; ++i) {
+        words[i] = load_le32(input_key + 4 * i);
+    }
+    uint32_t t = words[key_words - 1];
+    for (int i = key_words; i < total_words; ++i) {
+        if ((i % key_words) == 0) {
+            t = (t << 24) | (t >> 8);
+            t = bitsliced_sub_word(t) ^ (round_constants[i / key_words - 1] >> 24);
+        } else if (key_words > 6 && (i % key_words) == 4) {
+            t = bitsliced_sub_word(t);
+        }
+        t ^= words[i - key_words];
+        words[i] = t;
+    }
+    context->num_rounds = num_rounds;
+
+    // Each round key is replicated into all four block positions of a lane,
+    // then every bit of a nibble is widened to the whole nibble.
+    for (int round_idx = 0; round_idx <= num_rounds; ++round_idx) {
+        uint64_t lo, hi;
+        __m128i q[8];
+        bitslice_interleave_in(&lo, &hi, words + 4 * round_idx);
+        for (int i = 0; i < 4; ++i) {
+            q[i] = _mm_set1_epi64x((long long)lo);
+            q[i + 4] = _mm_set1_epi64x((long long)hi);
+        }
+        bitslice_ortho(q);
+
+        for (int half = 0; half < 2; ++half) {
+            uint64_t compressed =
+                ((uint64_t)_mm_cvtsi128_si64(q[4 * half + 0]) & 0x1111111111111111ULL) |
+                ((uint64_t)_mm_cvtsi128_si64(q[4 * half + 1]) & 0x2222222222222222ULL) |
+                ((uint64_t)_mm_cvtsi128_si64(q[4 * half + 2]) & 0x4444444444444444ULL) |
+                ((uint64_t)_mm_cvtsi128_si64(q[4 * half + 3]) & 0x8888888888888888ULL);
+            for (int bit = 0; bit < 4; ++bit) {
+                uint64_t x = (compressed >> bit) & 0x1111111111111111ULL;
+                context->round_key_slices[8 * round_idx + 4 * half + bit] =
+                    _mm_set1_epi64x((long long)((x << 4) - x));
+            }
+        }
+    }
+    return 0;
+}
+
+void expand_bitsliced_key(const uint8_t *input_key, aes_bitsliced_ctx_t *context) {
+    expand_bitsliced_key_bits(input_key, 128, context);
+}
+
+static inline void bitslice_add_round_key(__m128i *q, const __m128i *round_key) {
+    for (int i = 0; i < 8; ++i) q[i] = _mm_xor_si128(q[i], round_key[i]);
+}
+
+static inline void bitslice_shift_rows(__m128i *q) {
+    const __m128i keep = _mm_set1_epi64x(0x000000000000FFFFLL);
+    const __m128i m1 = _mm_set1_epi64x(0x00000000FFF00000LL);
+    const __m128i m2 = _mm_set1_epi64x(0x00000000000F0000LL);
+    const __m128i m3 = _mm_set1_epi64x(0x0000FF0000000000LL);
+    const __m128i m4 = _mm_set1_epi64x(0x000000FF00000000LL);
+    const __m128i m5 = _mm_set1_epi64x((long long)0xF000000000000000ULL);
+    const __m128i m6 = _mm_set1_epi64x(0x0FFF000000000000LL);
+
+    for (int i = 0; i < 8; ++i) {
+        __m128i x = q[i];
+        __m128i r = _mm_and_si128(x, keep);
+        r = _mm_or_si128(r, _mm_srli_epi64(_mm_and_si128(x, m1), 4));
+        r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(x, m2), 12));
+        r = _mm_or_si128(r, _mm_srli_epi64(_mm_and_si128(x, m3), 8));
+        r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(x, m4), 8));
+        r = _mm_or_si128(r, _mm_srli_epi64(_mm_and_si128(x, m5), 12));
+        r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(x, m6), 4));
+        q[i] = r;
+    }
+}
+
+static inline void bitslice_mix_columns(__m128i *q) {
+    #define ROTR16(x) _mm_or_si128(_mm_srli_epi64(x, 16), _mm_slli_epi64(x, 48))
+    #define ROTR32(x) _mm_shuffle_epi32(x, 0xB1)
+    #define X(a, b) _mm_xor_si128(a, b)
+
+    __m128i q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3], q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    __m128i r0 = ROTR16(q0), r1 = ROTR16(q1), r2 = ROTR16(q2), r3 = ROTR16(q3);
+    __m128i r4 = ROTR16(q4), r5 = ROTR16(q5), r6 = ROTR16(q6), r7 = ROTR16(q7);
+
+    q[0] = X(X(q7, r7), X(r0, ROTR32(X(q0, r0))));
+    q[1] = X(X(X(q0, r0), X(q7, r7)), X(r1, ROTR32(X(q1, r1))));
+    q[2] = X(X(q1, r1), X(r2, ROTR32(X(q2, r2))));
+    q[3] = X(X(X(q2, r2), X(q7, r7)), X(r3, ROTR32(X(q3, r3))));
+    q[4] = X(X(X(q3, r3), X(q7, r7)), X(r4, ROTR32(X(q4, r4))));
+    q[5] = X(X(q4, r4), X(r5, ROTR32(X(q5, r5))));
+    q[6] = X(X(q5, r5), X(r6, ROTR32(X(q6, r6))));
+    q[7] = X(X(q6, r6), X(r7, ROTR32(X(q7, r7))));
+
+    #undef X
+    #undef ROTR32
+    #undef ROTR16
+}
+
+// InvSubBytes reuses the forward circuit: undoing the affine step, applying
+// SubBytes and undoing the affine step again leaves only the field inverse.
+static void bitslice_inverse_affine(__m128i *q) {
+    const __m128i ones = _mm_set1_epi32(-1);
+    __m128i q0 = _mm_xor_si128(q[0], ones), q1 = _mm_xor_si128(q[1], ones);
+    __m128i q2 = q[2], q3 = q[3], q4 = q[4];
+    __m128i q5 = _mm_xor_si128(q[5], ones), q6 = _mm_xor_si128(q[6], ones);
+    __m128i q7 = q[7];
+
+    #define XOR3(a, b, c) _mm_xor_si128(_mm_xor_si128(a, b), c)
+    q[7] = XOR3(q1, q4, q6);
+    q[6] = XOR3(q0, q3, q5);
+    q[5] = XOR3(q7, q2, q4);
+    q[4] = XOR3(q6, q1, q3);
+    q[3] = XOR3(q5, q0, q2);
+    q[2] = XOR3(q4, q7, q1);
+    q[1] = XOR3(q3, q6, q0);
+    q[0] = XOR3(q2, q5, q7);
+    #undef XOR3
+}
+
+static void bitslice_inverse_sbox(__m128i *q) {
+    bitslice_inverse_affine(q);
+    bitslice_sbox(q);
+    bitslice_inverse_affine(q);
+}
+
+static inline void bitslice_inverse_shift_rows(__m128i *q) {
+    const __m128i keep = _mm_set1_epi64x(0x000000000000FFFFLL);
+    const __m128i m1 = _mm_set1_epi64x(0x000000000FFF0000LL);
+    const __m128i m2 = _mm_set1_epi64x(0x00000000F0000000LL);
+    const __m128i m3 = _mm_set1_epi64x(0x000000FF00000000LL);
+    const __m128i m4 = _mm_set1_epi64x(0x0000FF0000000000LL);
+    const __m128i m5 = _mm_set1_epi64x(0x000F000000000000LL);
+    const __m128i m6 = _mm_set1_epi64x((long long)0xFFF0000000000000ULL);
+
+    for (int i = 0; i < 8; ++i) {
+        __m128i x = q[i];
+        __m128i r = _mm_and_si128(x, keep);
+        r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(x, m1), 4));
+        r = _mm_or_si128(r, _mm_srli_epi64(_mm_and_si128(x, m2), 12));
+        r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(x, m3), 8));
+        r = _mm_or_si128(r, _mm_srli_epi64(_mm_and_si128(x, m4), 8));
+        r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(x, m5), 12));
+        r = _mm_or_si128(r, _mm_srli_epi64(_mm_and_si128(x, m6), 4));
+        q[i] = r;
+    }
+}
+
+static inline void bitslice_inverse_mix_columns(__m128i *q) {
+    #define ROTR16(x) _mm_or_si128(_mm_srli_epi64(x, 16), _mm_slli_epi64(x, 48))
+    #define ROTR32(x) _mm_shuffle_epi32(x, 0xB1)
+    #define X(a, b) _mm_xor_si128(a, b)
+
+    __m128i q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3], q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    __m128i r0 = ROTR16(q0), r1 = ROTR16(q1), r2 = ROTR16(q2), r3 = ROTR16(q3);
+    __m128i r4 = ROTR16(q4), r5 = ROTR16(q5), r6 = ROTR16(q6), r7 = ROTR16(q7);
+
+    q[0] = X(X(X(q5, q6), X(q7, r0)), X(X(r5, r7), ROTR32(X(X(q0, q5), X(X(q6, r0), r5)))));
+    q[1] = X(X(X(q0, q5), X(r0, r1)), X(X(r5, r6), X(r7, ROTR32(X(X(q1, q5), X(X(q7, r1), X(r5, r6)))))));
+    q[2] = X(X(X(q0, q1), X(q6, r1)), X(X(r2, r6), X(r7, ROTR32(X(X(q0, q2), X(X(q6, r2), X(r6, r7)))))));
+    q[3] = X(X(X(X(q0, q1), X(q2, q5)), X(X(q6, r0), X(r2, r3))),
+             X(r5, ROTR32(X(X(X(q0, q1), X(q3, q5)), X(X(q6, q7), X(X(r0, r3), X(r5, r7)))))));
+    q[4] = X(X(X(X(q1, q2), X(q3, q5)), X(X(r1, r3), X(r4, r5))),
+             X(X(r6, r7), ROTR32(X(X(X(q1, q2), X(q4, q5)), X(X(q7, r1), X(X(r4, r5), r6))))));
+    q[5] = X(X(X(X(q2, q3), X(q4, q6)), X(X(r2, r4), X(r5, r6))),
+             X(r7, ROTR32(X(X(X(q2, q3), X(q5, q6)), X(X(r2, r5), X(r6, r7))))));
+    q[6] = X(X(X(q3, q4), X(q5, q7)), X(X(X(r3, r5), X(r6, r7)),
+             ROTR32(X(X(X(q3, q4), X(q6, q7)), X(X(r3, r6), r7)))));
+    q[7] = X(X(X(q4, q5), X(q6, r4)), X(X(r6, r7), ROTR32(X(X(q4, q5), X(X(q7, r4), r7)))));
+
+    #undef X
+    #undef ROTR32
+    #undef ROTR16
+}
+
+// Loads BITSLICE_BLOCKS consecutive blocks into bit-slice order.
+static void bitslice_load_x8(__m128i *q, const uint8_t *data_blocks) {
+    uint32_t words[4 * BITSLICE_BLOCKS];
+    uint64_t low_lane[8], high_lane[8];
+
+    for (int i = 0; i < 4 * BITSLICE_BLOCKS; ++i) {
+        words[i] = load_le32(data_blocks + 4 * i);
+    }
+    for (int i = 0; i < 4; ++i) {
+        bitslice_interleave_in(&low_lane[i], &low_lane[i + 4], words + 4 * i);
+        bitslice_interleave_in(&high_lane[i], &high_lane[i + 4], words + 16 + 4 * i);
+    }
+    for (int i = 0; i < 8; ++i) {
+        q[i] = _mm_set_epi64x((long long)high_lane[i], (long long)low_lane[i]);
+    }
+    bitslice_ortho(q);
+}
+
+static void bitslice_store_x8(__m128i *q, uint8_t *data_blocks) {
+    uint32_t words[4 * BITSLICE_BLOCKS];
+    uint64_t low_lane[8], high_lane[8];
+
+    bitslice_ortho(q);
+    for (int i = 0; i < 8; ++i) {
+        low_lane[i] = (uint64_t)_mm_cvtsi128_si64(q[i]);
+        high_lane[i] = (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(q[i], q[i]));
+    }
+    for (int i = 0; i < 4; ++i) {
+        bitslice_interleave_out(words + 4 * i, low_lane[i], low_lane[i + 4]);
+        bitslice_interleave_out(words + 16 + 4 * i, high_lane[i], high_lane[i + 4]);
+    }
+    for (int i = 0; i < 4 * BITSLICE_BLOCKS; ++i) {
+        store_le32(data_blocks + 4 * i, words[i]);
+    }
+}
+
+// Encrypts BITSLICE_BLOCKS consecutive blocks in place.
+void encrypt_bitsliced_x8(const aes_bitsliced_ctx_t *context, uint8_t *data_blocks) {
+    const int num_rounds = context->num_rounds;
+    __m128i q[8];
+
+    bitslice_load_x8(q, data_blocks);
+    bitslice_add_round_key(q, context->round_key_slices);
+    for (int round_idx = 1; round_idx < num_rounds; ++round_idx) {
+        bitslice_sbox(q);
+        bitslice_shift_rows(q);
+        bitslice_mix_columns(q);
+        bitslice_add_round_key(q, context->round_key_slices + 8 * round_idx);
+    }
+    bitslice_sbox(q);
+    bitslice_shift_rows(q);
+    bitslice_add_round_key(q, context->round_key_slices + 8 * num_rounds);
+    bitslice_store_x8(q, data_blocks);
+}
+
+// Decrypts BITSLICE_BLOCKS consecutive blocks in place with the encryption
+// schedule, running the inverse rounds in reverse order.
+void decrypt_bitsliced_x8(const aes_bitsliced_ctx_t *context, uint8_t *data_blocks) {
+    const int num_rounds = context->num_rounds;
+    __m128i q[8];
+
+    bitslice_load_x8(q, data_blocks);
+    bitslice_add_round_key(q, context->round_key_slices + 8 * num_rounds);
+    for (int round_idx = num_rounds - 1; round_idx > 0; --round_idx) {
+        bitslice_inverse_shift_rows(q);
+        bitslice_inverse_sbox(q);
+        bitslice_add_round_key(q, context->round_key_slices + 8 * round_idx);
+        bitslice_inverse_mix_columns(q);
+    }
+    bitslice_inverse_shift_rows(q);
+    bitslice_inverse_sbox(q);
+    bitslice_add_round_key(q, context->round_key_slices);
+    bitslice_store_x8(q, data_blocks);
+}
+
+static void bitsliced_buffer_apply(const aes_bitsliced_ctx_t *context, uint8_t *data_ptr, size_t buffer_len,
+                                   void (*kernel)(const aes_bitsliced_ctx_t *, uint8_t *)) {
+    const size_t stride = 16 * BITSLICE_BLOCKS;
+    size_t offset = 0;
+    for (; offset + stride <= buffer_len; offset += stride) {
+        kernel(context, data_ptr + offset);
+    }
+    if (offset < buffer_len) {
+        uint8_t tail[16 * BITSLICE_BLOCKS] = {0};
+        memcpy(tail, data_ptr + offset, buffer_len - offset);
+        kernel(context, tail);
+        memcpy(data_ptr + offset, tail, buffer_len - offset);
+    }
+}
+
+void encrypt_data_buffer_bitsliced(const aes_bitsliced_ctx_t *context, uint8_t *data_ptr, size_t buffer_len) {
+    bitsliced_buffer_apply(context, data_ptr, buffer_len, encrypt_bitsliced_x8);
 }
+
+void decrypt_data_buffer_bitsliced(const aes_bitsliced_ctx_t *context, uint8_t *data_ptr, size_t buffer_len) {
+    bitsliced_buffer_apply(context, data_ptr, buffer_len, decrypt_bitsliced_x8);
+}
+
+#ifndef AES_LIBRARY
+// Reference AES-NI path for the throughput comparison only; it reuses the
+// T-table key schedule and is skipped on CPUs without AES-NI.
+__attribute__((target("aes,sse2")))
+static void encrypt_data_buffer_aesni(const aes_crypto_ctx_t *context, uint8_t *data_ptr, size_t buffer_len) {
+    __m128i round_keys[ROUND_COUNT + 1];
+    for (int round_idx = 0; round_idx <= ROUND_COUNT; ++round_idx) {
+        uint8_t key_bytes[16];
+        for (int i = 0; i < 4; ++i) {
+            store_be32(key_bytes + 4 * i, context->key_schedule_words[4 * round_idx + i]);
+        }
+        round_keys[round_idx] = _mm_loadu_si128((const __m128i *)key_bytes);
+    }
+
+    size_t offset = 0;
+    for (; offset + 128 <= buffer_len; offset += 128) {
+        __m128i lanes[8];
+        for (int lane = 0; lane < 8; ++lane) {
+            lanes[lane] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data_ptr + offset + 16 * lane)),
+                                        round_keys[0]);
+        }
+        for (int round_idx = 1; round_idx < ROUND_COUNT; ++round_idx) {
+            for (int lane = 0; lane < 8; ++lane) lanes[lane] = _mm_aesenc_si128(lanes[lane], round_keys[round_idx]);
+        }
+        for (int lane = 0; lane < 8; ++lane) {
+            lanes[lane] = _mm_aesenclast_si128(lanes[lane], round_keys[ROUND_COUNT]);
+            _mm_storeu_si128((__m128i *)(data_ptr + offset + 16 * lane), lanes[lane]);
+        }
+    }
+    for (; offset < buffer_len; offset += 16) {
+        __m128i block = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data_ptr + offset)), round_keys[0]);
+        for (int round_idx = 1; round_idx < ROUND_COUNT; ++round_idx) block = _mm_aesenc_si128(block, round_keys[round_idx]);
+        _mm_storeu_si128((__m128i *)(data_ptr + offset), _mm_aesenclast_si128(block, round_keys[ROUND_COUNT]));
+    }
+}
+
+// Fixture data and keys come from the vectorized generator in fast_prng.h;
+// the fixed seed keeps runs comparable.
+#define FIXTURE_SEED 123456789
+static fast_prng fixture_prng;
+
 void fill_random_bytes(uint8_t *destination, size_t length) {
-    for (size_t k = 0; k < length; ++k) {
-        destination[k] = (uint8_t)(prng_get_rand() & 0xff);
+    fast_prng_fill(&fixture_prng, destination, length);
+}
+
+static void parse_hex(const char *hex, uint8_t *out) {
+    for (size_t i = 0; hex[2 * i] != '\0'; ++i) {
+        unsigned int byte_value;
+        sscanf(hex + 2 * i, "%2x", &byte_value);
+        out[i] = (uint8_t)byte_value;
     }
 }
 
+// FIPS-197 Appendix B (cipher example) and Appendix C.1 (AES-128).
+static int check_fips197_vectors(void) {
+    static const char *vectors[][3] = {
+        {"2b7e151628aed2a6abf7158809cf4f3c", "3243f6a8885a308d313198a2e0370734", "3925841d02dc09fbdc118597196a0b32"},
+        {"000102030405060708090a0b0c0d0e0f", "00112233445566778899aabbccddeeff", "69c4e0d86a7b0430d8cdb78070b4c55a"},
+    };
+    aes_crypto_ctx_t context_state;
+    aes_bitsliced_ctx_t bitsliced_state;
+    uint8_t secret_key[16], block[16], expected[16];
+
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i) {
+        parse_hex(vectors[i][0], secret_key);
+        parse_hex(vectors[i][2], expected);
+
+        parse_hex(vectors[i][1], block);
+        expand_aes_key(secret_key, &context_state);
+        encrypt_data_buffer(&context_state, block, sizeof(block));
+        if (memcmp(block, expected, sizeof(expected)) != 0) return 0;
+
+        parse_hex(vectors[i][1], block);
+        expand_bitsliced_key(secret_key, &bitsliced_state);
+        encrypt_data_buffer_bitsliced(&bitsliced_state, block, sizeof(block));
+        if (memcmp(block, expected, sizeof(expected)) != 0) return 0;
+    }
+    return 1;
+}
+
+BENCH_HOST_DEFINE;
+
 int main() {
     aes_crypto_ctx_t context_state;
+    aes_bitsliced_ctx_t bitsliced_state;
     const size_t buffer_size = 1024 * 1024;
     uint8_t *buffer = (uint8_t *)malloc(buffer_size);
+    uint8_t *bitsliced_buffer = (uint8_t *)malloc(buffer_size);
+    uint8_t *aesni_buffer = (uint8_t *)malloc(buffer_size);
     uint8_t secret_key[16];
 
-    if (!buffer) {
+    if (!buffer || !bitsliced_buffer || !aesni_buffer) {
         perror("Memory allocation failed");
+        free(buffer);
+        free(bitsliced_buffer);
+        free(aesni_buffer);
+        return 1;
+    }
+
+    fast_prng_seed(&fixture_prng, FIXTURE_SEED);
+    init_t_tables();
+    if (!check_fips197_vectors()) {
+        fprintf(stderr, "FIPS-197 known-answer check: FAIL\n");
+        free(buffer);
+        free(bitsliced_buffer);
+        free(aesni_buffer);
         return 1;
     }
+    printf("FIPS-197 known-answer check: PASS\n");
 
+    const int have_aesni = __builtin_cpu_supports("aes");
     const int iterations = 10000;
-    uint64_t accumulated_cycles = 0;
+    bench_series table_series, bitsliced_series, aesni_series;
+    int mismatched_runs = 0;
 
-    for (int count = 0; count < iterations; ++count) {
+    int series_failed = bench_series_init(&table_series, "T-table", iterations, BENCH_WARMUP_RUNS) |
+                        bench_series_init(&bitsliced_series, "bitsliced x8 (constant time)", iterations,
+                                          BENCH_WARMUP_RUNS) |
+                        bench_series_init(&aesni_series, "AES-NI x8", iterations, BENCH_WARMUP_RUNS);
+    if (series_failed) {
+        perror("Memory allocation failed");
+        bench_series_free(&table_series);
+        bench_series_free(&bitsliced_series);
+        bench_series_free(&aesni_series);
+        free(buffer);
+        free(bitsliced_buffer);
+        free(aesni_buffer);
+        return 1;
+    }
+    bench_init();
+    bench_print_environment();
+
+    for (size_t count = 0; count < bench_series_total(&table_series); ++count) {
         fill_random_bytes(buffer, buffer_size);
         fill_random_bytes(secret_key, sizeof(secret_key));
         expand_aes_key(secret_key, &context_state);
+        expand_bitsliced_key(secret_key, &bitsliced_state);
+        memcpy(bitsliced_buffer, buffer, buffer_size);
+        memcpy(aesni_buffer, buffer, buffer_size);
 
-        uint64_t tick_start = __rdtsc();
+        bench_region region;
+        bench_region_begin(&region);
         encrypt_data_buffer(&context_state, buffer, buffer_size);
-        uint64_t tick_end = __rdtsc();
+        bench_region_end(&table_series, &region);
+
+        bench_region_begin(&region);
+        encrypt_data_buffer_bitsliced(&bitsliced_state, bitsliced_buffer, buffer_size);
+        bench_region_end(&bitsliced_series, &region);
 
-        accumulated_cycles += (tick_end - tick_start);
+        if (have_aesni) {
+            bench_region_begin(&region);
+            encrypt_data_buffer_aesni(&context_state, aesni_buffer, buffer_size);
+            bench_region_end(&aesni_series, &region);
+        }
+
+        if (memcmp(buffer, bitsliced_buffer, buffer_size) != 0 ||
+            (have_aesni && memcmp(buffer, aesni_buffer, buffer_size) != 0)) {
+            mismatched_runs++;
+        }
     }
 
     printf("Sample encrypted output (first 16 bytes): ");
@@ -111,10 +751,22 @@ int main() {
     printf("\n");
 
     printf("Data size: %zu bytes\n", buffer_size);
-    printf("Total runs: %d\n", iterations);
-    printf("Average cycles (AES only): %.2f\n", (double)accumulated_cycles / iterations);
-    printf("Average cycles per byte: %.2f\n", ((double)accumulated_cycles / iterations) / buffer_size);
+    printf("Total runs: %d (+%d warm-up)\n", iterations, BENCH_WARMUP_RUNS);
+    printf("Output mismatches between backends: %d\n", mismatched_runs);
+    bench_report(&table_series, (double)buffer_size, "byte");
+    bench_report(&bitsliced_series, (double)buffer_size, "byte");
+    if (have_aesni) {
+        bench_report(&aesni_series, (double)buffer_size, "byte");
+    } else {
+        printf("[AES-NI x8]\nNot supported on this CPU\n");
+    }
 
+    bench_series_free(&table_series);
+    bench_series_free(&bitsliced_series);
+    bench_series_free(&aesni_series);
     free(buffer);
+    free(bitsliced_buffer);
+    free(aesni_buffer);
     return 0;
 }
+#endif
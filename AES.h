@@ -0,0 +1,221 @@
+#ifndef AES_H
+#define AES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <emmintrin.h>
+#include <pthread.h>
+
+// Public AES API shared by the backends in AES.c (bitsliced, portable SSE2)
+// and AES-NI.c (aesenc/aesdec, VAES on AVX-512 hosts). aes_dispatch.c probes
+// the CPU once and binds each new key to the fastest backend the host
+// supports. Build the library with -DAES_LIBRARY so the per-file benchmark
+// mains are left out:
+//
+//   gcc -O2 -DAES_LIBRARY aes_dispatch.c AES.c AES-NI.c -pthread
+
+#define AES_BLOCK_SIZE 16
+#define AES128_ROUNDS 10
+#define AES192_ROUNDS 12
+#define AES256_ROUNDS 14
+#define MAX_ROUNDS AES256_ROUNDS
+
+// AES-NI backend. dec_words holds the equivalent-inverse schedule for aesdec.
+// It is derived from sch_words whenever a key is expanded, so a key used in
+// both directions is only expanded once.
+typedef struct {
+    __m128i sch_words[MAX_ROUNDS + 1];
+    __m128i dec_words[MAX_ROUNDS + 1];
+    int num_rounds;
+} aes_ctx_data;
+
+// Bitsliced backend: eight slices per round key, each slice replicated for
+// the eight blocks processed together. Both directions use this schedule.
+typedef struct {
+    __m128i round_key_slices[8 * (MAX_ROUNDS + 1)];
+    int num_rounds;
+} aes_bitsliced_ctx_t;
+
+// Counter mode. The 128-bit counter block is kept as two host-order halves so
+// the increment is plain integer arithmetic; it is byte-swapped into the
+// big-endian block layout only when the keystream is generated.
+typedef struct {
+    const aes_ctx_data *context;
+    uint64_t counter_hi;
+    uint64_t counter_lo;
+    uint8_t keystream[AES_BLOCK_SIZE];
+    size_t keystream_used;
+} aes_ctr_state;
+
+// GCM key and streaming state. There is one hash power per lane of the x8
+// pipeline, so eight ciphertext blocks fold into GHASH with one reduction.
+#define AES_GCM_HASH_POWERS 8
+
+typedef struct {
+    aes_ctx_data aes;
+    __m128i hash_powers[AES_GCM_HASH_POWERS];  // hash_powers[i] = H^(i+1)
+} aes_gcm_key;
+
+typedef struct {
+    const aes_gcm_key *key;
+    aes_ctr_state ctr;
+    __m128i hash_acc;
+    __m128i tag_mask;
+    uint64_t aad_len;
+    uint64_t text_len;
+} aes_gcm_state;
+
+// XTS (IEEE 1619). data_key encrypts the blocks and tweak_key encrypts the
+// sector number into the first tweak; each later block's tweak is the
+// previous one multiplied by x in GF(2^128) (little-endian bit order,
+// reduction constant 0x87). Sectors must be whole multiples of 16 bytes, so
+// ciphertext stealing is never needed.
+typedef struct {
+    aes_ctx_data data_key;
+    aes_ctx_data tweak_key;
+} aes_xts_ctx;
+
+// Parallel bulk modes. A buffer is cut into PARALLEL_CHUNK_SIZE chunks that
+// stay resident in a core's L2 while they are processed. Each worker starts
+// with a contiguous range of chunks, pops from the front of its own range and,
+// once empty, steals the back half of another worker's range. The calling
+// thread acts as worker 0, so a pool of one thread runs with no helpers.
+// Kernels only ever see whole chunks plus their byte offset, which is enough
+// for position-dependent modes to produce the single-threaded output.
+#define PARALLEL_CHUNK_SIZE (64 * 1024)
+#define MAX_WORKERS 64
+
+typedef void (*chunk_kernel_fn)(const void *job_arg, uint8_t *chunk, size_t chunk_len, size_t chunk_offset);
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next_chunk;
+    size_t end_chunk;
+} worker_queue;
+
+typedef struct aes_worker_pool aes_worker_pool;
+
+typedef struct {
+    aes_worker_pool *pool;
+    int worker_index;
+} worker_slot;
+
+struct aes_worker_pool {
+    int thread_count;       // threads running, the caller included
+    int queue_count;        // queue locks initialised; more than thread_count after a failed start
+    pthread_t threads[MAX_WORKERS];
+    worker_slot slots[MAX_WORKERS];
+    worker_queue queues[MAX_WORKERS];
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;
+    pthread_cond_t job_done;
+    unsigned long job_generation;
+    int helpers_busy;
+    int shutting_down;
+
+    chunk_kernel_fn kernel;
+    const void *job_arg;
+    uint8_t *buffer;
+    size_t buffer_length;
+};
+
+typedef enum {
+    AES_BACKEND_BITSLICED,
+    AES_BACKEND_AESNI,
+    AES_BACKEND_VAES,
+    AES_BACKEND_COUNT
+} aes_backend_id;
+
+typedef struct {
+    int aesni;
+    int pclmul;
+    int ssse3;
+    int sse41;
+    int avx2;
+    int avx512f;
+    int avx512bw;
+    int vaes;
+} aes_cpu_features;
+
+typedef struct aes_backend_ops aes_backend_ops;
+
+// A key remembers the backend it was expanded for, so keys created before
+// aes_use_backend() keep working afterwards.
+typedef struct {
+    union {
+        aes_ctx_data aesni;
+        aes_bitsliced_ctx_t bitsliced;
+    } schedule;
+    const aes_backend_ops *ops;
+} aes_key;
+
+// Backend entry points (AES-NI.c).
+int aes_expand_key(const uint8_t *secret_key, int key_bits, aes_ctx_data *context);
+void process_data_buffer_pipelined(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length);
+void process_data_buffer_decrypt_pipelined(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length);
+void process_data_buffer_vaes(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length);
+void process_data_buffer_decrypt_vaes(const aes_ctx_data *context, uint8_t *data_buffer, size_t buffer_length);
+void aes_ni_select_kernels(int has_vaes);
+
+// Streaming CTR and GCM (AES-NI.c). Non-final GCM updates must be multiples
+// of AES_BLOCK_SIZE; CTR updates may be split anywhere.
+void aes_ctr_init(aes_ctr_state *state, const aes_ctx_data *context, const uint8_t *initial_counter);
+void aes_ctr_update(aes_ctr_state *state, const uint8_t *input, uint8_t *output, size_t length);
+int aes_gcm_init_key_bits(aes_gcm_key *key, const uint8_t *secret_key, int key_bits);
+void aes_gcm_start(aes_gcm_state *state, const aes_gcm_key *key, const uint8_t *iv,
+                   const uint8_t *aad, size_t aad_len);
+void aes_gcm_encrypt_update(aes_gcm_state *state, const uint8_t *input, uint8_t *output, size_t length);
+void aes_gcm_decrypt_update(aes_gcm_state *state, const uint8_t *input, uint8_t *output, size_t length);
+void aes_gcm_finish(aes_gcm_state *state, uint8_t *tag);
+int aes_gcm_finish_verify(aes_gcm_state *state, const uint8_t *tag);
+
+// CBC (AES-NI.c). Lengths are whole blocks; iv is updated to the last
+// ciphertext block so a message can be split across calls.
+void aes_cbc_encrypt(const aes_ctx_data *context, uint8_t *iv, uint8_t *data_buffer, size_t buffer_length);
+void aes_cbc_decrypt(const aes_ctx_data *context, uint8_t *iv, uint8_t *data_buffer, size_t buffer_length);
+
+// XTS sector batches (AES-NI.c). Both return -1 unless sector_size is a
+// non-zero multiple of AES_BLOCK_SIZE.
+int aes_xts_init(aes_xts_ctx *context, const uint8_t *key, int key_bits);
+int aes_xts_encrypt_sectors(const aes_xts_ctx *context, uint8_t *data_buffer, size_t sector_size,
+                            uint64_t first_sector, size_t sector_count);
+int aes_xts_decrypt_sectors(const aes_xts_ctx *context, uint8_t *data_buffer, size_t sector_size,
+                            uint64_t first_sector, size_t sector_count);
+
+// Worker pool and the parallel bulk modes (AES-NI.c). aes_pool_create returns
+// 0 on success; call aes_pool_destroy either way. The parallel calls produce
+// the same output as the single-threaded ones at any thread count.
+int aes_pool_create(aes_worker_pool *pool, int thread_count);
+void aes_pool_destroy(aes_worker_pool *pool);
+void aes_pool_run(aes_worker_pool *pool, chunk_kernel_fn kernel, const void *job_arg,
+                  uint8_t *buffer, size_t buffer_length);
+void process_data_buffer_parallel(aes_worker_pool *pool, aes_ctx_data *context,
+                                  uint8_t *data_buffer, size_t buffer_length);
+void process_data_buffer_decrypt_parallel(aes_worker_pool *pool, aes_ctx_data *context,
+                                          uint8_t *data_buffer, size_t buffer_length);
+void aes_ctr_parallel(aes_worker_pool *pool, const aes_ctx_data *context, const uint8_t *initial_counter,
+                      uint8_t *data_buffer, size_t buffer_length);
+int aes_cbc_decrypt_parallel(aes_worker_pool *pool, const aes_ctx_data *context, uint8_t *iv,
+                             uint8_t *data_buffer, size_t buffer_length);
+int aes_xts_crypt_sectors_parallel(aes_worker_pool *pool, const aes_xts_ctx *context, int decrypt,
+                                   uint8_t *data_buffer, size_t sector_size, uint64_t first_sector,
+                                   size_t sector_count);
+
+// Backend entry points (AES.c).
+int expand_bitsliced_key_bits(const uint8_t *input_key, int key_bits, aes_bitsliced_ctx_t *context);
+void encrypt_data_buffer_bitsliced(const aes_bitsliced_ctx_t *context, uint8_t *data_ptr, size_t buffer_len);
+void decrypt_data_buffer_bitsliced(const aes_bitsliced_ctx_t *context, uint8_t *data_ptr, size_t buffer_len);
+
+// Dispatch (aes_dispatch.c). aes_init returns 0 on success and -1 for a key
+// size other than 128, 192 or 256 bits. Buffer lengths passed to
+// aes_encrypt_blocks/aes_decrypt_blocks must be multiples of AES_BLOCK_SIZE.
+const aes_cpu_features *aes_cpu_get_features(void);
+int aes_backend_available(aes_backend_id backend);
+int aes_use_backend(aes_backend_id backend);
+const char *aes_backend_name(void);
+int aes_init(aes_key *key, const uint8_t *key_bytes, int key_bits);
+void aes_encrypt_blocks(const aes_key *key, uint8_t *data, size_t length);
+void aes_decrypt_blocks(const aes_key *key, uint8_t *data, size_t length);
+
+#endif
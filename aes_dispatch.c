@@ -0,0 +1,316 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cpuid.h>
+#include <x86intrin.h>
+
+#include "AES.h"
+#include "fast_prng.h"
+#include "bench_harness.h"
+
+// Build: gcc -O2 -DAES_LIBRARY aes_dispatch.c AES.c AES-NI.c -pthread
+// Define AES_NO_MAIN as well to link the API into another program.
+
+struct aes_backend_ops {
+    const char *name;
+    int (*init)(aes_key *key, const uint8_t *key_bytes, int key_bits);
+    void (*encrypt)(const aes_key *key, uint8_t *data, size_t length);
+    void (*decrypt)(const aes_key *key, uint8_t *data, size_t length);
+};
+
+static int bitsliced_init(aes_key *key, const uint8_t *key_bytes, int key_bits) {
+    return expand_bitsliced_key_bits(key_bytes, key_bits, &key->schedule.bitsliced);
+}
+
+static void bitsliced_encrypt(const aes_key *key, uint8_t *data, size_t length) {
+    encrypt_data_buffer_bitsliced(&key->schedule.bitsliced, data, length);
+}
+
+static void bitsliced_decrypt(const aes_key *key, uint8_t *data, size_t length) {
+    decrypt_data_buffer_bitsliced(&key->schedule.bitsliced, data, length);
+}
+
+static int aesni_init(aes_key *key, const uint8_t *key_bytes, int key_bits) {
+    return aes_expand_key(key_bytes, key_bits, &key->schedule.aesni);
+}
+
+static void aesni_encrypt(const aes_key *key, uint8_t *data, size_t length) {
+    process_data_buffer_pipelined(&key->schedule.aesni, data, length);
+}
+
+static void aesni_decrypt(const aes_key *key, uint8_t *data, size_t length) {
+    process_data_buffer_decrypt_pipelined(&key->schedule.aesni, data, length);
+}
+
+static void vaes_encrypt(const aes_key *key, uint8_t *data, size_t length) {
+    process_data_buffer_vaes(&key->schedule.aesni, data, length);
+}
+
+static void vaes_decrypt(const aes_key *key, uint8_t *data, size_t length) {
+    process_data_buffer_decrypt_vaes(&key->schedule.aesni, data, length);
+}
+
+static const aes_backend_ops backend_table[AES_BACKEND_COUNT] = {
+    [AES_BACKEND_BITSLICED] = {"bitsliced (SSE2, constant time)", bitsliced_init, bitsliced_encrypt, bitsliced_decrypt},
+    [AES_BACKEND_AESNI] = {"AES-NI x8", aesni_init, aesni_encrypt, aesni_decrypt},
+    [AES_BACKEND_VAES] = {"VAES x32 (AVX-512)", aesni_init, vaes_encrypt, vaes_decrypt},
+};
+
+static aes_cpu_features cpu_features;
+static const aes_backend_ops *active_backend = &backend_table[AES_BACKEND_BITSLICED];
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+
+static uint64_t read_xcr0(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Reads cpu_features as they stand; detection itself uses this before the
+// features are published through ensure_detected().
+static int backend_supported(aes_backend_id backend) {
+    switch (backend) {
+    case AES_BACKEND_BITSLICED: return 1;
+    case AES_BACKEND_AESNI: return cpu_features.aesni && cpu_features.ssse3 && cpu_features.sse41;
+    case AES_BACKEND_VAES:
+        return backend_supported(AES_BACKEND_AESNI) && cpu_features.vaes &&
+               cpu_features.avx512f && cpu_features.avx512bw;
+    default: return 0;
+    }
+}
+
+// AVX state must be enabled by the OS (XCR0) as well as reported by CPUID,
+// otherwise the first ymm/zmm instruction faults.
+static void detect_cpu_features(void) {
+    unsigned int eax, ebx, ecx, edx;
+    int os_avx = 0, os_avx512 = 0;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        cpu_features.aesni = (ecx & bit_AES) != 0;
+        cpu_features.pclmul = (ecx & bit_PCLMUL) != 0;
+        cpu_features.ssse3 = (ecx & bit_SSSE3) != 0;
+        cpu_features.sse41 = (ecx & bit_SSE4_1) != 0;
+        if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX)) {
+            uint64_t xcr0 = read_xcr0();
+            os_avx = (xcr0 & 0x6) == 0x6;
+            os_avx512 = os_avx && (xcr0 & 0xE0) == 0xE0;
+        }
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        cpu_features.avx2 = os_avx && (ebx & bit_AVX2) != 0;
+        cpu_features.avx512f = os_avx512 && (ebx & bit_AVX512F) != 0;
+        cpu_features.avx512bw = os_avx512 && (ebx & bit_AVX512BW) != 0;
+        cpu_features.vaes = os_avx && (ecx & bit_VAES) != 0;
+    }
+
+    if (backend_supported(AES_BACKEND_VAES)) {
+        active_backend = &backend_table[AES_BACKEND_VAES];
+        aes_ni_select_kernels(1);
+    } else if (backend_supported(AES_BACKEND_AESNI)) {
+        active_backend = &backend_table[AES_BACKEND_AESNI];
+    }
+}
+
+static void ensure_detected(void) {
+    pthread_once(&detect_once, detect_cpu_features);
+}
+
+const aes_cpu_features *aes_cpu_get_features(void) {
+    ensure_detected();
+    return &cpu_features;
+}
+
+int aes_backend_available(aes_backend_id backend) {
+    ensure_detected();
+    return backend_supported(backend);
+}
+
+// Overrides the automatic choice for keys initialised from now on. Returns -1
+// if the CPU cannot run the requested backend. Choosing AES-NI or VAES also
+// switches the streaming modes and parallel kernels, which share AES-NI.c.
+int aes_use_backend(aes_backend_id backend) {
+    ensure_detected();
+    if (!aes_backend_available(backend)) return -1;
+    active_backend = &backend_table[backend];
+    if (backend == AES_BACKEND_AESNI || backend == AES_BACKEND_VAES) {
+        aes_ni_select_kernels(backend == AES_BACKEND_VAES);
+    }
+    return 0;
+}
+
+const char *aes_backend_name(void) {
+    ensure_detected();
+    return active_backend->name;
+}
+
+int aes_init(aes_key *key, const uint8_t *key_bytes, int key_bits) {
+    ensure_detected();
+    key->ops = active_backend;
+    return key->ops->init(key, key_bytes, key_bits);
+}
+
+void aes_encrypt_blocks(const aes_key *key, uint8_t *data, size_t length) {
+    key->ops->encrypt(key, data, length);
+}
+
+void aes_decrypt_blocks(const aes_key *key, uint8_t *data, size_t length) {
+    key->ops->decrypt(key, data, length);
+}
+
+#ifndef AES_NO_MAIN
+static void parse_hex(const char *hex, uint8_t *out) {
+    for (size_t i = 0; hex[2 * i] != '\0'; ++i) {
+        unsigned int byte_value;
+        sscanf(hex + 2 * i, "%2x", &byte_value);
+        out[i] = (uint8_t)byte_value;
+    }
+}
+
+// FIPS-197 Appendix C.1-C.3 through the public API, both directions.
+static int check_fips197_vectors(void) {
+    static const struct { int key_bits; const char *key, *plain, *cipher; } vectors[] = {
+        {128, "000102030405060708090a0b0c0d0e0f",
+         "00112233445566778899aabbccddeeff", "69c4e0d86a7b0430d8cdb78070b4c55a"},
+        {192, "000102030405060708090a0b0c0d0e0f1011121314151617",
+         "00112233445566778899aabbccddeeff", "dda97ca4864cdfe06eaf70a0ec0d7191"},
+        {256, "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+         "00112233445566778899aabbccddeeff", "8ea2b7ca516745bfeafc49904b496089"},
+    };
+    aes_key key;
+    uint8_t key_bytes[32], plain[16], cipher[16], block[16];
+
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i) {
+        parse_hex(vectors[i].key, key_bytes);
+        parse_hex(vectors[i].plain, plain);
+        parse_hex(vectors[i].cipher, cipher);
+        if (aes_init(&key, key_bytes, vectors[i].key_bits) != 0) return 0;
+
+        memcpy(block, plain, sizeof(block));
+        aes_encrypt_blocks(&key, block, sizeof(block));
+        if (memcmp(block, cipher, sizeof(block)) != 0) return 0;
+        aes_decrypt_blocks(&key, block, sizeof(block));
+        if (memcmp(block, plain, sizeof(block)) != 0) return 0;
+    }
+    return 1;
+}
+
+#define FIXTURE_SEED 123456789
+static fast_prng fixture_prng;
+
+static void fill_buffer_randomly(uint8_t *dest_buf, size_t length) {
+    fast_prng_fill(&fixture_prng, dest_buf, length);
+}
+
+// Times every backend this CPU can run on the same data and checks that
+// each one round-trips and agrees with the first.
+static int benchmark_backends(uint8_t *buffer_ptr, size_t buffer_len) {
+    const int iterations = 200;
+    uint8_t *reference = (uint8_t *)malloc(buffer_len);
+    uint8_t *expected = (uint8_t *)malloc(buffer_len);
+    uint8_t secret_key[16];
+    bench_series encrypt_series = {0}, decrypt_series = {0};
+    int have_expected = 0, mismatches = 0;
+
+    if (!reference || !expected ||
+        (bench_series_init(&encrypt_series, "encrypt", iterations, BENCH_WARMUP_RUNS) |
+         bench_series_init(&decrypt_series, "decrypt", iterations, BENCH_WARMUP_RUNS)) != 0) {
+        perror("Memory allocation failed");
+        bench_series_free(&encrypt_series);
+        bench_series_free(&decrypt_series);
+        free(reference);
+        free(expected);
+        return -1;
+    }
+    fill_buffer_randomly(reference, buffer_len);
+    fill_buffer_randomly(secret_key, sizeof(secret_key));
+
+    for (int backend = 0; backend < AES_BACKEND_COUNT; ++backend) {
+        aes_key key;
+        bench_summary encrypt_summary, decrypt_summary;
+
+        if (aes_use_backend((aes_backend_id)backend) != 0) {
+            printf("[%s]\nNot supported on this CPU\n", backend_table[backend].name);
+            continue;
+        }
+        aes_init(&key, secret_key, 128);
+        memcpy(buffer_ptr, reference, buffer_len);
+        bench_series_reset(&encrypt_series);
+        bench_series_reset(&decrypt_series);
+        for (size_t count = 0; count < bench_series_total(&encrypt_series); ++count) {
+            bench_region region;
+            bench_region_begin(&region);
+            aes_encrypt_blocks(&key, buffer_ptr, buffer_len);
+            bench_region_end(&encrypt_series, &region);
+            bench_region_begin(&region);
+            aes_decrypt_blocks(&key, buffer_ptr, buffer_len);
+            bench_region_end(&decrypt_series, &region);
+        }
+        if (memcmp(buffer_ptr, reference, buffer_len) != 0) mismatches++;
+
+        aes_encrypt_blocks(&key, buffer_ptr, buffer_len);
+        if (!have_expected) {
+            memcpy(expected, buffer_ptr, buffer_len);
+            have_expected = 1;
+        } else if (memcmp(buffer_ptr, expected, buffer_len) != 0) {
+            mismatches++;
+        }
+
+        bench_summarize(&encrypt_series, &encrypt_summary);
+        bench_summarize(&decrypt_series, &decrypt_summary);
+        printf("[%s]\n", aes_backend_name());
+        printf("Encrypt cycles per byte: %.3f (95%% CI %.3f-%.3f)\n", encrypt_summary.median / buffer_len,
+               encrypt_summary.ci_low / buffer_len, encrypt_summary.ci_high / buffer_len);
+        printf("Decrypt cycles per byte: %.3f (95%% CI %.3f-%.3f)\n", decrypt_summary.median / buffer_len,
+               decrypt_summary.ci_low / buffer_len, decrypt_summary.ci_high / buffer_len);
+        bench_report_counters("Encrypt counters: ", &encrypt_summary, (double)buffer_len, "byte");
+        bench_report_counters("Decrypt counters: ", &decrypt_summary, (double)buffer_len, "byte");
+    }
+
+    bench_series_free(&encrypt_series);
+    bench_series_free(&decrypt_series);
+    free(reference);
+    free(expected);
+    return mismatches;
+}
+
+BENCH_HOST_DEFINE;
+
+int main() {
+    const aes_cpu_features *features = aes_cpu_get_features();
+    fast_prng_seed(&fixture_prng, FIXTURE_SEED);
+    const size_t buffer_size = 1024 * 1024;
+
+    printf("CPU features: aes=%d pclmul=%d avx2=%d avx512f=%d avx512bw=%d vaes=%d\n",
+           features->aesni, features->pclmul, features->avx2, features->avx512f, features->avx512bw,
+           features->vaes);
+    printf("Selected backend: %s\n", aes_backend_name());
+
+    for (int backend = 0; backend < AES_BACKEND_COUNT; ++backend) {
+        if (aes_use_backend((aes_backend_id)backend) != 0) continue;
+        if (!check_fips197_vectors()) {
+            fprintf(stderr, "FIPS-197 known-answer check (%s): FAIL\n", aes_backend_name());
+            return 1;
+        }
+        printf("FIPS-197 known-answer check (%s): PASS\n", aes_backend_name());
+    }
+
+    uint8_t *buffer_ptr = (uint8_t *)malloc(buffer_size);
+    if (!buffer_ptr) {
+        perror("Memory allocation failed");
+        return 1;
+    }
+
+    bench_init();
+    bench_print_environment();
+    printf("Data size: %zu bytes\n", buffer_size);
+    int mismatches = benchmark_backends(buffer_ptr, buffer_size);
+    printf("Backend mismatches: %d\n", mismatches);
+
+    free(buffer_ptr);
+    return mismatches == 0 ? 0 : 1;
+}
+#endif
@@ -1,9 +1,14 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <limits.h>
 #include <string.h>
 
+#include "bench_harness.h"
+
+#define ITERATIONS 1000
+
 long long comparisons = 0;
 long long swaps = 0;
 
@@ -14,6 +19,7 @@ typedef struct {
     long long min_swaps;
     long long max_swaps;
     long long avg_swaps;
+    bench_summary timing;  // cycles (and counters) per sort call
 } Statistics;
 
 // Function prototypes
@@ -29,22 +35,30 @@ void heapify(int arr[], int n, int i);
 
 void initializeArray(int arr[], int size);
 void resetCounters();
+void sortArray(const char* algorithmName, int arr[], int size);
 Statistics runAlgorithmTest(const char* algorithmName, int size);
 
+#ifndef BENCH_DRIVER
+BENCH_HOST_DEFINE;
+
 int main() {
     srand(time(NULL));
+    bench_init();
     
     printf("Comprehensive Sorting Algorithm Analysis\n");
     printf("=======================================\n");
     printf("Array sizes: 100, 200, 300, ..., 1000\n");
     printf("Each test runs 1000 iterations\n");
-    printf("Tracking: Min, Max, Average comparisons and swaps\n\n");
+    printf("Tracking: Min, Max, Average comparisons and swaps\n");
+    bench_print_environment();
+    printf("\n");
     
     int sizes[] = {100, 200, 300, 400, 500, 600, 700, 800, 900, 1000};
     int numSizes = 10;
     
     FILE* file = fopen("detailed_results.csv", "w");
-    fprintf(file, "Algorithm,Size,Min_Comparisons,Max_Comparisons,Avg_Comparisons,Min_Swaps,Max_Swaps,Avg_Swaps\n");
+    fprintf(file, "Algorithm,Size,Min_Comparisons,Max_Comparisons,Avg_Comparisons,Min_Swaps,Max_Swaps,Avg_Swaps,"
+                  "Median_Cycles,Cycles_CI_Low,Cycles_CI_High,IPC,Cache_Misses,Branch_Misses\n");
     
     const char* algorithms[] = {"Bubble Sort", "Selection Sort", "Insertion Sort", "Merge Sort", "Quick Sort", "Heap Sort"};
     int numAlgorithms = 6;
@@ -65,12 +79,26 @@ int main() {
                    stats.min_comparisons, stats.max_comparisons, stats.avg_comparisons);
             printf("  Swaps       - Min: %lld, Max: %lld, Avg: %lld\n", 
                    stats.min_swaps, stats.max_swaps, stats.avg_swaps);
+            printf("  Cycles      - Median: %.0f (95%% CI %.0f-%.0f), p5: %.0f, p95: %.0f\n",
+                   stats.timing.median, stats.timing.ci_low, stats.timing.ci_high,
+                   stats.timing.p5, stats.timing.p95);
+            bench_report_counters("  Counters    - ", &stats.timing, (double)stats.avg_comparisons, "comparison");
             
-            // Write to CSV file
-            fprintf(file, "%s,%d,%lld,%lld,%lld,%lld,%lld,%lld\n",
+            // Write to CSV file; counter columns stay empty without perf access
+            const double* counters = stats.timing.counters;
+            fprintf(file, "%s,%d,%lld,%lld,%lld,%lld,%lld,%lld,%.0f,%.0f,%.0f,",
                     algorithms[j], size,
                     stats.min_comparisons, stats.max_comparisons, stats.avg_comparisons,
-                    stats.min_swaps, stats.max_swaps, stats.avg_swaps);
+                    stats.min_swaps, stats.max_swaps, stats.avg_swaps,
+                    stats.timing.median, stats.timing.ci_low, stats.timing.ci_high);
+            if (stats.timing.have_counters && counters[BENCH_EVENT_CYCLES] > 0) {
+                fprintf(file, "%.3f", counters[BENCH_EVENT_INSTRUCTIONS] / counters[BENCH_EVENT_CYCLES]);
+            }
+            fprintf(file, ",");
+            if (counters[BENCH_EVENT_CACHE_MISSES] >= 0) fprintf(file, "%.1f", counters[BENCH_EVENT_CACHE_MISSES]);
+            fprintf(file, ",");
+            if (counters[BENCH_EVENT_BRANCH_MISSES] >= 0) fprintf(file, "%.1f", counters[BENCH_EVENT_BRANCH_MISSES]);
+            fprintf(file, "\n");
         }
     }
     
@@ -83,10 +111,33 @@ int main() {
     
     return 0;
 }
+#endif
+
+// Dispatch to the sorting algorithm by name
+void sortArray(const char* algorithmName, int arr[], int size) {
+    if (strcmp(algorithmName, "Bubble Sort") == 0) {
+        bubbleSort(arr, size);
+    } else if (strcmp(algorithmName, "Selection Sort") == 0) {
+        selectionSort(arr, size);
+    } else if (strcmp(algorithmName, "Insertion Sort") == 0) {
+        insertionSort(arr, size);
+    } else if (strcmp(algorithmName, "Merge Sort") == 0) {
+        mergeSort(arr, 0, size - 1);
+    } else if (strcmp(algorithmName, "Quick Sort") == 0) {
+        quickSort(arr, 0, size - 1);
+    } else if (strcmp(algorithmName, "Heap Sort") == 0) {
+        heapSort(arr, size);
+    }
+}
 
 // Function to run 1000 iterations and calculate min, max, avg
 Statistics runAlgorithmTest(const char* algorithmName, int size) {
     Statistics stats;
+    bench_series series;
+    if (bench_series_init(&series, algorithmName, ITERATIONS, 0) != 0) {
+        fprintf(stderr, "Could not allocate %d timing samples\n", ITERATIONS);
+        exit(EXIT_FAILURE);
+    }
     stats.min_comparisons = LLONG_MAX;
     stats.max_comparisons = 0;
     stats.min_swaps = LLONG_MAX;
@@ -95,26 +146,25 @@ Statistics runAlgorithmTest(const char* algorithmName, int size) {
     long long totalComparisons = 0;
     long long totalSwaps = 0;
     
+    // Warm-up sorts are neither timed nor counted
+    int* warmup = malloc(size * sizeof(int));
+    for (int iteration = 0; iteration < BENCH_WARMUP_RUNS; iteration++) {
+        initializeArray(warmup, size);
+        sortArray(algorithmName, warmup, size);
+    }
+    free(warmup);
+    
     // Run 1000 iterations
-    for (int iteration = 0; iteration < 1000; iteration++) {
+    for (int iteration = 0; iteration < ITERATIONS; iteration++) {
         int* arr = malloc(size * sizeof(int));
         initializeArray(arr, size);
         resetCounters();
         
         // Call appropriate sorting algorithm
-        if (strcmp(algorithmName, "Bubble Sort") == 0) {
-            bubbleSort(arr, size);
-        } else if (strcmp(algorithmName, "Selection Sort") == 0) {
-            selectionSort(arr, size);
-        } else if (strcmp(algorithmName, "Insertion Sort") == 0) {
-            insertionSort(arr, size);
-        } else if (strcmp(algorithmName, "Merge Sort") == 0) {
-            mergeSort(arr, 0, size - 1);
-        } else if (strcmp(algorithmName, "Quick Sort") == 0) {
-            quickSort(arr, 0, size - 1);
-        } else if (strcmp(algorithmName, "Heap Sort") == 0) {
-            heapSort(arr, size);
-        }
+        bench_region region;
+        bench_region_begin(&region);
+        sortArray(algorithmName, arr, size);
+        bench_region_end(&series, &region);
         
         // Update statistics
         if (comparisons < stats.min_comparisons) stats.min_comparisons = comparisons;
@@ -129,8 +179,10 @@ Statistics runAlgorithmTest(const char* algorithmName, int size) {
     }
     
     // Calculate averages
-    stats.avg_comparisons = totalComparisons / 1000;
-    stats.avg_swaps = totalSwaps / 1000;
+    stats.avg_comparisons = totalComparisons / ITERATIONS;
+    stats.avg_swaps = totalSwaps / ITERATIONS;
+    bench_summarize(&series, &stats.timing);
+    bench_series_free(&series);
     
     return stats;
 }
@@ -0,0 +1,597 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <gmp.h>
+
+#include "AES.h"
+#include "fast_prng.h"
+#include "bench_harness.h"
+#include "rabin.h"
+#include "rsa.h"
+
+// One driver for the kernels of every tool. Each kernel runs over the
+// parameter lists given on the command line, and every measured point is
+// appended to a JSON Lines file (schema in bench_harness.h) that the plot
+// scripts and regression comparisons read directly.
+//
+// Build; the tools' own mains drop out under these defines:
+//
+//   gcc -O2 -DAES_LIBRARY -DAES_NO_MAIN -DBENCH_DRIVER bench_driver.c aes_dispatch.c AES.c AES-NI.c
+//       rabin.c rsa.c allSort.c gcd_timing.c -lgmp -lm -pthread
+
+// Kernels from the standalone tools without a header of their own.
+extern long long comparisons;
+extern long long swaps;
+void sortArray(const char *algorithmName, int arr[], int size);
+void initializeArray(int arr[], int size);
+void resetCounters(void);
+
+int gcd_euclid(int num1, int num2, int *count);
+
+#define FIXTURE_SEED 123456789
+#define MAX_LIST 32
+#define MIN_SAMPLE_BYTES 65536  // short messages are timed in batches of at least this much
+#define GENERATION_ROUNDS 40
+
+typedef struct {
+    long values[MAX_LIST];
+    int count;
+} param_list;
+
+typedef struct {
+    bench_json json;
+    size_t samples;
+    param_list aes_bytes;
+    param_list aes_key_bits;
+    param_list mr_bits;
+    param_list prime_bits;
+    size_t prime_count;
+    param_list gcd_bits;
+    param_list sort_sizes;
+    param_list rsa_bits;
+} driver_config;
+
+static fast_prng fixture_prng;
+
+static const char *const primality_test_names[PRIMALITY_TEST_COUNT] = {
+    [PRIMALITY_MILLER_RABIN] = "miller-rabin",
+    [PRIMALITY_BPSW] = "bpsw",
+};
+
+static const char *const kernel_names[] = {
+    "aes-ecb", "aes-ctr", "aes-gcm", "mr-round", "mr-test", "prime-gen", "primality", "rsa", "gcd", "sort",
+};
+#define KERNEL_COUNT (sizeof(kernel_names) / sizeof(kernel_names[0]))
+
+static int parse_list(const char *text, param_list *list) {
+    char *end;
+    list->count = 0;
+    while (*text != '\0') {
+        if (list->count == MAX_LIST) return -1;
+        long value = strtol(text, &end, 10);
+        if (end == text || value <= 0) return -1;
+        list->values[list->count++] = value;
+        text = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0') return -1;
+    }
+    return list->count > 0 ? 0 : -1;
+}
+
+// Records a series and echoes the headline numbers.
+static void emit(driver_config *config, const char *tool, const char *kernel, const char *params,
+                 const bench_series *series, double units_per_sample, const char *unit, const char *metrics) {
+    bench_summary summary;
+    char counters[256];
+
+    bench_summarize(series, &summary);
+    bench_json_record(&config->json, tool, kernel, params, series, units_per_sample, unit, metrics);
+    printf("%-9s %-34s %12.3f cycles/%s [%.3f, %.3f]", kernel, params, summary.median / units_per_sample, unit,
+           summary.ci_low / units_per_sample, summary.ci_high / units_per_sample);
+    if (summary.have_counters) {
+        printf("  %s", bench_format_counters(counters, sizeof(counters), &summary, units_per_sample, unit));
+    }
+    printf("\n");
+}
+
+static size_t batch_for(long bytes) {
+    return bytes >= MIN_SAMPLE_BYTES ? 1 : (size_t)((MIN_SAMPLE_BYTES + bytes - 1) / bytes);
+}
+
+static long max_value(const param_list *list) {
+    long largest = 0;
+    for (int i = 0; i < list->count; ++i) {
+        if (list->values[i] > largest) largest = list->values[i];
+    }
+    return largest;
+}
+
+static int run_aes(driver_config *config, const char *kernel, bench_series *series) {
+    uint8_t *buffer = (uint8_t *)malloc((size_t)max_value(&config->aes_bytes));
+    uint8_t key_bytes[32], iv[AES_BLOCK_SIZE], aad[16], tag[16];
+    char params[128];
+
+    if (buffer == NULL) {
+        perror("Memory allocation failed");
+        return -1;
+    }
+    fast_prng_fill(&fixture_prng, key_bytes, sizeof(key_bytes));
+    fast_prng_fill(&fixture_prng, iv, sizeof(iv));
+    fast_prng_fill(&fixture_prng, aad, sizeof(aad));
+
+    int ecb = strcmp(kernel, "aes-ecb") == 0;
+    if (!ecb && !aes_backend_available(AES_BACKEND_AESNI)) {
+        printf("%-9s skipped: needs AES-NI\n", kernel);
+        free(buffer);
+        return 0;
+    }
+
+    for (int backend = 0; backend < AES_BACKEND_COUNT; ++backend) {
+        // CTR and GCM exist only on the AES-NI core, which picks VAES itself.
+        if (ecb ? aes_use_backend((aes_backend_id)backend) != 0 : backend != AES_BACKEND_AESNI) continue;
+
+        for (int k = 0; k < config->aes_key_bits.count; ++k) {
+            int key_bits = (int)config->aes_key_bits.values[k];
+            aes_key key;
+            aes_ctx_data context;
+            aes_gcm_key gcm_key;
+
+            if ((ecb && aes_init(&key, key_bytes, key_bits) != 0) ||
+                (!ecb && (aes_expand_key(key_bytes, key_bits, &context) != 0 ||
+                          aes_gcm_init_key_bits(&gcm_key, key_bytes, key_bits) != 0))) {
+                fprintf(stderr, "%s: unsupported key size %d\n", kernel, key_bits);
+                continue;
+            }
+
+            for (int b = 0; b < config->aes_bytes.count; ++b) {
+                long bytes = config->aes_bytes.values[b];
+                size_t batch = batch_for(bytes);
+                if (ecb && bytes % AES_BLOCK_SIZE != 0) {
+                    fprintf(stderr, "aes-ecb: %ld is not a multiple of the block size\n", bytes);
+                    continue;
+                }
+                fast_prng_fill(&fixture_prng, buffer, (size_t)bytes);
+
+                bench_series_reset(series);
+                for (size_t run = 0; run < bench_series_total(series); ++run) {
+                    bench_region region;
+                    bench_region_begin(&region);
+                    for (size_t m = 0; m < batch; ++m) {
+                        if (ecb) {
+                            aes_encrypt_blocks(&key, buffer, (size_t)bytes);
+                        } else if (strcmp(kernel, "aes-ctr") == 0) {
+                            aes_ctr_state state;
+                            aes_ctr_init(&state, &context, iv);
+                            aes_ctr_update(&state, buffer, buffer, (size_t)bytes);
+                        } else {
+                            aes_gcm_state state;
+                            aes_gcm_start(&state, &gcm_key, iv, aad, sizeof(aad));
+                            aes_gcm_encrypt_update(&state, buffer, buffer, (size_t)bytes);
+                            aes_gcm_finish(&state, tag);
+                        }
+                    }
+                    bench_region_end(series, &region);
+                }
+
+                snprintf(params, sizeof(params), "\"backend\":\"%s\",\"key_bits\":%d,\"bytes\":%ld",
+                         ecb ? aes_backend_name() : "AES-NI", key_bits, bytes);
+                emit(config, "aes", kernel, params, series, (double)batch * bytes, "byte", NULL);
+            }
+        }
+    }
+    free(buffer);
+    return 0;
+}
+
+// Composite n = p*q with two bits/2-bit primes, as in rabin.c.
+static void random_semiprime(mpz_t n, unsigned long bits) {
+    mpz_t p, q;
+    mpz_inits(p, q, NULL);
+    do {
+        mpz_urandomb(p, global_state, bits / 2);
+        mpz_setbit(p, bits / 2 - 1);
+        mpz_nextprime(p, p);
+        mpz_urandomb(q, global_state, bits - bits / 2);
+        mpz_setbit(q, bits - bits / 2 - 1);
+        mpz_nextprime(q, q);
+        mpz_mul(n, p, q);
+    } while (mpz_sizeinbase(n, 2) != bits);
+    mpz_clears(p, q, NULL);
+}
+
+// mr-round records the allocating round and the workspace round
+// (mr_ctx_round) on the same modulus, the latter once per modexp backend;
+// mr-test runs per backend too.
+static int run_miller_rabin(driver_config *config, const char *kernel, bench_series *series) {
+    static const char *const modexp_names[MR_MODEXP_COUNT] = {
+        [MR_MODEXP_GMP] = "gmp",
+        [MR_MODEXP_MONTGOMERY] = "montgomery",
+    };
+    int single_round = strcmp(kernel, "mr-round") == 0;
+    char params[128], metrics[64];
+    mpz_t n;
+
+    mpz_init(n);
+    for (int i = 0; i < config->mr_bits.count; ++i) {
+        unsigned long bits = (unsigned long)config->mr_bits.values[i];
+
+        if (single_round) {
+            random_semiprime(n, bits);
+        } else {
+            mpz_urandomb(n, global_state, bits);
+            mpz_setbit(n, bits - 1);
+            mpz_nextprime(n, n);
+        }
+
+        // The allocating round is GMP only; everything else runs per backend
+        for (int variant = !single_round; variant <= MR_MODEXP_COUNT; ++variant) {
+            mr_modexp_backend backend = variant == 0 ? MR_MODEXP_GMP : (mr_modexp_backend)(variant - 1);
+            unsigned long passed = 0;
+            mr_ctx_t ctx;
+
+            mr_use_modexp_backend(backend);
+            mr_ctx_init(&ctx, n);
+            if (ctx.mont == NULL) backend = MR_MODEXP_GMP;
+            bench_series_reset(series);
+            for (size_t run = 0; run < bench_series_total(series); ++run) {
+                bench_region region;
+                int result;
+                bench_region_begin(&region);
+                if (!single_round) result = miller_rabin_test(n, GENERATION_ROUNDS);
+                else if (variant > 0) result = mr_ctx_round(&ctx);
+                else result = miller_rabin_single_round(ctx.n, ctx.d, ctx.s, ctx.witness);
+                bench_region_end(series, &region);
+                passed += (unsigned long)result;
+            }
+            mr_ctx_clear(&ctx);
+
+            if (single_round) {
+                snprintf(params, sizeof(params), "\"bits\":%lu,\"workspace\":%s,\"modexp\":\"%s\"", bits,
+                         variant > 0 ? "true" : "false", modexp_names[backend]);
+            } else {
+                snprintf(params, sizeof(params), "\"bits\":%lu,\"rounds\":%d,\"modexp\":\"%s\"", bits,
+                         GENERATION_ROUNDS, modexp_names[backend]);
+            }
+            snprintf(metrics, sizeof(metrics), "\"passed\":%lu,\"runs\":%zu", passed, bench_series_total(series));
+            emit(config, "rabin", kernel, params, series, 1.0, single_round ? "round" : "test", metrics);
+        }
+    }
+    mr_use_modexp_backend(MR_MODEXP_MONTGOMERY);
+    mpz_clear(n);
+    return 0;
+}
+
+// Prime generation is a geometric process, so each sample is one prime and
+// the record's mean is the number to compare; attempts and candidates are
+// totals over all samples. The sieved search runs once per primality test.
+static int run_prime_generation(driver_config *config) {
+    static const struct {
+        int sieved;
+        primality_test_id test;
+    } variants[] = {
+        {0, PRIMALITY_MILLER_RABIN},
+        {1, PRIMALITY_MILLER_RABIN},
+        {1, PRIMALITY_BPSW},
+    };
+    char params[128], metrics[128];
+    bench_series series;
+    mpz_t prime;
+
+    if (bench_series_init(&series, "prime-gen", config->prime_count, 0) != 0) {
+        perror("Memory allocation failed");
+        return -1;
+    }
+    mpz_init(prime);
+    for (int i = 0; i < config->prime_bits.count; ++i) {
+        unsigned int bits = (unsigned int)config->prime_bits.values[i];
+
+        for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v) {
+            int sieved = variants[v].sieved;
+            unsigned long attempts = 0, candidates = 0;
+
+            use_primality_test(variants[v].test);
+            bench_series_reset(&series);
+            for (size_t run = 0; run < bench_series_total(&series); ++run) {
+                unsigned long examined;
+                bench_region region;
+                bench_region_begin(&region);
+                if (sieved) {
+                    attempts += sieve_prime_search(prime, bits, GENERATION_ROUNDS, &examined);
+                } else {
+                    attempts += examined = random_prime_search(prime, bits, GENERATION_ROUNDS);
+                }
+                bench_region_end(&series, &region);
+                candidates += examined;
+            }
+
+            snprintf(params, sizeof(params), "\"bits\":%u,\"method\":\"%s\",\"test\":\"%s\",\"rounds\":%d",
+                     bits, sieved ? "sieve" : "random", primality_test_names[variants[v].test],
+                     variants[v].test == PRIMALITY_BPSW ? 0 : GENERATION_ROUNDS);
+            snprintf(metrics, sizeof(metrics), "\"primes\":%zu,\"attempts\":%lu,\"candidates\":%lu",
+                     series.count, attempts, candidates);
+            emit(config, "rabin", "prime-gen", params, &series, 1.0, "prime", metrics);
+        }
+    }
+    use_primality_test(PRIMALITY_MILLER_RABIN);
+    mpz_clear(prime);
+    bench_series_free(&series);
+    return 0;
+}
+
+// The cost of accepting a prime, which every successful search pays once
+static int run_primality(driver_config *config, bench_series *series) {
+    char params[128];
+    mpz_t prime;
+
+    mpz_init(prime);
+    for (int i = 0; i < config->prime_bits.count; ++i) {
+        unsigned int bits = (unsigned int)config->prime_bits.values[i];
+
+        sieve_prime_search(prime, bits, GENERATION_ROUNDS, NULL);
+        for (int test = 0; test < PRIMALITY_TEST_COUNT; ++test) {
+            unsigned long passed = 0;
+            char metrics[64];
+
+            use_primality_test((primality_test_id)test);
+            bench_series_reset(series);
+            for (size_t run = 0; run < bench_series_total(series); ++run) {
+                bench_region region;
+                bench_region_begin(&region);
+                passed += (unsigned long)is_probable_prime(prime, GENERATION_ROUNDS);
+                bench_region_end(series, &region);
+            }
+            snprintf(params, sizeof(params), "\"bits\":%u,\"test\":\"%s\",\"rounds\":%d", bits,
+                     primality_test_names[test], test == PRIMALITY_BPSW ? 0 : GENERATION_ROUNDS);
+            snprintf(metrics, sizeof(metrics), "\"passed\":%lu,\"runs\":%zu", passed, bench_series_total(series));
+            emit(config, "rabin", "primality", params, series, 1.0, "test", metrics);
+        }
+    }
+    use_primality_test(PRIMALITY_MILLER_RABIN);
+    mpz_clear(prime);
+    return 0;
+}
+
+// Raw RSA operations on one fixed-seed key per size: private with and
+// without the CRT, and public with e = 65537. Messages are drawn outside
+// the timed region.
+static int run_rsa(driver_config *config, bench_series *series) {
+    static const char *const operations[] = {"private-crt", "private", "public"};
+    char params[96];
+    rsa_key key;
+    mpz_t message, result;
+
+    rsa_key_init(&key);
+    mpz_inits(message, result, NULL);
+    for (int i = 0; i < config->rsa_bits.count; ++i) {
+        unsigned int bits = (unsigned int)config->rsa_bits.values[i];
+
+        if (rsa_generate_key(&key, bits, FIXTURE_SEED + bits, 1) != 0) continue;
+        for (int op = 0; op < 3; ++op) {
+            bench_series_reset(series);
+            for (size_t run = 0; run < bench_series_total(series); ++run) {
+                bench_region region;
+                mpz_urandomm(message, global_state, key.n);
+                bench_region_begin(&region);
+                if (op == 0) rsa_private(&key, result, message);
+                else if (op == 1) rsa_private_no_crt(&key, result, message);
+                else rsa_public(&key, result, message);
+                bench_region_end(series, &region);
+            }
+            snprintf(params, sizeof(params), "\"bits\":%u,\"op\":\"%s\",\"e\":%d", bits, operations[op],
+                     RSA_PUBLIC_EXPONENT);
+            emit(config, "rsa", "rsa", params, series, 1.0, "op", NULL);
+        }
+    }
+    mpz_clears(message, result, NULL);
+    rsa_key_clear(&key);
+    return 0;
+}
+
+// Consecutive Fibonacci numbers are the worst case for Euclid: the largest
+// pair below 2^bits takes the most iterations of any inputs that size.
+static int run_gcd(driver_config *config, bench_series *series) {
+    char params[64], metrics[64];
+
+    for (int i = 0; i < config->gcd_bits.count; ++i) {
+        long bits = config->gcd_bits.values[i];
+        long limit = bits >= 31 ? 0x7fffffffL : (1L << bits);
+        int previous = 1, current = 1, count = 0, result = 0;
+
+        while ((long)previous + current < limit) {
+            int next = previous + current;
+            previous = current;
+            current = next;
+        }
+
+        bench_series_reset(series);
+        for (size_t run = 0; run < bench_series_total(series); ++run) {
+            int a = current, b = previous;
+            bench_region region;
+            bench_region_begin(&region);
+            BENCH_OPAQUE(a);
+            BENCH_OPAQUE(b);
+            result = gcd_euclid(a, b, &count);
+            BENCH_OPAQUE(result);
+            bench_region_end(series, &region);
+        }
+
+        snprintf(params, sizeof(params), "\"bits\":%ld,\"a\":%d,\"b\":%d", bits, current, previous);
+        snprintf(metrics, sizeof(metrics), "\"iterations\":%d,\"gcd\":%d", count, result);
+        emit(config, "gcd", "gcd", params, series, count > 0 ? (double)count : 1.0, "iteration", metrics);
+    }
+    return 0;
+}
+
+// The comparison and swap statistics use the same names as the columns of
+// allSort.c's detailed_results.csv, so the plot scripts can use either file.
+static int run_sort(driver_config *config, bench_series *series) {
+    static const char *const algorithms[] = {
+        "Bubble Sort", "Selection Sort", "Insertion Sort", "Merge Sort", "Quick Sort", "Heap Sort",
+    };
+    int *arr = (int *)malloc((size_t)max_value(&config->sort_sizes) * sizeof(int));
+    char params[96], metrics[256];
+
+    if (arr == NULL) {
+        perror("Memory allocation failed");
+        return -1;
+    }
+    for (size_t a = 0; a < sizeof(algorithms) / sizeof(algorithms[0]); ++a) {
+        for (int i = 0; i < config->sort_sizes.count; ++i) {
+            int size = (int)config->sort_sizes.values[i];
+            long long min_comparisons = -1, max_comparisons = 0, total_comparisons = 0;
+            long long min_swaps = -1, max_swaps = 0, total_swaps = 0;
+
+            bench_series_reset(series);
+            for (size_t run = 0; run < bench_series_total(series); ++run) {
+                bench_region region;
+                initializeArray(arr, size);
+                resetCounters();
+                bench_region_begin(&region);
+                sortArray(algorithms[a], arr, size);
+                bench_region_end(series, &region);
+
+                if (min_comparisons < 0 || comparisons < min_comparisons) min_comparisons = comparisons;
+                if (comparisons > max_comparisons) max_comparisons = comparisons;
+                if (min_swaps < 0 || swaps < min_swaps) min_swaps = swaps;
+                if (swaps > max_swaps) max_swaps = swaps;
+                total_comparisons += comparisons;
+                total_swaps += swaps;
+            }
+
+            long long runs = (long long)bench_series_total(series);
+            snprintf(params, sizeof(params), "\"algorithm\":\"%s\",\"size\":%d", algorithms[a], size);
+            snprintf(metrics, sizeof(metrics),
+                     "\"Min_Comparisons\":%lld,\"Max_Comparisons\":%lld,\"Avg_Comparisons\":%lld,"
+                     "\"Min_Swaps\":%lld,\"Max_Swaps\":%lld,\"Avg_Swaps\":%lld",
+                     min_comparisons, max_comparisons, total_comparisons / runs, min_swaps, max_swaps,
+                     total_swaps / runs);
+            emit(config, "sort", "sort", params, series, (double)size, "element", metrics);
+        }
+    }
+    free(arr);
+    return 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -o FILE            append results to FILE (default benchmark_results.jsonl)\n"
+            "  -b TAG             build tag stored with every record (commit, flags)\n"
+            "  -k LIST            kernels to run (default all):\n"
+            "                     aes-ecb,aes-ctr,aes-gcm,mr-round,mr-test,prime-gen,primality,rsa,gcd,sort\n"
+            "  -n SAMPLES         timed samples per point (default 200)\n"
+            "  --aes-bytes LIST   message sizes (default 64,1024,16384,1048576)\n"
+            "  --aes-key-bits LIST  (default 128,256)\n"
+            "  --mr-bits LIST     modulus sizes (default 256,512,1024,2048)\n"
+            "  --prime-bits LIST  prime sizes for prime-gen, primality (default 256,512,1024)\n"
+            "  --prime-count N    primes per size and method (default 8)\n"
+            "  --rsa-bits LIST    modulus sizes (default 1024,2048,3072,4096)\n"
+            "  --gcd-bits LIST    input sizes up to 31 (default 8,16,24,31)\n"
+            "  --sort-sizes LIST  array sizes (default 100,200,...,1000)\n"
+            "LIST is comma separated.\n",
+            program);
+}
+
+BENCH_HOST_DEFINE;
+
+int main(int argc, char **argv) {
+    static const struct option long_options[] = {
+        {"aes-bytes", required_argument, NULL, 'A'}, {"aes-key-bits", required_argument, NULL, 'K'},
+        {"mr-bits", required_argument, NULL, 'M'},   {"prime-bits", required_argument, NULL, 'P'},
+        {"prime-count", required_argument, NULL, 'C'}, {"gcd-bits", required_argument, NULL, 'G'},
+        {"sort-sizes", required_argument, NULL, 'S'}, {"rsa-bits", required_argument, NULL, 'R'},
+        {NULL, 0, NULL, 0},
+    };
+    driver_config config;
+    const char *output = "benchmark_results.jsonl", *build = NULL, *kernels = NULL;
+    int selected[KERNEL_COUNT], option, status = 0;
+
+    memset(&config, 0, sizeof(config));
+    config.samples = 200;
+    parse_list("64,1024,16384,1048576", &config.aes_bytes);
+    parse_list("128,256", &config.aes_key_bits);
+    parse_list("256,512,1024,2048", &config.mr_bits);
+    parse_list("256,512,1024", &config.prime_bits);
+    config.prime_count = 8;
+    parse_list("1024,2048,3072,4096", &config.rsa_bits);
+    parse_list("8,16,24,31", &config.gcd_bits);
+    parse_list("100,200,300,400,500,600,700,800,900,1000", &config.sort_sizes);
+
+    while ((option = getopt_long(argc, argv, "o:b:k:n:h", long_options, NULL)) != -1) {
+        int bad = 0;
+        switch (option) {
+        case 'o': output = optarg; break;
+        case 'b': build = optarg; break;
+        case 'k': kernels = optarg; break;
+        case 'n': config.samples = (size_t)strtoul(optarg, NULL, 10); bad = config.samples == 0; break;
+        case 'A': bad = parse_list(optarg, &config.aes_bytes) != 0; break;
+        case 'K': bad = parse_list(optarg, &config.aes_key_bits) != 0; break;
+        case 'M': bad = parse_list(optarg, &config.mr_bits) != 0; break;
+        case 'P': bad = parse_list(optarg, &config.prime_bits) != 0; break;
+        case 'C': config.prime_count = (size_t)strtoul(optarg, NULL, 10); bad = config.prime_count == 0; break;
+        case 'G': bad = parse_list(optarg, &config.gcd_bits) != 0 || max_value(&config.gcd_bits) > 31; break;
+        case 'S': bad = parse_list(optarg, &config.sort_sizes) != 0; break;
+        case 'R': bad = parse_list(optarg, &config.rsa_bits) != 0; break;
+        default: usage(argv[0]); return option == 'h' ? 0 : 2;
+        }
+        if (bad) {
+            fprintf(stderr, "invalid value for -%c: %s\n", option, optarg);
+            return 2;
+        }
+    }
+
+    for (size_t i = 0; i < KERNEL_COUNT; ++i) selected[i] = kernels == NULL;
+    if (kernels != NULL) {
+        char *list = strdup(kernels), *saveptr = NULL;
+        for (char *name = strtok_r(list, ",", &saveptr); name; name = strtok_r(NULL, ",", &saveptr)) {
+            size_t i = 0;
+            while (i < KERNEL_COUNT && strcmp(name, kernel_names[i]) != 0) ++i;
+            if (i == KERNEL_COUNT) {
+                fprintf(stderr, "unknown kernel: %s\n", name);
+                free(list);
+                return 2;
+            }
+            selected[i] = 1;
+        }
+        free(list);
+    }
+
+    bench_series series;
+    if (bench_series_init(&series, "driver", config.samples, BENCH_WARMUP_RUNS) != 0) {
+        perror("Memory allocation failed");
+        return 1;
+    }
+    fast_prng_seed(&fixture_prng, FIXTURE_SEED);
+    gmp_randinit_mt(global_state);
+    gmp_randseed_ui(global_state, FIXTURE_SEED);
+    srand(FIXTURE_SEED);
+
+    bench_init();
+    bench_print_environment();
+    if (bench_json_open(&config.json, output, build) != 0) {
+        perror(output);
+        bench_series_free(&series);
+        return 1;
+    }
+    printf("Appending to %s (run %s)\n", output, config.json.run_id);
+
+    for (size_t i = 0; i < KERNEL_COUNT && status == 0; ++i) {
+        if (!selected[i]) continue;
+        const char *kernel = kernel_names[i];
+        if (strncmp(kernel, "aes-", 4) == 0) status = run_aes(&config, kernel, &series);
+        else if (strncmp(kernel, "mr-", 3) == 0) status = run_miller_rabin(&config, kernel, &series);
+        else if (strcmp(kernel, "prime-gen") == 0) status = run_prime_generation(&config);
+        else if (strcmp(kernel, "primality") == 0) status = run_primality(&config, &series);
+        else if (strcmp(kernel, "rsa") == 0) status = run_rsa(&config, &series);
+        else if (strcmp(kernel, "gcd") == 0) status = run_gcd(&config, &series);
+        else status = run_sort(&config, &series);
+    }
+
+    bench_json_close(&config.json);
+    bench_series_free(&series);
+    gmp_randclear(global_state);
+    return status == 0 ? 0 : 1;
+}
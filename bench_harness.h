@@ -0,0 +1,699 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <cpuid.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <linux/perf_event.h>
+#include <x86intrin.h>
+
+// Cycle-measurement harness shared by the benchmark programs.
+//
+// Each timed region is bracketed by bench_start()/bench_stop(): lfence;
+// rdtsc; lfence at the start and rdtscp; lfence at the end, so the region
+// cannot overlap the instructions around it. bench_init() pins the thread to
+// the CPU it is running on, measures the cost of an empty region (subtracted
+// from every sample), the TSC rate and the core clock, and warns when the TSC
+// is not invariant. A bench_series drops its first warm-up samples and keeps
+// the rest, which bench_summarize() reduces to the median with a 95%
+// confidence interval, p5/p95 and a mean over the samples inside the Tukey
+// fences.
+//
+// When the kernel allows it, bench_init() also opens a perf_event group
+// (core cycles, instructions, cache misses, branch misses and uops) for the
+// calling thread. bench_region_begin()/bench_region_end() snapshot the group
+// around each sample, and the reports add IPC and events per unit of work.
+// Without perf access (no PMU, perf_event_paranoid, seccomp) or with
+// BENCH_PERF=0 in the environment, only the TSC is used.
+//
+// bench_json_* append results as JSON Lines, one object per measured series,
+// all with the same keys (see bench_json_record()).
+//
+// Header-only apart from bench_env, which the file holding main() defines
+// with BENCH_HOST_DEFINE. The including file must define _GNU_SOURCE before
+// its first system header for the affinity calls.
+
+#define BENCH_WARMUP_RUNS 3
+#define BENCH_CALIBRATION_RUNS 4096
+
+typedef enum {
+    BENCH_EVENT_CYCLES,
+    BENCH_EVENT_INSTRUCTIONS,
+    BENCH_EVENT_CACHE_MISSES,
+    BENCH_EVENT_BRANCH_MISSES,
+    BENCH_EVENT_UOPS,
+    BENCH_EVENT_COUNT
+} bench_event;
+
+static const char *const bench_event_names[BENCH_EVENT_COUNT] = {
+    "cycles", "instructions", "cache misses", "branch misses", "uops",
+};
+
+typedef struct {
+    int leader_fd;                          // -1 when counters are off
+    int fds[BENCH_EVENT_COUNT];
+    int slot[BENCH_EVENT_COUNT];            // position in the group read, -1 if not counted
+    int members;
+    const char *unavailable_reason;
+    uint64_t baseline[BENCH_EVENT_COUNT];   // counts of an empty region
+} bench_perf;
+
+typedef struct {
+    uint64_t overhead;      // median ticks of an empty fenced region
+    double tsc_ghz;         // TSC ticks per nanosecond
+    double core_ghz;        // core clock, from a dependent-add chain
+    int invariant_tsc;
+    int have_rdtscp;
+    int pinned_cpu;         // -1 if the affinity call failed
+    cpu_set_t saved_affinity;
+    int have_saved_affinity;
+    bench_perf perf;
+} bench_host;
+
+// One instance per program, shared by every file linked into it: the header
+// only declares it, and the file holding main() instantiates it with
+// BENCH_HOST_DEFINE. Counters read as off until bench_init() opens them.
+extern bench_host bench_env;
+
+#define BENCH_HOST_DEFINE \
+    bench_host bench_env = { \
+        .pinned_cpu = -1, \
+        .perf = { \
+            .leader_fd = -1, \
+            .fds = { [0 ... BENCH_EVENT_COUNT - 1] = -1 }, \
+            .slot = { [0 ... BENCH_EVENT_COUNT - 1] = -1 }, \
+            .unavailable_reason = "bench_init() not called", \
+        }, \
+    }
+
+typedef struct {
+    const char *label;
+    uint64_t *ticks;
+    size_t count;
+    size_t capacity;
+    size_t warmup_left;
+    size_t warmup_runs;
+    uint64_t counter_totals[BENCH_EVENT_COUNT];  // over the recorded samples
+} bench_series;
+
+typedef struct {
+    size_t count;
+    size_t outliers;
+    double min;
+    double p5;
+    double median;
+    double p95;
+    double ci_low;          // 95% confidence interval for the median
+    double ci_high;
+    double mean;            // over samples inside the Tukey fences
+    int have_counters;
+    double counters[BENCH_EVENT_COUNT];     // mean per sample, -1 if not counted
+} bench_summary;
+
+// A sample in progress: the TSC and counter values at bench_region_begin().
+typedef struct {
+    uint64_t ticks;
+    uint64_t counts[BENCH_EVENT_COUNT];
+} bench_region;
+
+static inline uint64_t bench_start(void) {
+    _mm_lfence();
+    uint64_t ticks = __rdtsc();
+    _mm_lfence();
+    return ticks;
+}
+
+static inline uint64_t bench_stop(void) {
+    uint64_t ticks;
+    if (bench_env.have_rdtscp) {
+        unsigned int aux;
+        ticks = __rdtscp(&aux);
+    } else {
+        _mm_lfence();
+        ticks = __rdtsc();
+    }
+    _mm_lfence();
+    return ticks;
+}
+
+// Makes the compiler treat value as unknown at this point, so pure code on it
+// cannot be hoisted out of a timed region or folded across repetitions.
+#define BENCH_OPAQUE(value) __asm__ volatile("" : "+r"(value))
+
+// SSE2 square root, so the harness does not need -lm.
+static inline double bench_sqrt(double value) {
+    return _mm_cvtsd_f64(_mm_sqrt_sd(_mm_setzero_pd(), _mm_set_sd(value)));
+}
+
+static inline double bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+static inline int bench_compare_ticks(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Linear interpolation between the closest ranks of a sorted sample.
+static inline double bench_percentile(const uint64_t *sorted, size_t count, double fraction) {
+    if (count == 0) return 0.0;
+    double rank = fraction * (double)(count - 1);
+    size_t below = (size_t)rank;
+    if (below + 1 >= count) return (double)sorted[count - 1];
+    double weight = rank - (double)below;
+    return (double)sorted[below] * (1.0 - weight) + (double)sorted[below + 1] * weight;
+}
+
+// A chain of dependent register-register adds retires one add per core
+// cycle, so its length divided by its duration is the clock the code actually
+// ran at, turbo included. The addend is a register because recent Intel cores
+// fold add-immediate chains at rename and would run them faster than 1/cycle.
+static inline void bench_add_chain(uint64_t iterations) {
+    uint64_t value = 0, addend = 1;
+    __asm__ volatile(
+        "1:\n\t"
+        ".rept 64\n\t"
+        "add %2, %0\n\t"
+        ".endr\n\t"
+        "dec %1\n\t"
+        "jnz 1b"
+        : "+r"(value), "+r"(iterations)
+        : "r"(addend));
+}
+
+static inline void bench_calibrate_clocks(void) {
+    const uint64_t chain_iterations = 1u << 18;
+    double best_core_ghz = 0.0;
+
+    double ns_start = bench_now_ns();
+    uint64_t tick_start = bench_start();
+    while (bench_now_ns() - ns_start < 20e6) continue;
+    uint64_t tick_end = bench_stop();
+    bench_env.tsc_ghz = (double)(tick_end - tick_start) / (bench_now_ns() - ns_start);
+
+    // Best of several runs: an interrupt can only make a run slower.
+    for (int attempt = 0; attempt < 5; ++attempt) {
+        tick_start = bench_start();
+        bench_add_chain(chain_iterations);
+        tick_end = bench_stop();
+        double core_ghz = (double)chain_iterations * 64.0 / (double)(tick_end - tick_start) * bench_env.tsc_ghz;
+        if (core_ghz > best_core_ghz) best_core_ghz = core_ghz;
+    }
+    bench_env.core_ghz = best_core_ghz;
+}
+
+static inline int bench_perf_open_event(uint32_t type, uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1;  // members follow the leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+// One read() returns the whole group, so all events cover the same interval.
+static inline void bench_perf_read(uint64_t *counts) {
+    const bench_perf *perf = &bench_env.perf;
+    uint64_t values[1 + BENCH_EVENT_COUNT];
+    if (read(perf->leader_fd, values, sizeof(values)) < (ssize_t)((1 + perf->members) * sizeof(uint64_t))) {
+        memset(counts, 0, BENCH_EVENT_COUNT * sizeof(uint64_t));
+        return;
+    }
+    for (int event = 0; event < BENCH_EVENT_COUNT; ++event) {
+        counts[event] = perf->slot[event] >= 0 ? values[1 + perf->slot[event]] : 0;
+    }
+}
+
+static inline void bench_perf_close(void) {
+    bench_perf *perf = &bench_env.perf;
+    for (int event = 0; event < BENCH_EVENT_COUNT; ++event) {
+        if (perf->fds[event] >= 0) close(perf->fds[event]);
+        perf->fds[event] = -1;
+        perf->slot[event] = -1;
+    }
+    perf->leader_fd = -1;
+    perf->members = 0;
+}
+
+// The uops event is model specific: UOPS_ISSUED.ANY on Intel, retired ops
+// on AMD. Other vendors go without it.
+static inline void bench_perf_init(void) {
+    bench_perf *perf = &bench_env.perf;
+    unsigned int eax, vendor[3];
+    uint64_t uops_config = 0;
+    const char *setting = getenv("BENCH_PERF");
+
+    for (int event = 0; event < BENCH_EVENT_COUNT; ++event) perf->fds[event] = perf->slot[event] = -1;
+    perf->leader_fd = -1;
+    perf->members = 0;
+    if (setting != NULL && strcmp(setting, "0") == 0) {
+        perf->unavailable_reason = "disabled by BENCH_PERF=0";
+        return;
+    }
+
+    if (__get_cpuid(0, &eax, &vendor[0], &vendor[2], &vendor[1])) {
+        if (memcmp(vendor, "GenuineIntel", 12) == 0) uops_config = 0x010e;
+        else if (memcmp(vendor, "AuthenticAMD", 12) == 0) uops_config = 0x00c1;
+    }
+
+    static const uint64_t hardware_configs[] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    for (int event = 0; event < BENCH_EVENT_COUNT; ++event) {
+        int fd;
+        if (event == BENCH_EVENT_UOPS) {
+            if (uops_config == 0) continue;
+            fd = bench_perf_open_event(PERF_TYPE_RAW, uops_config, perf->leader_fd);
+        } else {
+            fd = bench_perf_open_event(PERF_TYPE_HARDWARE, hardware_configs[event], perf->leader_fd);
+        }
+        if (fd < 0) {
+            if (event == BENCH_EVENT_CYCLES) {
+                perf->unavailable_reason = "perf_event_open refused (no PMU or not permitted)";
+                return;
+            }
+            continue;
+        }
+        if (perf->leader_fd < 0) perf->leader_fd = fd;
+        perf->fds[event] = fd;
+        perf->slot[event] = perf->members++;
+    }
+
+    ioctl(perf->leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf->leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    // A group the PMU cannot schedule reads as all zeroes.
+    uint64_t before[BENCH_EVENT_COUNT], after[BENCH_EVENT_COUNT];
+    bench_perf_read(before);
+    bench_add_chain(1024);
+    bench_perf_read(after);
+    if (after[BENCH_EVENT_CYCLES] == before[BENCH_EVENT_CYCLES]) {
+        bench_perf_close();
+        perf->unavailable_reason = "counter group could not be scheduled";
+    }
+}
+
+static inline int bench_perf_enabled(void) {
+    return bench_env.perf.leader_fd >= 0;
+}
+
+// Pins to the current CPU (or $BENCH_CPU), then calibrates. Call once before
+// any measurement; the original affinity is kept for bench_unpin().
+static inline void bench_init(void) {
+    unsigned int eax, ebx, ecx, edx;
+    const char *cpu_override = getenv("BENCH_CPU");
+    int cpu = cpu_override ? atoi(cpu_override) : sched_getcpu();
+
+    if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx)) bench_env.have_rdtscp = (edx >> 27) & 1;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) bench_env.invariant_tsc = (edx >> 8) & 1;
+
+    bench_env.pinned_cpu = -1;
+    bench_env.have_saved_affinity = sched_getaffinity(0, sizeof(cpu_set_t), &bench_env.saved_affinity) == 0;
+    if (cpu >= 0) {
+        cpu_set_t target;
+        CPU_ZERO(&target);
+        CPU_SET(cpu, &target);
+        if (sched_setaffinity(0, sizeof(target), &target) == 0) bench_env.pinned_cpu = cpu;
+    }
+
+    uint64_t *empty = (uint64_t *)malloc(BENCH_CALIBRATION_RUNS * sizeof(uint64_t));
+    if (empty != NULL) {
+        for (int i = 0; i < BENCH_CALIBRATION_RUNS; ++i) {
+            uint64_t tick_start = bench_start();
+            uint64_t tick_end = bench_stop();
+            empty[i] = tick_end - tick_start;
+        }
+        qsort(empty, BENCH_CALIBRATION_RUNS, sizeof(uint64_t), bench_compare_ticks);
+        bench_env.overhead = empty[BENCH_CALIBRATION_RUNS / 2];
+        free(empty);
+    }
+
+    bench_calibrate_clocks();
+    bench_perf_init();
+    if (bench_perf_enabled()) {
+        // Counts the read() calls themselves contribute; the per-event minimum
+        // over a batch of empty regions.
+        uint64_t before[BENCH_EVENT_COUNT], after[BENCH_EVENT_COUNT];
+        for (int event = 0; event < BENCH_EVENT_COUNT; ++event) bench_env.perf.baseline[event] = UINT64_MAX;
+        for (int i = 0; i < 256; ++i) {
+            bench_perf_read(before);
+            bench_perf_read(after);
+            for (int event = 0; event < BENCH_EVENT_COUNT; ++event) {
+                uint64_t delta = after[event] - before[event];
+                if (delta < bench_env.perf.baseline[event]) bench_env.perf.baseline[event] = delta;
+            }
+        }
+    }
+}
+
+// Restores the affinity bench_init() replaced, for benchmarks that start
+// worker threads (they would otherwise inherit the single-CPU mask).
+static inline void bench_unpin(void) {
+    if (bench_env.have_saved_affinity) sched_setaffinity(0, sizeof(cpu_set_t), &bench_env.saved_affinity);
+}
+
+static inline void bench_repin(void) {
+    if (bench_env.pinned_cpu < 0) return;
+    cpu_set_t target;
+    CPU_ZERO(&target);
+    CPU_SET(bench_env.pinned_cpu, &target);
+    sched_setaffinity(0, sizeof(target), &target);
+}
+
+static inline void bench_print_environment(void) {
+    printf("Timing: lfence/%s fenced, overhead %llu ticks subtracted, TSC %.3f GHz%s, core ~%.3f GHz, ",
+           bench_env.have_rdtscp ? "rdtscp" : "rdtsc", (unsigned long long)bench_env.overhead, bench_env.tsc_ghz,
+           bench_env.invariant_tsc ? "" : " (NOT invariant)", bench_env.core_ghz);
+    if (bench_env.pinned_cpu >= 0) printf("pinned to CPU %d\n", bench_env.pinned_cpu);
+    else printf("not pinned\n");
+    if (!bench_perf_enabled()) {
+        printf("Hardware counters: off, %s; TSC only\n", bench_env.perf.unavailable_reason);
+        return;
+    }
+    printf("Hardware counters:");
+    for (int event = 0; event < BENCH_EVENT_COUNT; ++event) {
+        if (bench_env.perf.slot[event] >= 0) printf(" %s", bench_event_names[event]);
+    }
+    printf("\n");
+}
+
+// Converts TSC ticks to core cycles at the clock measured by bench_init().
+static inline double bench_core_cycles(double ticks) {
+    return bench_env.tsc_ghz > 0.0 ? ticks * bench_env.core_ghz / bench_env.tsc_ghz : ticks;
+}
+
+static inline double bench_ticks_to_ns(double ticks) {
+    return bench_env.tsc_ghz > 0.0 ? ticks / bench_env.tsc_ghz : 0.0;
+}
+
+// Returns 0 on success and -1 if the sample buffer cannot be allocated.
+static inline int bench_series_init(bench_series *series, const char *label, size_t runs, size_t warmup_runs) {
+    series->label = label;
+    series->count = 0;
+    series->capacity = runs;
+    series->warmup_left = warmup_runs;
+    series->warmup_runs = warmup_runs;
+    memset(series->counter_totals, 0, sizeof(series->counter_totals));
+    series->ticks = (uint64_t *)malloc((runs ? runs : 1) * sizeof(uint64_t));
+    return series->ticks != NULL ? 0 : -1;
+}
+
+static inline void bench_series_free(bench_series *series) {
+    free(series->ticks);
+    series->ticks = NULL;
+    series->count = series->capacity = 0;
+}
+
+// Total iterations a loop must run to fill the series, warm-up included.
+static inline size_t bench_series_total(const bench_series *series) {
+    return series->capacity + series->warmup_runs;
+}
+
+static inline void bench_series_reset(bench_series *series) {
+    series->count = 0;
+    series->warmup_left = series->warmup_runs;
+    memset(series->counter_totals, 0, sizeof(series->counter_totals));
+}
+
+// Returns 1 if the sample was kept, 0 for a warm-up sample or a full series.
+static inline int bench_series_add(bench_series *series, uint64_t tick_start, uint64_t tick_end) {
+    if (series->warmup_left > 0) {
+        series->warmup_left--;
+        return 0;
+    }
+    if (series->count == series->capacity) return 0;
+    uint64_t elapsed = tick_end - tick_start;
+    series->ticks[series->count++] = elapsed > bench_env.overhead ? elapsed - bench_env.overhead : 0;
+    return 1;
+}
+
+// Counters are read outside the fenced TSC window, so the read() calls do not
+// show up in the tick samples.
+static inline void bench_region_begin(bench_region *region) {
+    if (bench_perf_enabled()) bench_perf_read(region->counts);
+    region->ticks = bench_start();
+}
+
+static inline void bench_region_end(bench_series *series, const bench_region *region) {
+    uint64_t tick_end = bench_stop();
+    if (!bench_perf_enabled()) {
+        bench_series_add(series, region->ticks, tick_end);
+        return;
+    }
+    uint64_t counts[BENCH_EVENT_COUNT];
+    bench_perf_read(counts);
+    if (!bench_series_add(series, region->ticks, tick_end)) return;
+    for (int event = 0; event < BENCH_EVENT_COUNT; ++event) {
+        uint64_t delta = counts[event] - region->counts[event];
+        uint64_t baseline = bench_env.perf.baseline[event];
+        series->counter_totals[event] += delta > baseline ? delta - baseline : 0;
+    }
+}
+
+// The median interval uses the distribution-free order-statistic bounds
+// n/2 -+ 1.96 sqrt(n)/2, so it holds however skewed the samples are.
+static inline void bench_summarize(const bench_series *series, bench_summary *summary) {
+    size_t count = series->count;
+    memset(summary, 0, sizeof(*summary));
+    summary->count = count;
+    if (count == 0) return;
+
+    uint64_t *sorted = (uint64_t *)malloc(count * sizeof(uint64_t));
+    if (sorted == NULL) return;
+    memcpy(sorted, series->ticks, count * sizeof(uint64_t));
+    qsort(sorted, count, sizeof(uint64_t), bench_compare_ticks);
+
+    summary->min = (double)sorted[0];
+    summary->p5 = bench_percentile(sorted, count, 0.05);
+    summary->median = bench_percentile(sorted, count, 0.50);
+    summary->p95 = bench_percentile(sorted, count, 0.95);
+
+    double spread = 1.96 * bench_sqrt((double)count) / 2.0;
+    double low_rank = (double)count / 2.0 - spread, high_rank = (double)count / 2.0 + spread;
+    summary->ci_low = (double)sorted[low_rank < 0.0 ? 0 : (size_t)low_rank];
+    summary->ci_high = (double)sorted[high_rank >= (double)(count - 1) ? count - 1 : (size_t)high_rank + 1];
+
+    double q1 = bench_percentile(sorted, count, 0.25), q3 = bench_percentile(sorted, count, 0.75);
+    double fence_low = q1 - 1.5 * (q3 - q1), fence_high = q3 + 1.5 * (q3 - q1);
+    double sum = 0.0;
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if ((double)sorted[i] < fence_low || (double)sorted[i] > fence_high) continue;
+        sum += (double)sorted[i];
+        kept++;
+    }
+    summary->outliers = count - kept;
+    summary->mean = kept ? sum / (double)kept : summary->median;
+    free(sorted);
+
+    summary->have_counters = bench_perf_enabled();
+    for (int event = 0; event < BENCH_EVENT_COUNT; ++event) {
+        summary->counters[event] = summary->have_counters && bench_env.perf.slot[event] >= 0
+                                       ? (double)series->counter_totals[event] / (double)count
+                                       : -1.0;
+    }
+}
+
+// "IPC 2.85, 0.0012 cache misses, ... per byte"; empty without counters.
+static inline const char *bench_format_counters(char *text, size_t text_len, const bench_summary *summary,
+                                                double units_per_sample, const char *unit) {
+    size_t used = 0;
+    text[0] = '\0';
+    if (!summary->have_counters || units_per_sample <= 0.0) return text;
+
+    const double *counters = summary->counters;
+    if (counters[BENCH_EVENT_CYCLES] > 0.0 && counters[BENCH_EVENT_INSTRUCTIONS] >= 0.0) {
+        used += (size_t)snprintf(text + used, text_len - used, "IPC %.2f",
+                                 counters[BENCH_EVENT_INSTRUCTIONS] / counters[BENCH_EVENT_CYCLES]);
+    }
+    int per_unit = 0;
+    for (int event = BENCH_EVENT_CACHE_MISSES; event < BENCH_EVENT_COUNT && used < text_len; ++event) {
+        if (counters[event] < 0.0) continue;
+        used += (size_t)snprintf(text + used, text_len - used, "%s%.4g %s", used ? ", " : "",
+                                 counters[event] / units_per_sample, bench_event_names[event]);
+        per_unit = 1;
+    }
+    if (per_unit && used < text_len) snprintf(text + used, text_len - used, " per %s", unit);
+    return text;
+}
+
+// Counter line for a summary; prints nothing when counters are off.
+static inline void bench_report_counters(const char *label, const bench_summary *summary, double units_per_sample,
+                                         const char *unit) {
+    char text[256];
+    if (!summary->have_counters) return;
+    printf("%s%s\n", label, bench_format_counters(text, sizeof(text), summary, units_per_sample, unit));
+}
+
+// Prints a series in ticks per sample and, when units_per_sample is non-zero,
+// per unit of work (e.g. bytes) with the matching time in nanoseconds.
+static inline void bench_report(const bench_series *series, double units_per_sample, const char *unit) {
+    bench_summary summary;
+    bench_summarize(series, &summary);
+
+    printf("[%s]\n", series->label);
+    printf("Median cycles: %.0f (95%% CI %.0f-%.0f, p5 %.0f, p95 %.0f)\n", summary.median, summary.ci_low,
+           summary.ci_high, summary.p5, summary.p95);
+    if (units_per_sample > 0.0) {
+        printf("Median cycles per %s: %.3f (%.3f ns, ~%.3f core cycles)\n", unit, summary.median / units_per_sample,
+               bench_ticks_to_ns(summary.median) / units_per_sample,
+               bench_core_cycles(summary.median) / units_per_sample);
+    }
+    printf("Samples: %zu after %zu warm-up, %zu outside Tukey fences (mean of rest %.0f)\n", summary.count,
+           series->warmup_runs, summary.outliers, summary.mean);
+    bench_report_counters("Counters: ", &summary, units_per_sample > 0.0 ? units_per_sample : 1.0,
+                          units_per_sample > 0.0 ? unit : "sample");
+}
+
+// JSON Lines results. Every record carries the host metadata, so a file
+// concatenated from several runs or machines stays self-describing:
+//
+//   schema, run_id, timestamp, build, compiler, host, cpu, logical_cpus,
+//   kernel_release, tsc_ghz, core_ghz, pinned_cpu, perf,
+//   tool, kernel, params{}, unit, units_per_sample, samples, warmup,
+//   median_cycles, ci_low, ci_high, p5, p95, mean_cycles, outliers,
+//   cycles_per_unit, ns_per_unit, ipc, counters{} (per unit, null when off),
+//   metrics{}
+#define BENCH_JSON_SCHEMA 1
+
+typedef struct {
+    FILE *file;
+    char run_id[48];
+    char timestamp[32];
+    char build[64];
+    char host[64];
+    char cpu[64];
+    char kernel_release[64];
+    long logical_cpus;
+} bench_json;
+
+// Copies text into out as the body of a JSON string.
+static inline void bench_json_escape(char *out, size_t out_len, const char *text) {
+    size_t used = 0;
+    for (; *text != '\0' && used + 7 < out_len; ++text) {
+        unsigned char c = (unsigned char)*text;
+        if (c == '"' || c == '\\') {
+            out[used++] = '\\';
+            out[used++] = (char)c;
+        } else if (c < 0x20) {
+            used += (size_t)snprintf(out + used, out_len - used, "\\u%04x", c);
+        } else {
+            out[used++] = (char)c;
+        }
+    }
+    out[used] = '\0';
+}
+
+static inline void bench_cpu_brand(char *out, size_t out_len) {
+    unsigned int words[12];
+    char brand[49];
+    const char *start = brand;
+    if (!__get_cpuid(0x80000004, &words[0], &words[1], &words[2], &words[3])) {
+        snprintf(out, out_len, "unknown");
+        return;
+    }
+    for (unsigned int leaf = 0; leaf < 3; ++leaf) {
+        __get_cpuid(0x80000002 + leaf, &words[4 * leaf], &words[4 * leaf + 1], &words[4 * leaf + 2],
+                    &words[4 * leaf + 3]);
+    }
+    memcpy(brand, words, 48);
+    brand[48] = '\0';
+    while (*start == ' ') start++;
+    bench_json_escape(out, out_len, start);
+}
+
+// Opens path for appending. build is a free-form tag (commit, flags) used to
+// tell builds apart when comparing runs; it may be NULL. Call after
+// bench_init(). Returns 0 on success and -1 if the file cannot be opened.
+static inline int bench_json_open(bench_json *json, const char *path, const char *build) {
+    struct utsname system_name;
+    time_t now = time(NULL);
+    char host[64];
+
+    memset(json, 0, sizeof(*json));
+    json->file = fopen(path, "a");
+    if (json->file == NULL) return -1;
+
+    strftime(json->timestamp, sizeof(json->timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    snprintf(json->run_id, sizeof(json->run_id), "%lld-%ld", (long long)now, (long)getpid());
+    bench_json_escape(json->build, sizeof(json->build), build ? build : "");
+    if (gethostname(host, sizeof(host)) != 0) snprintf(host, sizeof(host), "unknown");
+    host[sizeof(host) - 1] = '\0';
+    bench_json_escape(json->host, sizeof(json->host), host);
+    bench_cpu_brand(json->cpu, sizeof(json->cpu));
+    if (uname(&system_name) == 0) bench_json_escape(json->kernel_release, sizeof(json->kernel_release), system_name.release);
+    json->logical_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return 0;
+}
+
+static inline void bench_json_close(bench_json *json) {
+    if (json->file != NULL) fclose(json->file);
+    json->file = NULL;
+}
+
+// Writes one record for a series. params and metrics are JSON object bodies
+// without the braces (e.g. "\"bytes\":4096"), or NULL for none.
+static inline void bench_json_record(bench_json *json, const char *tool, const char *kernel, const char *params,
+                                     const bench_series *series, double units_per_sample, const char *unit,
+                                     const char *metrics) {
+    bench_summary summary;
+    FILE *file = json->file;
+    if (file == NULL) return;
+    bench_summarize(series, &summary);
+    if (units_per_sample <= 0.0) units_per_sample = 1.0;
+
+    fprintf(file, "{\"schema\":%d,\"run_id\":\"%s\",\"timestamp\":\"%s\",\"build\":\"%s\",\"compiler\":\"%s\",",
+            BENCH_JSON_SCHEMA, json->run_id, json->timestamp, json->build, __VERSION__);
+    fprintf(file, "\"host\":\"%s\",\"cpu\":\"%s\",\"logical_cpus\":%ld,\"kernel_release\":\"%s\",", json->host,
+            json->cpu, json->logical_cpus, json->kernel_release);
+    fprintf(file, "\"tsc_ghz\":%.4f,\"core_ghz\":%.4f,\"pinned_cpu\":%d,\"perf\":%s,", bench_env.tsc_ghz,
+            bench_env.core_ghz, bench_env.pinned_cpu, bench_perf_enabled() ? "true" : "false");
+    fprintf(file, "\"tool\":\"%s\",\"kernel\":\"%s\",\"params\":{%s},\"unit\":\"%s\",\"units_per_sample\":%.17g,",
+            tool, kernel, params ? params : "", unit, units_per_sample);
+    fprintf(file, "\"samples\":%zu,\"warmup\":%zu,\"median_cycles\":%.1f,\"ci_low\":%.1f,\"ci_high\":%.1f,",
+            summary.count, series->warmup_runs, summary.median, summary.ci_low, summary.ci_high);
+    fprintf(file, "\"p5\":%.1f,\"p95\":%.1f,\"mean_cycles\":%.1f,\"outliers\":%zu,", summary.p5, summary.p95,
+            summary.mean, summary.outliers);
+    fprintf(file, "\"cycles_per_unit\":%.6g,\"ns_per_unit\":%.6g,", summary.median / units_per_sample,
+            bench_ticks_to_ns(summary.median) / units_per_sample);
+
+    const double *counters = summary.counters;
+    if (summary.have_counters && counters[BENCH_EVENT_CYCLES] > 0.0 && counters[BENCH_EVENT_INSTRUCTIONS] >= 0.0) {
+        fprintf(file, "\"ipc\":%.4f,", counters[BENCH_EVENT_INSTRUCTIONS] / counters[BENCH_EVENT_CYCLES]);
+    } else {
+        fprintf(file, "\"ipc\":null,");
+    }
+    if (summary.have_counters) {
+        static const char *const keys[BENCH_EVENT_COUNT] = {
+            "cycles", "instructions", "cache_misses", "branch_misses", "uops",
+        };
+        fprintf(file, "\"counters\":{");
+        for (int event = 0; event < BENCH_EVENT_COUNT; ++event) {
+            if (counters[event] < 0.0) fprintf(file, "%s\"%s\":null", event ? "," : "", keys[event]);
+            else fprintf(file, "%s\"%s\":%.6g", event ? "," : "", keys[event], counters[event] / units_per_sample);
+        }
+        fprintf(file, "},");
+    } else {
+        fprintf(file, "\"counters\":null,");
+    }
+    fprintf(file, "\"metrics\":{%s}}\n", metrics ? metrics : "");
+    fflush(file);
+}
+
+#endif
@@ -0,0 +1,50 @@
+import json
+import os
+
+import pandas as pd
+
+RESULTS_JSONL = 'benchmark_results.jsonl'
+LEGACY_CSV = 'detailed_results.csv'
+
+
+def load_results(path=RESULTS_JSONL, kernel=None, run_id=None):
+    """
+    Load the JSON Lines file written by bench_driver into a flat DataFrame.
+    params.* and metrics.* become columns; counters.* too when perf was on.
+    """
+    with open(path) as f:
+        records = [json.loads(line) for line in f if line.strip()]
+    df = pd.json_normalize(records)
+    if kernel is not None:
+        df = df[df['kernel'] == kernel]
+    if run_id is not None:
+        df = df[df['run_id'] == run_id]
+    return df
+
+
+def load_sort_results():
+    """
+    Sorting results in the detailed_results.csv layout. Uses the latest sort
+    run in the driver's JSONL when it has one, otherwise the CSV from allSort,
+    so a stale CSV never hides newer driver results. Returns None when
+    neither source has sort data.
+    """
+    df = None
+    if os.path.exists(RESULTS_JSONL):
+        df = load_results(RESULTS_JSONL, kernel='sort')
+    if df is None or df.empty:
+        return pd.read_csv(LEGACY_CSV) if os.path.exists(LEGACY_CSV) else None
+
+    df = df[df['run_id'] == df['run_id'].iloc[-1]]
+    legacy = pd.DataFrame({
+        'Algorithm': df['params.algorithm'],
+        'Size': df['params.size'],
+    })
+    for column in ['Min_Comparisons', 'Max_Comparisons', 'Avg_Comparisons',
+                   'Min_Swaps', 'Max_Swaps', 'Avg_Swaps']:
+        legacy[column] = df['metrics.' + column]
+    legacy['Median_Cycles'] = df['median_cycles']
+    legacy['Cycles_CI_Low'] = df['ci_low']
+    legacy['Cycles_CI_High'] = df['ci_high']
+    legacy['IPC'] = df['ipc']
+    return legacy.reset_index(drop=True)
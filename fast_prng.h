@@ -0,0 +1,92 @@
+#ifndef FAST_PRNG_H
+#define FAST_PRNG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <emmintrin.h>
+
+// Benchmark fixture generator: four independent xoshiro256** streams run in
+// SSE2 64-bit lanes, so each step yields 32 bytes. xoshiro256** needs only
+// shifts, xors and multiplies by 5 and 9, which are a shift plus an add, so
+// no 64-bit vector multiply is required. Not for cryptographic keys outside
+// the benchmarks: the output is fully determined by the seed.
+//
+// Header-only; include it from any benchmark that needs fixture data.
+
+#define FAST_PRNG_STEP_BYTES 32
+
+typedef struct {
+    __m128i state[4][2];  // state word i for lanes 0-1 ([i][0]) and 2-3 ([i][1])
+} fast_prng;
+
+static inline uint64_t fast_prng_splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Expands one 64-bit seed into all sixteen state words with splitmix64, as
+// the xoshiro authors recommend.
+static inline void fast_prng_seed(fast_prng *prng, uint64_t seed) {
+    uint64_t words[4][4];
+    for (int lane = 0; lane < 4; ++lane) {
+        for (int i = 0; i < 4; ++i) words[i][lane] = fast_prng_splitmix64(&seed);
+    }
+    for (int i = 0; i < 4; ++i) {
+        prng->state[i][0] = _mm_set_epi64x((long long)words[i][1], (long long)words[i][0]);
+        prng->state[i][1] = _mm_set_epi64x((long long)words[i][3], (long long)words[i][2]);
+    }
+}
+
+#define FAST_PRNG_ROTL(x, k) _mm_or_si128(_mm_slli_epi64(x, k), _mm_srli_epi64(x, 64 - (k)))
+
+static inline __m128i fast_prng_step_pair(__m128i *s0, __m128i *s1, __m128i *s2, __m128i *s3) {
+    __m128i times5 = _mm_add_epi64(_mm_slli_epi64(*s1, 2), *s1);
+    __m128i rotated = FAST_PRNG_ROTL(times5, 7);
+    __m128i result = _mm_add_epi64(_mm_slli_epi64(rotated, 3), rotated);
+    __m128i t = _mm_slli_epi64(*s1, 17);
+
+    *s2 = _mm_xor_si128(*s2, *s0);
+    *s3 = _mm_xor_si128(*s3, *s1);
+    *s1 = _mm_xor_si128(*s1, *s2);
+    *s0 = _mm_xor_si128(*s0, *s3);
+    *s2 = _mm_xor_si128(*s2, t);
+    *s3 = FAST_PRNG_ROTL(*s3, 45);
+    return result;
+}
+
+// Produces FAST_PRNG_STEP_BYTES bytes: one 64-bit output from each lane.
+static inline void fast_prng_step(fast_prng *prng, __m128i *low, __m128i *high) {
+    *low = fast_prng_step_pair(&prng->state[0][0], &prng->state[1][0], &prng->state[2][0], &prng->state[3][0]);
+    *high = fast_prng_step_pair(&prng->state[0][1], &prng->state[1][1], &prng->state[2][1], &prng->state[3][1]);
+}
+
+static inline void fast_prng_fill(fast_prng *prng, uint8_t *dest, size_t length) {
+    __m128i low, high;
+    while (length >= FAST_PRNG_STEP_BYTES) {
+        fast_prng_step(prng, &low, &high);
+        _mm_storeu_si128((__m128i *)dest, low);
+        _mm_storeu_si128((__m128i *)(dest + 16), high);
+        dest += FAST_PRNG_STEP_BYTES;
+        length -= FAST_PRNG_STEP_BYTES;
+    }
+    if (length > 0) {
+        uint8_t tail[FAST_PRNG_STEP_BYTES];
+        fast_prng_step(prng, &low, &high);
+        _mm_storeu_si128((__m128i *)tail, low);
+        _mm_storeu_si128((__m128i *)(tail + 16), high);
+        memcpy(dest, tail, length);
+    }
+}
+
+static inline uint64_t fast_prng_next64(fast_prng *prng) {
+    uint64_t value;
+    fast_prng_fill(prng, (uint8_t *)&value, sizeof(value));
+    return value;
+}
+
+#undef FAST_PRNG_ROTL
+
+#endif
@@ -1,49 +1,70 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdint.h>
 
+#include "bench_harness.h"
 
+#define GCD_RUNS 1000  // timed repetitions of the same inputs
 
-// Function to read the Time-Stamp Counter
-static __inline__ uint64_t rdtsc(void) {
-	uint32_t lo, hi;
-	// The "memory" clobber ensures that the RDTSC instruction is not reordered
-	// with respect to other memory operations.
-	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi) : : "memory");
-	return ((uint64_t)hi << 32) | lo;
+// Euclidean algorithm; *count receives the number of loop iterations.
+int gcd_euclid(int num1, int num2, int *count) {
+    int remainder;
+    *count = 0;
+    // The loop continues as long as num2 is not zero
+    while (num2 != 0) {
+	(*count)++;
+        remainder = num1 % num2; // Calculate the remainder
+        num1 = num2;             // Update num1 to the previous num2
+        num2 = remainder;        // Update num2 to the remainder
+    }
+    return num1;
 }
 
+#ifndef BENCH_DRIVER
+BENCH_HOST_DEFINE;
+
 int main() {
     int count=0;
-    int num1, num2, remainder, temp;
-    uint64_t start_cycles, end_cycles, start_loop, end_loop;
+    int num1, num2, result = 0;
+    bench_series series;
 
 // Prompt the user to enter two numbers
     printf("Enter two positive integers: ");
-    scanf("%d %d", &num1, &num2);
+    if (scanf("%d %d", &num1, &num2) != 2) {
+        fprintf(stderr, "Expected two integers\n");
+        return 1;
+    }
 
     // Ensure both numbers are positive for the algorithm
     if (num1 < 0) num1 = -num1;
     if (num2 < 0) num2 = -num2;
 
-    // Implement the Euclidean algorithm
-    // The loop continues as long as num2 is not zero
-    start_cycles = rdtsc();
-    while (num2 != 0) {
-	//start_loop = rdtsc();
-	count++;
-        remainder = num1 % num2; // Calculate the remainder
-        num1 = num2;             // Update num1 to the previous num2
-        num2 = remainder;        // Update num2 to the remainder
-	//end_loop = rdtsc();
-//	printf("CPU cycles for %d th loop: %lu\n",count,end_loop - start_loop);
+    if (bench_series_init(&series, "Euclid while loop", GCD_RUNS, BENCH_WARMUP_RUNS) != 0) {
+        perror("Memory allocation failed");
+        return 1;
     }
-    end_cycles = rdtsc();
+    bench_init();
 
+    // Time the same inputs repeatedly; a single run is a few dozen cycles,
+    // well inside the noise of one measurement.
+    for (size_t run = 0; run < bench_series_total(&series); run++) {
+        int a = num1, b = num2;
+        bench_region region;
+        bench_region_begin(&region);
+        BENCH_OPAQUE(a);
+        BENCH_OPAQUE(b);
+        result = gcd_euclid(a, b, &count);
+        BENCH_OPAQUE(result);
+        bench_region_end(&series, &region);
+    }
 
     // When the loop terminates, num1 holds the GCD
-    printf("GCD of the given numbers is %d\n", num1);
-    printf("Total CPU cycles for the while loop: %lu\n", end_cycles - start_cycles);
-    //printf("No. of times while loop ran: %d\n", count);
+    printf("GCD of the given numbers is %d\n", result);
+    printf("No. of times while loop ran: %d\n", count);
+    bench_print_environment();
+    bench_report(&series, count > 0 ? (double)count : 0.0, "loop iteration");
 
+    bench_series_free(&series);
     return 0;
 }
+#endif
@@ -0,0 +1,622 @@
+#ifndef MONTGOMERY_H
+#define MONTGOMERY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <gmp.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+// Montgomery modular exponentiation for odd moduli of up to 2048 bits, with
+// the multiply and square specialized for 4, 8, 16 and 32 64-bit limbs.
+// Each specialization sees its limb count as a compile-time constant, so the
+// inner limb loops are fully unrolled and the operands stay in fixed-size
+// stack arrays; a modulus is padded to the next specialized size. The
+// exponent is scanned with a sliding window over precomputed odd powers.
+//
+// There are two kernels per size. On x86-64 CPUs with BMI2 and ADX each limb
+// row is one unrolled run of mulx with two independent carry chains (adcx
+// for the low halves, adox for the high halves), and squaring computes each
+// cross product once. Elsewhere a portable unsigned __int128 version is used.
+// The outer loop over rows stays a loop: fully unrolling it too was no
+// faster at 4 limbs and, at 32 limbs, overflowed the instruction cache.
+//
+// mont_ctx_init() does the per-modulus work (-n^-1 mod 2^64, R mod n and
+// R^2 mod n) once; after that mont_powm() does no allocation. Values passed
+// to mont_mul/mont_sqr/mont_powm are in Montgomery form (a*R mod n) and
+// exactly ctx->limbs limbs long.
+//
+// The multiply and square end in a branch-free conditional subtraction, but
+// the sliding window of mont_powm() follows the bits of the exponent, so its
+// timing depends on them. Secret exponents go through mont_powm_fixed()
+// instead: a fixed window over an exponent recoded once, for a given bit
+// length, into a mont_fixed_exp.
+//
+// Header-only; needs a 64-bit mp_limb_t (the default on x86-64).
+
+#define MONT_MAX_LIMBS 32
+#define MONT_MAX_WINDOW 6
+#define MONT_FIXED_WINDOW 5
+#define MONT_FIXED_MAX_DIGITS ((MONT_MAX_LIMBS * 64 + MONT_FIXED_WINDOW - 1) / MONT_FIXED_WINDOW)
+
+_Static_assert(GMP_NUMB_BITS == 64, "montgomery.h needs 64-bit limbs without nails");
+
+typedef unsigned __int128 mont_wide;
+
+typedef struct mont_ctx mont_ctx;
+typedef void (*mont_mul_fn)(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b);
+typedef void (*mont_sqr_fn)(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *a);
+typedef void (*mont_powm_fn)(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *base, const mp_limb_t *exp,
+                             size_t exp_bits);
+
+struct mont_ctx {
+    int limbs;                       // 4, 8, 16 or 32
+    mp_limb_t n[MONT_MAX_LIMBS];     // modulus, zero-padded to `limbs`
+    mp_limb_t n0inv;                 // -n^-1 mod 2^64
+    mp_limb_t one[MONT_MAX_LIMBS];   // R mod n: 1 in Montgomery form
+    mp_limb_t r2[MONT_MAX_LIMBS];    // R^2 mod n, for conversion into Montgomery form
+    mont_mul_fn mul;                 // specializations for `limbs`
+    mont_sqr_fn sqr;
+    mont_powm_fn powm;
+    const char *kernel;              // "mulx/adx" or "portable"
+};
+
+// r = a*b/R mod n by coarsely integrated operand scanning (CIOS): one
+// multiply row and one reduction row per limb of b, over N+2 limbs of
+// accumulator, then one conditional subtraction.
+static inline __attribute__((always_inline)) void mont_mul_limbs(const mont_ctx *ctx, mp_limb_t *r,
+                                                                 const mp_limb_t *a, const mp_limb_t *b,
+                                                                 const int N) {
+    mp_limb_t t[MONT_MAX_LIMBS + 2];
+    const mp_limb_t *n = ctx->n;
+
+    memset(t, 0, (size_t)(N + 2) * sizeof(mp_limb_t));
+    for (int i = 0; i < N; ++i) {
+        mont_wide c = 0;
+#pragma GCC unroll 32
+        for (int j = 0; j < N; ++j) {
+            c = (mont_wide)a[j] * b[i] + t[j] + (mp_limb_t)(c >> 64);
+            t[j] = (mp_limb_t)c;
+        }
+        c = (mont_wide)t[N] + (mp_limb_t)(c >> 64);
+        t[N] = (mp_limb_t)c;
+        t[N + 1] = (mp_limb_t)(c >> 64);
+
+        mp_limb_t m = t[0] * ctx->n0inv;
+        c = (mont_wide)m * n[0] + t[0];
+#pragma GCC unroll 32
+        for (int j = 1; j < N; ++j) {
+            c = (mont_wide)m * n[j] + t[j] + (mp_limb_t)(c >> 64);
+            t[j - 1] = (mp_limb_t)c;
+        }
+        c = (mont_wide)t[N] + (mp_limb_t)(c >> 64);
+        t[N - 1] = (mp_limb_t)c;
+        t[N] = t[N + 1] + (mp_limb_t)(c >> 64);
+    }
+
+    // t < 2n; subtract n once if t >= n, selecting with a mask, not a branch
+    mp_limb_t diff[MONT_MAX_LIMBS], borrow = 0;
+#pragma GCC unroll 32
+    for (int j = 0; j < N; ++j) {
+        mont_wide d = (mont_wide)t[j] - n[j] - borrow;
+        diff[j] = (mp_limb_t)d;
+        borrow = (mp_limb_t)(d >> 64) & 1;
+    }
+    mp_limb_t use_diff = (mp_limb_t)0 - (mp_limb_t)((t[N] != 0) | (borrow == 0));
+#pragma GCC unroll 32
+    for (int j = 0; j < N; ++j) r[j] = (diff[j] & use_diff) | (t[j] & ~use_diff);
+}
+
+// r = a^2/R mod n. The cross products a[i]*a[j], i < j, are computed once
+// and doubled, then the 2N-limb square is reduced one limb at a time.
+static inline __attribute__((always_inline)) void mont_sqr_limbs(const mont_ctx *ctx, mp_limb_t *r,
+                                                                 const mp_limb_t *a, const int N) {
+    mp_limb_t t[2 * MONT_MAX_LIMBS + 1];
+    const mp_limb_t *n = ctx->n;
+
+    memset(t, 0, (size_t)(2 * N + 1) * sizeof(mp_limb_t));
+    for (int i = 0; i < N - 1; ++i) {
+        mont_wide c = 0;
+#pragma GCC unroll 32
+        for (int j = i + 1; j < N; ++j) {
+            c = (mont_wide)a[i] * a[j] + t[i + j] + (mp_limb_t)(c >> 64);
+            t[i + j] = (mp_limb_t)c;
+        }
+        t[i + N] = (mp_limb_t)(c >> 64);
+    }
+
+    // Double the cross products and add the diagonal a[i]^2
+    mp_limb_t carry = 0;
+#pragma GCC unroll 64
+    for (int j = 0; j < 2 * N; ++j) {
+        mp_limb_t top = t[j] >> 63;
+        t[j] = (t[j] << 1) | carry;
+        carry = top;
+    }
+    mont_wide c = 0;
+#pragma GCC unroll 32
+    for (int i = 0; i < N; ++i) {
+        mont_wide square = (mont_wide)a[i] * a[i];
+        c = (mont_wide)t[2 * i] + (mp_limb_t)square + (mp_limb_t)(c >> 64);
+        t[2 * i] = (mp_limb_t)c;
+        c = (mont_wide)t[2 * i + 1] + (mp_limb_t)(square >> 64) + (mp_limb_t)(c >> 64);
+        t[2 * i + 1] = (mp_limb_t)c;
+    }
+
+    // Reduce: each step clears the lowest remaining limb
+    mp_limb_t high_carry = 0;
+    for (int i = 0; i < N; ++i) {
+        mp_limb_t m = t[i] * ctx->n0inv;
+        c = 0;
+#pragma GCC unroll 32
+        for (int j = 0; j < N; ++j) {
+            c = (mont_wide)m * n[j] + t[i + j] + (mp_limb_t)(c >> 64);
+            t[i + j] = (mp_limb_t)c;
+        }
+        c = (mont_wide)t[i + N] + (mp_limb_t)(c >> 64) + high_carry;
+        t[i + N] = (mp_limb_t)c;
+        high_carry = (mp_limb_t)(c >> 64);
+    }
+
+    mp_limb_t diff[MONT_MAX_LIMBS], borrow = 0;
+#pragma GCC unroll 32
+    for (int j = 0; j < N; ++j) {
+        mont_wide d = (mont_wide)t[N + j] - n[j] - borrow;
+        diff[j] = (mp_limb_t)d;
+        borrow = (mp_limb_t)(d >> 64) & 1;
+    }
+    mp_limb_t use_diff = (mp_limb_t)0 - (mp_limb_t)((high_carry != 0) | (borrow == 0));
+#pragma GCC unroll 32
+    for (int j = 0; j < N; ++j) r[j] = (diff[j] & use_diff) | (t[N + j] & ~use_diff);
+}
+
+static inline int mont_window_bits(size_t exp_bits) {
+    if (exp_bits > 671) return 6;
+    if (exp_bits > 239) return 5;
+    if (exp_bits > 79) return 4;
+    if (exp_bits > 23) return 3;
+    return 1;
+}
+
+static inline int mont_exp_bit(const mp_limb_t *exp, size_t bit) {
+    return (int)((exp[bit / 64] >> (bit % 64)) & 1);
+}
+
+// r = base^exp (Montgomery form in and out), left-to-right sliding window.
+// exp_bits is the bit length of exp; exp_bits == 0 gives 1.
+static inline __attribute__((always_inline)) void mont_powm_limbs(const mont_ctx *ctx, mp_limb_t *r,
+                                                                  const mp_limb_t *base, const mp_limb_t *exp,
+                                                                  size_t exp_bits, const int N, mont_mul_fn mul,
+                                                                  mont_sqr_fn sqr) {
+    mp_limb_t table[1 << (MONT_MAX_WINDOW - 1)][MONT_MAX_LIMBS];  // base^1, base^3, base^5, ...
+    mp_limb_t acc[MONT_MAX_LIMBS], base_sq[MONT_MAX_LIMBS];
+    int window = mont_window_bits(exp_bits);
+
+    if (exp_bits == 0) {
+        memcpy(r, ctx->one, (size_t)N * sizeof(mp_limb_t));
+        return;
+    }
+    memcpy(table[0], base, (size_t)N * sizeof(mp_limb_t));
+    if (window > 1) {
+        sqr(ctx, base_sq, base);
+        for (int i = 1; i < (1 << (window - 1)); ++i) mul(ctx, table[i], table[i - 1], base_sq);
+    }
+
+    int have_acc = 0;
+    size_t bit = exp_bits;
+    while (bit > 0) {
+        if (!mont_exp_bit(exp, bit - 1)) {
+            sqr(ctx, acc, acc);
+            --bit;
+            continue;
+        }
+        // Longest window of at most `window` bits ending in a set bit
+        size_t low = bit > (size_t)window ? bit - (size_t)window : 0;
+        while (!mont_exp_bit(exp, low)) ++low;
+        unsigned int value = 0;
+        for (size_t b = bit; b > low; --b) value = (value << 1) | (unsigned int)mont_exp_bit(exp, b - 1);
+
+        if (have_acc) {
+            for (size_t b = low; b < bit; ++b) sqr(ctx, acc, acc);
+            mul(ctx, acc, acc, table[value >> 1]);
+        } else {
+            memcpy(acc, table[value >> 1], (size_t)N * sizeof(mp_limb_t));
+            have_acc = 1;
+        }
+        bit = low;
+    }
+    memcpy(r, acc, (size_t)N * sizeof(mp_limb_t));
+}
+
+#define MONT_DEFINE_SIZE(N)                                                                                 \
+    static void mont_mul_##N(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b) {   \
+        mont_mul_limbs(ctx, r, a, b, N);                                                                    \
+    }                                                                                                       \
+    static void mont_sqr_##N(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *a) {                       \
+        mont_sqr_limbs(ctx, r, a, N);                                                                       \
+    }                                                                                                       \
+    static void mont_powm_##N(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *base, const mp_limb_t *exp, \
+                              size_t exp_bits) {                                                            \
+        mont_powm_limbs(ctx, r, base, exp, exp_bits, N, mont_mul_##N, mont_sqr_##N);                        \
+    }
+
+MONT_DEFINE_SIZE(4)
+MONT_DEFINE_SIZE(8)
+MONT_DEFINE_SIZE(16)
+MONT_DEFINE_SIZE(32)
+
+#undef MONT_DEFINE_SIZE
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define MONT_HAVE_ADX 1
+
+// The kernels below are GNU assembler loops unrolled with .rept; mont_i and
+// mont_j are assembler symbols that hold the row and limb index. zero, carry,
+// lo, hi and tmp are scratch registers; rdx holds the mulx multiplier.
+
+// t[0..N+1] += a * rdx, with t[N+1] written fresh
+#define MONT_ASM_ROW_MUL(N)                                  \
+    "xor %k[zero], %k[zero]\n\t"                              \
+    "xor %k[carry], %k[carry]\n\t"                            \
+    ".set mont_j, 0\n\t"                                      \
+    ".rept " #N "\n\t"                                        \
+    "mulx 8*mont_j(%[a]), %[lo], %[hi]\n\t"                   \
+    "mov 8*mont_j(%[t]), %[tmp]\n\t"                          \
+    "adcx %[lo], %[tmp]\n\t"                                  \
+    "adox %[carry], %[tmp]\n\t"                               \
+    "mov %[tmp], 8*mont_j(%[t])\n\t"                          \
+    "mov %[hi], %[carry]\n\t"                                 \
+    ".set mont_j, mont_j+1\n\t"                               \
+    ".endr\n\t"                                               \
+    "mov 8*" #N "(%[t]), %[tmp]\n\t"                          \
+    "adcx %[zero], %[tmp]\n\t"                                \
+    "adox %[carry], %[tmp]\n\t"                               \
+    "mov %[tmp], 8*" #N "(%[t])\n\t"                          \
+    "mov $0, %k[tmp]\n\t"                                     \
+    "adcx %[zero], %[tmp]\n\t"                                \
+    "adox %[zero], %[tmp]\n\t"                                \
+    "mov %[tmp], 8*(" #N "+1)(%[t])\n\t"
+
+// t = (t + rdx*n) / 2^64 over N+2 limbs, rdx = t[0] * -n^-1
+#define MONT_ASM_ROW_SHIFT_REDC(N)                           \
+    "xor %k[zero], %k[zero]\n\t"                              \
+    "mulx (%[n]), %[lo], %[carry]\n\t"                        \
+    "mov (%[t]), %[tmp]\n\t"                                  \
+    "adcx %[lo], %[tmp]\n\t"                                  \
+    ".set mont_j, 1\n\t"                                      \
+    ".rept " #N "-1\n\t"                                      \
+    "mulx 8*mont_j(%[n]), %[lo], %[hi]\n\t"                   \
+    "mov 8*mont_j(%[t]), %[tmp]\n\t"                          \
+    "adcx %[lo], %[tmp]\n\t"                                  \
+    "adox %[carry], %[tmp]\n\t"                               \
+    "mov %[tmp], 8*(mont_j-1)(%[t])\n\t"                      \
+    "mov %[hi], %[carry]\n\t"                                 \
+    ".set mont_j, mont_j+1\n\t"                               \
+    ".endr\n\t"                                               \
+    "mov 8*" #N "(%[t]), %[tmp]\n\t"                          \
+    "adcx %[zero], %[tmp]\n\t"                                \
+    "adox %[carry], %[tmp]\n\t"                               \
+    "mov %[tmp], 8*(" #N "-1)(%[t])\n\t"                      \
+    "mov 8*(" #N "+1)(%[t]), %[tmp]\n\t"                      \
+    "adcx %[zero], %[tmp]\n\t"                                \
+    "adox %[zero], %[tmp]\n\t"                                \
+    "mov %[tmp], 8*" #N "(%[t])\n\t"
+
+// t[1..2N-1] = sum of a[i]*a[j] for i < j; t must be zero on entry
+#define MONT_ASM_SQR_CROSS(N)                                \
+    ".set mont_i, 0\n\t"                                      \
+    ".rept " #N "-1\n\t"                                      \
+    "mov 8*mont_i(%[a]), %%rdx\n\t"                           \
+    "xor %k[zero], %k[zero]\n\t"                              \
+    "xor %k[carry], %k[carry]\n\t"                            \
+    ".set mont_j, mont_i+1\n\t"                               \
+    ".rept " #N "-1-mont_i\n\t"                               \
+    "mulx 8*mont_j(%[a]), %[lo], %[hi]\n\t"                   \
+    "mov 8*(mont_i+mont_j)(%[t]), %[tmp]\n\t"                 \
+    "adcx %[lo], %[tmp]\n\t"                                  \
+    "adox %[carry], %[tmp]\n\t"                               \
+    "mov %[tmp], 8*(mont_i+mont_j)(%[t])\n\t"                 \
+    "mov %[hi], %[carry]\n\t"                                 \
+    ".set mont_j, mont_j+1\n\t"                               \
+    ".endr\n\t"                                               \
+    "mov $0, %k[tmp]\n\t"                                     \
+    "adcx %[zero], %[tmp]\n\t"                                \
+    "adox %[carry], %[tmp]\n\t"                               \
+    "mov %[tmp], 8*(mont_i+" #N ")(%[t])\n\t"                 \
+    ".set mont_i, mont_i+1\n\t"                               \
+    ".endr\n\t"
+
+// t = 2t + sum of a[i]^2: doubling on the CF chain, squares on the OF chain
+#define MONT_ASM_SQR_DIAG(N)                                 \
+    "xor %k[zero], %k[zero]\n\t"                              \
+    ".set mont_i, 0\n\t"                                      \
+    ".rept " #N "\n\t"                                        \
+    "mov 8*mont_i(%[a]), %%rdx\n\t"                           \
+    "mulx %%rdx, %[lo], %[hi]\n\t"                            \
+    "mov 16*mont_i(%[t]), %[tmp]\n\t"                         \
+    "adcx %[tmp], %[tmp]\n\t"                                 \
+    "adox %[lo], %[tmp]\n\t"                                  \
+    "mov %[tmp], 16*mont_i(%[t])\n\t"                         \
+    "mov 16*mont_i+8(%[t]), %[tmp]\n\t"                       \
+    "adcx %[tmp], %[tmp]\n\t"                                 \
+    "adox %[hi], %[tmp]\n\t"                                  \
+    "mov %[tmp], 16*mont_i+8(%[t])\n\t"                       \
+    ".set mont_i, mont_i+1\n\t"                               \
+    ".endr\n\t"
+
+// t[0..N] += rdx*n in place, plus the previous row's carry-out (top) at
+// t[N]; leaves this row's carry-out in top
+#define MONT_ASM_ROW_REDC(N)                                 \
+    "xor %k[zero], %k[zero]\n\t"                              \
+    "mulx (%[n]), %[lo], %[carry]\n\t"                        \
+    "mov (%[t]), %[tmp]\n\t"                                  \
+    "adcx %[lo], %[tmp]\n\t"                                  \
+    ".set mont_j, 1\n\t"                                      \
+    ".rept " #N "-1\n\t"                                      \
+    "mulx 8*mont_j(%[n]), %[lo], %[hi]\n\t"                   \
+    "mov 8*mont_j(%[t]), %[tmp]\n\t"                          \
+    "adcx %[lo], %[tmp]\n\t"                                  \
+    "adox %[carry], %[tmp]\n\t"                               \
+    "mov %[tmp], 8*mont_j(%[t])\n\t"                          \
+    "mov %[hi], %[carry]\n\t"                                 \
+    ".set mont_j, mont_j+1\n\t"                               \
+    ".endr\n\t"                                               \
+    "mov 8*" #N "(%[t]), %[tmp]\n\t"                          \
+    "adcx %[top], %[tmp]\n\t"                                 \
+    "adox %[carry], %[tmp]\n\t"                               \
+    "mov %[tmp], 8*" #N "(%[t])\n\t"                          \
+    "mov $0, %k[top]\n\t"                                     \
+    "adcx %[zero], %[top]\n\t"                                \
+    "adox %[zero], %[top]\n\t"
+
+// r = t - n if the N+1 limb value t is >= n, else r = t
+#define MONT_ASM_FINAL_SUB(N)                                \
+    "mov (%[t]), %[tmp]\n\t"                                  \
+    "sub (%[n]), %[tmp]\n\t"                                  \
+    "mov %[tmp], (%[r])\n\t"                                  \
+    ".set mont_j, 1\n\t"                                      \
+    ".rept " #N "-1\n\t"                                      \
+    "mov 8*mont_j(%[t]), %[tmp]\n\t"                          \
+    "sbb 8*mont_j(%[n]), %[tmp]\n\t"                          \
+    "mov %[tmp], 8*mont_j(%[r])\n\t"                          \
+    ".set mont_j, mont_j+1\n\t"                               \
+    ".endr\n\t"                                               \
+    "mov 8*" #N "(%[t]), %[tmp]\n\t"                          \
+    "sbb $0, %[tmp]\n\t"                                      \
+    ".set mont_j, 0\n\t"                                      \
+    ".rept " #N "\n\t"                                        \
+    "mov 8*mont_j(%[r]), %[tmp]\n\t"                          \
+    "cmovc 8*mont_j(%[t]), %[tmp]\n\t"                        \
+    "mov %[tmp], 8*mont_j(%[r])\n\t"                          \
+    ".set mont_j, mont_j+1\n\t"                               \
+    ".endr\n\t"
+
+#define MONT_ASM_SCRATCH \
+    [lo] "=&r"(lo), [hi] "=&r"(hi), [tmp] "=&r"(tmp), [carry] "=&r"(carry), [zero] "=&r"(zero)
+
+#define MONT_DEFINE_ADX(N)                                                                                   \
+    static void mont_mul_adx_##N(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b) { \
+        mp_limb_t t[N + 2], lo, hi, tmp, carry, zero;                                                         \
+        memset(t, 0, sizeof(t));                                                                              \
+        for (int i = 0; i < N; ++i) {                                                                         \
+            __asm__ volatile(MONT_ASM_ROW_MUL(N)                                                              \
+                             : MONT_ASM_SCRATCH                                                               \
+                             : [t] "r"(t), [a] "r"(a), "d"(b[i])                                              \
+                             : "cc", "memory");                                                               \
+            __asm__ volatile(MONT_ASM_ROW_SHIFT_REDC(N)                                                       \
+                             : MONT_ASM_SCRATCH                                                               \
+                             : [t] "r"(t), [n] "r"(ctx->n), "d"(t[0] * ctx->n0inv)                            \
+                             : "cc", "memory");                                                               \
+        }                                                                                                     \
+        __asm__ volatile(MONT_ASM_FINAL_SUB(N)                                                                \
+                         : [tmp] "=&r"(tmp)                                                                   \
+                         : [t] "r"(t), [n] "r"(ctx->n), [r] "r"(r)                                            \
+                         : "cc", "memory");                                                                   \
+    }                                                                                                         \
+    static void mont_sqr_adx_##N(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *a) {                     \
+        mp_limb_t t[2 * N + 1], lo, hi, tmp, carry, zero, top = 0;                                            \
+        memset(t, 0, sizeof(t));                                                                              \
+        __asm__ volatile(MONT_ASM_SQR_CROSS(N) MONT_ASM_SQR_DIAG(N)                                           \
+                         : MONT_ASM_SCRATCH                                                                   \
+                         : [t] "r"(t), [a] "r"(a)                                                             \
+                         : "rdx", "cc", "memory");                                                            \
+        for (int i = 0; i < N; ++i) {                                                                         \
+            __asm__ volatile(MONT_ASM_ROW_REDC(N)                                                             \
+                             : MONT_ASM_SCRATCH, [top] "+r"(top)                                              \
+                             : [t] "r"(t + i), [n] "r"(ctx->n), "d"(t[i] * ctx->n0inv)                        \
+                             : "cc", "memory");                                                               \
+        }                                                                                                     \
+        t[2 * N] = top;                                                                                       \
+        __asm__ volatile(MONT_ASM_FINAL_SUB(N)                                                                \
+                         : [tmp] "=&r"(tmp)                                                                   \
+                         : [t] "r"(t + N), [n] "r"(ctx->n), [r] "r"(r)                                        \
+                         : "cc", "memory");                                                                   \
+    }                                                                                                         \
+    static void mont_powm_adx_##N(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *base,                   \
+                                  const mp_limb_t *exp, size_t exp_bits) {                                    \
+        mont_powm_limbs(ctx, r, base, exp, exp_bits, N, mont_mul_adx_##N, mont_sqr_adx_##N);                  \
+    }
+
+MONT_DEFINE_ADX(4)
+MONT_DEFINE_ADX(8)
+MONT_DEFINE_ADX(16)
+MONT_DEFINE_ADX(32)
+
+#undef MONT_DEFINE_ADX
+#undef MONT_ASM_SCRATCH
+
+static inline int mont_cpu_has_adx(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return 0;
+    return (ebx & bit_BMI2) != 0 && (ebx & bit_ADX) != 0;
+}
+#else
+#define MONT_HAVE_ADX 0
+static inline int mont_cpu_has_adx(void) {
+    return 0;
+}
+#endif
+
+// Copies |value| into `limbs` limbs, zero-padded. value must fit.
+static inline void mont_limbs_from_mpz(mp_limb_t *out, int limbs, const mpz_t value) {
+    size_t size = mpz_size(value);
+    memcpy(out, mpz_limbs_read(value), size * sizeof(mp_limb_t));
+    memset(out + size, 0, (size_t)(limbs - (int)size) * sizeof(mp_limb_t));
+}
+
+static inline void mont_limbs_to_mpz(mpz_t out, const mp_limb_t *in, int limbs) {
+    mp_limb_t *dest = mpz_limbs_write(out, limbs);
+    memcpy(dest, in, (size_t)limbs * sizeof(mp_limb_t));
+    while (limbs > 0 && in[limbs - 1] == 0) --limbs;
+    mpz_limbs_finish(out, limbs);
+}
+
+// Sets up ctx for odd n of at most MONT_MAX_LIMBS limbs, with the fastest
+// kernel this CPU runs unless `portable` is set. Returns -1 if n is even or
+// too large, 0 otherwise.
+static inline int mont_ctx_init_kernel(mont_ctx *ctx, const mpz_t n, int portable) {
+    size_t size = mpz_size(n);
+    mpz_t value;
+
+    if (mpz_even_p(n) || mpz_cmp_ui(n, 1) <= 0 || size > MONT_MAX_LIMBS) return -1;
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->limbs = size <= 4 ? 4 : size <= 8 ? 8 : size <= 16 ? 16 : 32;
+    ctx->kernel = "portable";
+    switch (ctx->limbs) {
+    case 4: ctx->mul = mont_mul_4, ctx->sqr = mont_sqr_4, ctx->powm = mont_powm_4; break;
+    case 8: ctx->mul = mont_mul_8, ctx->sqr = mont_sqr_8, ctx->powm = mont_powm_8; break;
+    case 16: ctx->mul = mont_mul_16, ctx->sqr = mont_sqr_16, ctx->powm = mont_powm_16; break;
+    default: ctx->mul = mont_mul_32, ctx->sqr = mont_sqr_32, ctx->powm = mont_powm_32; break;
+    }
+#if MONT_HAVE_ADX
+    if (!portable && mont_cpu_has_adx()) {
+        ctx->kernel = "mulx/adx";
+        switch (ctx->limbs) {
+        case 4: ctx->mul = mont_mul_adx_4, ctx->sqr = mont_sqr_adx_4, ctx->powm = mont_powm_adx_4; break;
+        case 8: ctx->mul = mont_mul_adx_8, ctx->sqr = mont_sqr_adx_8, ctx->powm = mont_powm_adx_8; break;
+        case 16: ctx->mul = mont_mul_adx_16, ctx->sqr = mont_sqr_adx_16, ctx->powm = mont_powm_adx_16; break;
+        default: ctx->mul = mont_mul_adx_32, ctx->sqr = mont_sqr_adx_32, ctx->powm = mont_powm_adx_32; break;
+        }
+    }
+#else
+    (void)portable;
+#endif
+    mont_limbs_from_mpz(ctx->n, ctx->limbs, n);
+
+    // Newton iteration for n^-1 mod 2^64: each step doubles the correct bits
+    mp_limb_t inverse = ctx->n[0];  // correct to 3 bits for odd n
+    for (int i = 0; i < 5; ++i) inverse *= 2 - ctx->n[0] * inverse;
+    ctx->n0inv = (mp_limb_t)0 - inverse;
+
+    mpz_init(value);
+    mpz_setbit(value, (mp_bitcnt_t)ctx->limbs * 64);
+    mpz_mod(value, value, n);
+    mont_limbs_from_mpz(ctx->one, ctx->limbs, value);
+    mpz_set_ui(value, 0);
+    mpz_setbit(value, (mp_bitcnt_t)ctx->limbs * 128);
+    mpz_mod(value, value, n);
+    mont_limbs_from_mpz(ctx->r2, ctx->limbs, value);
+    mpz_clear(value);
+    return 0;
+}
+
+static inline int mont_ctx_init(mont_ctx *ctx, const mpz_t n) {
+    return mont_ctx_init_kernel(ctx, n, 0);
+}
+
+// a (reduced mod n) into Montgomery form, and back
+static inline void mont_to(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *a) {
+    ctx->mul(ctx, r, a, ctx->r2);
+}
+
+static inline void mont_from(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *a) {
+    mp_limb_t unit[MONT_MAX_LIMBS] = {1};
+    ctx->mul(ctx, r, a, unit);
+}
+
+// r = base^exp mod n on plain integers, as a drop-in for mpz_powm with this
+// context's modulus. base must be reduced mod n; exp must be non-negative.
+static inline void mont_powm_mpz(const mont_ctx *ctx, mpz_t r, const mpz_t base, const mpz_t exp) {
+    mp_limb_t base_limbs[MONT_MAX_LIMBS], result[MONT_MAX_LIMBS];
+
+    mont_limbs_from_mpz(base_limbs, ctx->limbs, base);
+    mont_to(ctx, base_limbs, base_limbs);
+    ctx->powm(ctx, result, base_limbs, mpz_limbs_read(exp), mpz_sizeinbase(exp, 2) - (mpz_sgn(exp) == 0));
+    mont_from(ctx, result, result);
+    mont_limbs_to_mpz(r, result, ctx->limbs);
+}
+
+// An exponent as MONT_FIXED_WINDOW-bit digits, most significant first. The
+// digit count follows from the bit length given to mont_fixed_exp_init(),
+// not from the exponent's value.
+typedef struct {
+    size_t count;
+    uint8_t digits[MONT_FIXED_MAX_DIGITS];
+} mont_fixed_exp;
+
+// Recodes exp for mont_powm_fixed() over `bits` bits; pass a public bound
+// such as the modulus size. Returns -1 if exp is negative or does not fit.
+static inline int mont_fixed_exp_init(mont_fixed_exp *fixed, const mpz_t exp, size_t bits) {
+    if (mpz_sgn(exp) < 0 || bits == 0 || bits > (size_t)MONT_MAX_LIMBS * 64 || mpz_sizeinbase(exp, 2) > bits) {
+        return -1;
+    }
+    fixed->count = (bits + MONT_FIXED_WINDOW - 1) / MONT_FIXED_WINDOW;
+    for (size_t i = 0; i < fixed->count; ++i) {
+        mp_bitcnt_t low = (mp_bitcnt_t)((fixed->count - 1 - i) * MONT_FIXED_WINDOW);
+        unsigned int digit = 0;
+        for (int b = MONT_FIXED_WINDOW - 1; b >= 0; --b) digit = (digit << 1) | (unsigned int)mpz_tstbit(exp, low + b);
+        fixed->digits[i] = (uint8_t)digit;
+    }
+    return 0;
+}
+
+// r = table[index], reading every entry so the addresses touched do not
+// depend on index
+static inline void mont_table_select(mp_limb_t *r, const mp_limb_t (*table)[MONT_MAX_LIMBS], unsigned int entries,
+                                     unsigned int index, int N) {
+    memset(r, 0, (size_t)N * sizeof(mp_limb_t));
+    for (unsigned int i = 0; i < entries; ++i) {
+        // All ones when i == index: (i ^ index) - 1 only borrows from zero
+        mp_limb_t mask = (mp_limb_t)0 - (((mp_limb_t)(i ^ index) - 1) >> 63);
+        for (int j = 0; j < N; ++j) r[j] |= table[i][j] & mask;
+    }
+}
+
+// r = base^exp (Montgomery form in and out), fixed window. Every digit costs
+// MONT_FIXED_WINDOW squarings and one multiplication, a zero digit
+// multiplying by one, so the sequence of operations and memory accesses is
+// the same for all exponents recoded to the same length.
+static inline void mont_powm_fixed(const mont_ctx *ctx, mp_limb_t *r, const mp_limb_t *base,
+                                   const mont_fixed_exp *exp) {
+    mp_limb_t table[1 << MONT_FIXED_WINDOW][MONT_MAX_LIMBS];  // base^0 .. base^(2^w - 1)
+    mp_limb_t acc[MONT_MAX_LIMBS], factor[MONT_MAX_LIMBS];
+    const int N = ctx->limbs;
+    const unsigned int entries = 1u << MONT_FIXED_WINDOW;
+
+    memcpy(table[0], ctx->one, (size_t)N * sizeof(mp_limb_t));
+    memcpy(table[1], base, (size_t)N * sizeof(mp_limb_t));
+    for (unsigned int i = 2; i < entries; ++i) ctx->mul(ctx, table[i], table[i - 1], base);
+
+    mont_table_select(acc, table, entries, exp->digits[0], N);
+    for (size_t i = 1; i < exp->count; ++i) {
+        for (int s = 0; s < MONT_FIXED_WINDOW; ++s) ctx->sqr(ctx, acc, acc);
+        mont_table_select(factor, table, entries, exp->digits[i], N);
+        ctx->mul(ctx, acc, acc, factor);
+    }
+    memcpy(r, acc, (size_t)N * sizeof(mp_limb_t));
+}
+
+// mont_powm_mpz() with a recoded exponent
+static inline void mont_powm_fixed_mpz(const mont_ctx *ctx, mpz_t r, const mpz_t base, const mont_fixed_exp *exp) {
+    mp_limb_t base_limbs[MONT_MAX_LIMBS], result[MONT_MAX_LIMBS];
+
+    mont_limbs_from_mpz(base_limbs, ctx->limbs, base);
+    mont_to(ctx, base_limbs, base_limbs);
+    mont_powm_fixed(ctx, result, base_limbs, exp);
+    mont_from(ctx, result, result);
+    mont_limbs_to_mpz(r, result, ctx->limbs);
+}
+
+#endif
@@ -3,19 +3,19 @@ import matplotlib.pyplot as plt
 import numpy as np
 import os
 
+from bench_results import load_sort_results
+
 def create_plots():
     """
     Create comprehensive plots for sorting algorithm analysis including normalization
     """
-    # Check if the results file exists
-    if not os.path.exists('detailed_results.csv'):
-        print("Error: detailed_results.csv not found!")
+    # Read the data: allSort's CSV, or the driver's JSONL if there is no CSV
+    df = load_sort_results()
+    if df is None:
+        print("Error: neither detailed_results.csv nor benchmark_results.jsonl found!")
         print("Please make sure the detailed_results.csv file is in the current directory.")
         return
     
-    # Read the data
-    df = pd.read_csv('detailed_results.csv')
-    
     # Set up the plotting style
     plt.style.use('default')
     plt.rcParams['figure.figsize'] = (12, 8)
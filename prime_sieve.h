@@ -0,0 +1,84 @@
+#ifndef PRIME_SIEVE_H
+#define PRIME_SIEVE_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <gmp.h>
+
+// Incremental sieve for prime searches over base, base+2, base+4, ...
+// Shared by the sequential and the parallel searches in rabin.c. The prime
+// table is filled once per program, safely from any thread; a prime_sieve_t
+// belongs to one thread.
+
+#define SIEVE_PRIME_COUNT 2048   // Odd primes (3 .. 17881) the candidate sieve divides by
+#define SIEVE_TABLE_LIMIT 18000  // Bound for the Eratosthenes pass that finds them
+#define SIEVE_MIN_BITS 16        // Below this a candidate could itself be a sieve prime
+
+// Residues of base + offset modulo every sieve prime. Stepping to the next
+// odd candidate is one add and one conditional subtract per prime, with no
+// multi-precision arithmetic at all.
+typedef struct {
+    unsigned int residues[SIEVE_PRIME_COUNT];
+    unsigned long offset;
+} prime_sieve_t;
+
+static unsigned int sieve_primes[SIEVE_PRIME_COUNT];
+static pthread_once_t sieve_primes_once = PTHREAD_ONCE_INIT;
+
+static inline void fill_sieve_primes(void) {
+    static unsigned char composite[SIEVE_TABLE_LIMIT];
+    int count = 0;
+
+    for (unsigned int i = 3; i < SIEVE_TABLE_LIMIT && count < SIEVE_PRIME_COUNT; i += 2) {
+        if (composite[i]) continue;
+        sieve_primes[count++] = i;
+        for (unsigned int j = i * i; j < SIEVE_TABLE_LIMIT; j += 2 * i) {
+            composite[j] = 1;
+        }
+    }
+}
+
+// Fill sieve_primes with the first SIEVE_PRIME_COUNT odd primes
+static inline void init_sieve_primes(void) {
+    pthread_once(&sieve_primes_once, fill_sieve_primes);
+}
+
+// Start the sieve at base. Consecutive primes are grouped so that their
+// product fits in a word: one mpz_fdiv_ui per group instead of per prime.
+// Returns 1 if base itself has no factor in the table.
+static inline int prime_sieve_start(prime_sieve_t *sieve, const mpz_t base) {
+    int survivor = 1;
+
+    init_sieve_primes();
+    for (int i = 0; i < SIEVE_PRIME_COUNT;) {
+        unsigned long modulus = sieve_primes[i];
+        int end = i + 1;
+        while (end < SIEVE_PRIME_COUNT && modulus <= ULONG_MAX / sieve_primes[end]) {
+            modulus *= sieve_primes[end++];
+        }
+        unsigned long residue = mpz_fdiv_ui(base, modulus);
+        for (; i < end; i++) {
+            sieve->residues[i] = (unsigned int)(residue % sieve_primes[i]);
+            survivor &= sieve->residues[i] != 0;
+        }
+    }
+    sieve->offset = 0;
+    return survivor;
+}
+
+// Step to the next odd candidate (offset += 2). Returns 1 if it has no
+// factor in the table. Branch-free so the compiler can vectorize it.
+static inline int prime_sieve_advance(prime_sieve_t *sieve) {
+    unsigned int hits = 0;
+
+    for (int i = 0; i < SIEVE_PRIME_COUNT; i++) {
+        unsigned int r = sieve->residues[i] + 2;
+        r -= (r >= sieve_primes[i]) ? sieve_primes[i] : 0;
+        sieve->residues[i] = r;
+        hits |= (r == 0);
+    }
+    sieve->offset += 2;
+    return hits == 0;
+}
+
+#endif
@@ -1,37 +1,70 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <gmp.h>
 #include <time.h>
 #include <math.h>
 #include <string.h>
-#include <x86intrin.h>  // for rdtsc on x86 CPUs
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "bench_harness.h"
+#include "montgomery.h"
+#include "prime_sieve.h"
+#include "rabin.h"
 
 // Configuration constants
 #define PRIME_BITS 256        // Size of each prime (p and q)
 #define COMPOSITE_BITS 512    // Size of composite n = p*q
 #define TRIAL_RUNS 1000000    // Number of Miller-Rabin trials for analysis
 #define GENERATION_ROUNDS 40  // Rounds for prime generation (high security)
+#define GENERATION_BENCH_PRIMES 32  // Primes per method at 256 bits, halved per size doubling
+#define WORKSPACE_BENCH_ROUNDS 20000  // Rounds per variant in the workspace comparison
+#define MODEXP_BENCH_RUNS 200         // Timed runs per backend and size, at 256 bits
+#define PRIMALITY_BENCH_PRIMES 16     // Primes generated per test at 256 bits, halved per size doubling
+#define TRIAL_CHUNK 10000             // Trials per independently seeded chunk
+#define MAX_TRIAL_THREADS 256
 
 // Global random state
 gmp_randstate_t global_state;
 
-// Timing utilities
-static inline unsigned long long rdtsc(void) {
-    return __rdtsc();
-}
-
 // Statistics structure for analysis
 typedef struct {
     unsigned long total_trials;
     unsigned long false_positives;
-    unsigned long long total_cycles;
-    double min_time_ms;
-    double max_time_ms;
-    double avg_time_ms;
+    bench_summary cycles;     // per-trial cycle distribution
+    double avg_time_ms;       // wall time over all threads, per trial
+    int threads;
+    unsigned long seed;       // per-chunk witness generators derive from this
     double theoretical_bound;
     double empirical_rate;
 } analysis_stats_t;
 
+// Montgomery-form operands of one context: the witness and x live here
+// between squarings, and 1 and n-1 are kept in Montgomery form to compare with
+struct mr_mont_state {
+    mont_ctx mont;
+    mp_limb_t one[MONT_MAX_LIMBS];
+    mp_limb_t minus_one[MONT_MAX_LIMBS];
+    mp_limb_t witness[MONT_MAX_LIMBS];
+    mp_limb_t x[MONT_MAX_LIMBS];
+    size_t d_bits;
+};
+
+static const char *const modexp_backend_names[MR_MODEXP_COUNT] = {
+    [MR_MODEXP_GMP] = "GMP mpz_powm",
+    [MR_MODEXP_MONTGOMERY] = "Montgomery",
+};
+static mr_modexp_backend modexp_backend = MR_MODEXP_MONTGOMERY;
+
+static const char *const primality_test_names[PRIMALITY_TEST_COUNT] = {
+    [PRIMALITY_MILLER_RABIN] = "Miller-Rabin",
+    [PRIMALITY_BPSW] = "Baillie-PSW",
+};
+static primality_test_id primality_test = PRIMALITY_MILLER_RABIN;
+
 //==============================================================================
 // MILLER-RABIN IMPLEMENTATION
 //==============================================================================
@@ -94,76 +127,896 @@ void decompose_n_minus_1(const mpz_t n, mpz_t d, unsigned int *s) {
     }
 }
 
-// Full Miller-Rabin test with k rounds
-int miller_rabin_test(const mpz_t n, int k) {
+int mr_use_modexp_backend(mr_modexp_backend backend) {
+    if ((unsigned)backend >= MR_MODEXP_COUNT) return -1;
+    modexp_backend = backend;
+    return 0;
+}
+
+const char *mr_modexp_backend_name(void) {
+    return modexp_backend_names[modexp_backend];
+}
+
+// Montgomery state for ctx->n, or NULL if n is beyond the engine
+static struct mr_mont_state *mr_mont_state_new(const mr_ctx_t *ctx) {
+    struct mr_mont_state *state = malloc(sizeof(*state));
+    if (state == NULL || mont_ctx_init(&state->mont, ctx->n) != 0) {
+        free(state);
+        return NULL;
+    }
+    int limbs = state->mont.limbs;
+    memcpy(state->one, state->mont.one, sizeof(state->one));
+    mpn_sub_n(state->minus_one, state->mont.n, state->one, limbs);
+    state->d_bits = mpz_sizeinbase(ctx->d, 2);
+    return state;
+}
+
+// Set up a context for odd n >= 5
+void mr_ctx_init(mr_ctx_t *ctx, const mpz_t n) {
+    mp_bitcnt_t bits = mpz_sizeinbase(n, 2) + GMP_NUMB_BITS;
+    
+    mpz_init_set(ctx->n, n);
+    mpz_init2(ctx->n_minus_1, bits);
+    mpz_init2(ctx->d, bits);
+    mpz_init2(ctx->range, bits);
+    mpz_init2(ctx->witness, bits);
+    mpz_init2(ctx->x, bits);
+    mpz_init2(ctx->square, 2 * bits);
+    
+    mpz_sub_ui(ctx->n_minus_1, n, 1);
+    mpz_sub_ui(ctx->range, n, 3);
+    decompose_n_minus_1(n, ctx->d, &ctx->s);
+    ctx->mont = modexp_backend == MR_MODEXP_MONTGOMERY ? mr_mont_state_new(ctx) : NULL;
+    ctx->random = global_state;
+}
+
+void mr_ctx_clear(mr_ctx_t *ctx) {
+    mpz_clears(ctx->n, ctx->n_minus_1, ctx->d, ctx->range, ctx->witness, ctx->x, ctx->square, NULL);
+    free(ctx->mont);
+}
+
+// The round after the witness is drawn, in Montgomery form throughout.
+// Reduced inputs give reduced outputs, so limb comparison is exact.
+static int mr_mont_round(const mr_ctx_t *ctx, struct mr_mont_state *state) {
+    const mont_ctx *mont = &state->mont;
+    size_t size = mont->limbs * sizeof(mp_limb_t);
+    
+    mont_limbs_from_mpz(state->witness, mont->limbs, ctx->witness);
+    mont_to(mont, state->witness, state->witness);
+    mont->powm(mont, state->x, state->witness, mpz_limbs_read(ctx->d), state->d_bits);
+    if (memcmp(state->x, state->one, size) == 0 || memcmp(state->x, state->minus_one, size) == 0) {
+        return 1;
+    }
+    
+    for (unsigned int r = 1; r < ctx->s; r++) {
+        mont->sqr(mont, state->x, state->x);
+        if (memcmp(state->x, state->one, size) == 0) return 0;
+        if (memcmp(state->x, state->minus_one, size) == 0) return 1;
+    }
+    
+    return 0;
+}
+
+// Strong probable-prime test of n to the base in ctx->witness
+// Returns 1 if n passes the test (probably prime), 0 if composite
+static int mr_ctx_check(mr_ctx_t *ctx) {
+    if (ctx->mont != NULL) return mr_mont_round(ctx, ctx->mont);
+    
+    // Compute x = a^d mod n
+    mpz_powm(ctx->x, ctx->witness, ctx->d, ctx->n);
+    if (mpz_cmp_ui(ctx->x, 1) == 0 || mpz_cmp(ctx->x, ctx->n_minus_1) == 0) {
+        return 1;  // Probably prime
+    }
+    
+    // Square x up to s-1 times
+    for (unsigned int r = 1; r < ctx->s; r++) {
+        mpz_mul(ctx->square, ctx->x, ctx->x);
+        mpz_mod(ctx->x, ctx->square, ctx->n);
+        if (mpz_cmp_ui(ctx->x, 1) == 0) return 0;            // Definitely composite
+        if (mpz_cmp(ctx->x, ctx->n_minus_1) == 0) return 1;  // Probably prime
+    }
+    
+    return 0;  // Composite (witness found)
+}
+
+// Single round with a random witness (left in ctx->witness)
+// Returns 1 if n passes the test (probably prime), 0 if composite
+int mr_ctx_round(mr_ctx_t *ctx) {
+    // Generate random witness a in range [2, n-2]
+    mpz_urandomm(ctx->witness, ctx->random, ctx->range);
+    mpz_add_ui(ctx->witness, ctx->witness, 2);
+    return mr_ctx_check(ctx);
+}
+
+// Single round with a fixed base, 2 <= base <= n-2
+int mr_ctx_round_base(mr_ctx_t *ctx, unsigned long base) {
+    mpz_set_ui(ctx->witness, base);
+    return mr_ctx_check(ctx);
+}
+
+// Full Miller-Rabin test with k rounds, witnesses drawn from `random`
+int miller_rabin_test_r(const mpz_t n, int k, gmp_randstate_t random) {
     // Handle trivial cases
     if (mpz_cmp_ui(n, 2) < 0) return 0;      // n < 2
     if (mpz_cmp_ui(n, 2) == 0) return 1;     // n = 2
     if (mpz_cmp_ui(n, 3) == 0) return 1;     // n = 3
     if (mpz_even_p(n)) return 0;             // Even numbers > 2
     
-    mpz_t d, witness;
-    unsigned int s;
-    mpz_inits(d, witness, NULL);
-    
-    // Decompose n-1 = 2^s * d
-    decompose_n_minus_1(n, d, &s);
+    mr_ctx_t ctx;
+    mr_ctx_init(&ctx, n);
+    ctx.random = random;
     
     // Run k rounds
     for (int i = 0; i < k; i++) {
-        if (!miller_rabin_single_round(n, d, s, witness)) {
-            mpz_clears(d, witness, NULL);
+        if (!mr_ctx_round(&ctx)) {
+            mr_ctx_clear(&ctx);
             return 0;  // Composite
         }
     }
     
-    mpz_clears(d, witness, NULL);
+    mr_ctx_clear(&ctx);
     return 1;  // Probably prime
 }
 
+// Full Miller-Rabin test with k rounds
+int miller_rabin_test(const mpz_t n, int k) {
+    return miller_rabin_test_r(n, k, global_state);
+}
+
+//==============================================================================
+// BAILLIE-PSW
+//==============================================================================
+
+// x = x / 2 mod n, for 0 <= x < n and odd n
+static void lucas_halve(mpz_t x, const mpz_t n) {
+    if (mpz_odd_p(x)) mpz_add(x, x, n);
+    mpz_tdiv_q_2exp(x, x, 1);
+}
+
+// Strong Lucas probable-prime test with Selfridge's parameters: D is the
+// first of 5, -7, 9, -11, ... with Jacobi symbol (D/n) = -1, P = 1 and
+// Q = (1 - D) / 4. Writing n+1 = 2^s * d with d odd, n passes if U_d = 0
+// or V_(d*2^r) = 0 for some 0 <= r < s. n must be odd, above the small
+// primes and not a perfect square (otherwise no such D exists).
+static int strong_lucas_test(const mpz_t n) {
+    long D = 5;
+    for (;;) {
+        int jacobi = mpz_si_kronecker(D, n);
+        if (jacobi == -1) break;
+        if (jacobi == 0 && mpz_cmpabs_ui(n, labs(D)) != 0) return 0;  // gcd(D, n) is a factor
+        D = D > 0 ? -(D + 2) : -(D - 2);
+    }
+    long Q = (1 - D) / 4;
+    
+    mp_bitcnt_t bits = mpz_sizeinbase(n, 2) + 2 * GMP_NUMB_BITS;
+    mpz_t d, U, V, Qk, t;
+    mpz_init2(d, bits);
+    mpz_init2(U, 2 * bits);
+    mpz_init2(V, 2 * bits);
+    mpz_init2(Qk, 2 * bits);
+    mpz_init2(t, 2 * bits);
+    
+    mpz_add_ui(d, n, 1);
+    mp_bitcnt_t s = mpz_scan1(d, 0);
+    mpz_tdiv_q_2exp(d, d, s);
+    
+    // Left-to-right ladder over d from (U_1, V_1, Q^1) = (1, P, Q)
+    mpz_set_ui(U, 1);
+    mpz_set_ui(V, 1);
+    mpz_set_si(Qk, Q);
+    mpz_mod(Qk, Qk, n);
+    for (mp_bitcnt_t bit = mpz_sizeinbase(d, 2) - 1; bit-- > 0;) {
+        // k -> 2k: U_2k = U_k V_k, V_2k = V_k^2 - 2 Q^k
+        mpz_mul(U, U, V);
+        mpz_mod(U, U, n);
+        mpz_mul(V, V, V);
+        mpz_submul_ui(V, Qk, 2);
+        mpz_mod(V, V, n);
+        mpz_mul(Qk, Qk, Qk);
+        mpz_mod(Qk, Qk, n);
+        
+        if (mpz_tstbit(d, bit)) {
+            // 2k -> 2k+1: U' = (P U + V) / 2, V' = (D U + P V) / 2
+            mpz_mul_si(t, U, D);
+            mpz_add(U, U, V);
+            mpz_mod(U, U, n);
+            lucas_halve(U, n);
+            mpz_add(V, V, t);
+            mpz_mod(V, V, n);
+            lucas_halve(V, n);
+            mpz_mul_si(Qk, Qk, Q);
+            mpz_mod(Qk, Qk, n);
+        }
+    }
+    
+    int probable = mpz_sgn(U) == 0 || mpz_sgn(V) == 0;
+    for (mp_bitcnt_t r = 1; r < s && !probable; r++) {
+        mpz_mul(V, V, V);
+        mpz_submul_ui(V, Qk, 2);
+        mpz_mod(V, V, n);
+        mpz_mul(Qk, Qk, Qk);
+        mpz_mod(Qk, Qk, n);
+        probable = mpz_sgn(V) == 0;
+    }
+    
+    mpz_clears(d, U, V, Qk, t, NULL);
+    return probable;
+}
+
+// Baillie-PSW: a base-2 strong probable-prime test, then a strong Lucas
+// test. No composite is known to pass both, and none exists below 2^64.
+int bpsw_test(const mpz_t n) {
+    static const unsigned int small_primes[] = {3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+    
+    if (mpz_cmp_ui(n, 2) < 0) return 0;
+    if (mpz_cmp_ui(n, 2) == 0) return 1;
+    if (mpz_even_p(n)) return 0;
+    for (size_t i = 0; i < sizeof(small_primes) / sizeof(small_primes[0]); i++) {
+        if (mpz_cmp_ui(n, small_primes[i]) == 0) return 1;
+        if (mpz_divisible_ui_p(n, small_primes[i])) return 0;
+    }
+    
+    mr_ctx_t ctx;
+    mr_ctx_init(&ctx, n);
+    int probable = mr_ctx_round_base(&ctx, 2);
+    mr_ctx_clear(&ctx);
+    
+    return probable && !mpz_perfect_square_p(n) && strong_lucas_test(n);
+}
+
+int use_primality_test(primality_test_id test) {
+    if ((unsigned)test >= PRIMALITY_TEST_COUNT) return -1;
+    primality_test = test;
+    return 0;
+}
+
+const char *primality_test_name(void) {
+    return primality_test_names[primality_test];
+}
+
+// The selected test; rounds only applies to Miller-Rabin
+int is_probable_prime(const mpz_t n, int rounds) {
+    return primality_test == PRIMALITY_BPSW ? bpsw_test(n) : miller_rabin_test(n, rounds);
+}
+
 //==============================================================================
 // PRIME GENERATION
 //==============================================================================
 
-// Generate a random prime of specified bit length
-void generate_prime(mpz_t prime, unsigned int bits, int rounds) {
+// Random odd candidate with exactly `bits` bits
+static void random_odd_candidate(mpz_t candidate, unsigned int bits) {
+    mpz_urandomb(candidate, global_state, bits);
+    mpz_setbit(candidate, bits - 1);  // Ensure full bit length
+    mpz_setbit(candidate, 0);         // Make odd
+}
+
+// Reference search: a fresh random odd number per attempt, each one tested
+// with the full primality test. Returns the number of attempts.
+unsigned long random_prime_search(mpz_t prime, unsigned int bits, int rounds) {
     unsigned long attempts = 0;
     
-    printf("Generating %u-bit prime...", bits);
-    fflush(stdout);
-    
     do {
         attempts++;
-        // Generate random odd number with MSB set
-        mpz_urandomb(prime, global_state, bits);
-        mpz_setbit(prime, bits - 1);  // Ensure full bit length
-        mpz_setbit(prime, 0);         // Make odd
+        random_odd_candidate(prime, bits);
         
         // Skip trivial cases
         if (mpz_cmp_ui(prime, 3) <= 0) continue;
+    } while (!is_probable_prime(prime, rounds));
+    
+    return attempts;
+}
+
+// Sieved search: one random base, then odd candidates base, base+2, ...
+// Only candidates with no factor among the sieve primes reach the primality
+// test. Returns the number of primality-test attempts; *candidates (if not NULL)
+// receives the number of odd candidates examined.
+// Like every incremental search, this picks primes that follow long gaps
+// slightly more often than a fresh draw per attempt would.
+unsigned long sieve_prime_search(mpz_t prime, unsigned int bits, int rounds, unsigned long *candidates) {
+    prime_sieve_t sieve;
+    unsigned long attempts = 0, examined = 0;
+    mpz_t base;
+    
+    if (bits < SIEVE_MIN_BITS) {
+        attempts = random_prime_search(prime, bits, rounds);
+        if (candidates) *candidates = attempts;
+        return attempts;
+    }
+    
+    init_sieve_primes();
+    mpz_init(base);
+    for (;;) {
+        random_odd_candidate(base, bits);
+        int survivor = prime_sieve_start(&sieve, base);
         
-        if (attempts % 100 == 0) {
-            printf(".");
-            fflush(stdout);
+        for (;; survivor = prime_sieve_advance(&sieve)) {
+            examined++;
+            if (!survivor) continue;
+            
+            mpz_add_ui(prime, base, sieve.offset);
+            if (mpz_sizeinbase(prime, 2) != bits) break;  // Walked past 2^bits: new base
+            
+            attempts++;
+            if (is_probable_prime(prime, rounds)) {
+                mpz_clear(base);
+                if (candidates) *candidates = examined;
+                return attempts;
+            }
         }
+    }
+}
+
+// Generate a random prime of specified bit length
+void generate_prime(mpz_t prime, unsigned int bits, int rounds) {
+    unsigned long attempts, candidates;
+    
+    printf("Generating %u-bit prime...", bits);
+    fflush(stdout);
+    
+    attempts = sieve_prime_search(prime, bits, rounds, &candidates);
+    
+    printf(" Done! (Attempts: %lu of %lu sieved candidates)\n", attempts, candidates);
+}
+
+//==============================================================================
+// PARALLEL PRIME SEARCH
+//==============================================================================
+
+// A search walks the odd numbers base, base+2, ... in blocks of
+// SEARCH_BLOCK_CANDIDATES. Workers claim blocks in order, sieve them and test
+// the survivors, so several blocks are in flight at once. The answer is the
+// first probable prime of the lowest block that has one: a worker finding a
+// prime lowers found_block, which cancels every block above it, while the
+// blocks below still run to completion. That is the prime a one-thread
+// search finds, so the result depends only on the base.
+
+typedef struct {
+    prime_search *searches;
+    int search_count;
+} search_job;
+
+typedef struct {
+    search_job *job;
+    pthread_t thread;
+    int index;
+    unsigned long tested;          // candidates that reached a primality test
+} search_worker;
+
+static int search_done(prime_search *search) {
+    return atomic_load(&search->next_block) > atomic_load(&search->found_block);
+}
+
+// Sieve survivor -> probable prime? Every random choice is keyed by the
+// search and the candidate, never by the worker that happens to test it.
+static int confirm_candidate(const prime_search *search, const mpz_t candidate, unsigned long offset,
+                             gmp_randstate_t random) {
+    if (search->test == PRIMALITY_BPSW) return bpsw_test(candidate);
+
+    mr_ctx_t ctx;
+    mr_ctx_init(&ctx, candidate);
+    int probable = mr_ctx_round_base(&ctx, 2);
+    mr_ctx_clear(&ctx);
+    if (!probable) return 0;
+
+    mpz_t key;
+    mpz_init_set_ui(key, search->seed);
+    mpz_mul_2exp(key, key, 64);
+    mpz_add_ui(key, key, offset);
+    gmp_randseed(random, key);
+    mpz_clear(key);
+    return miller_rabin_test_r(candidate, search->rounds, random);
+}
+
+// Scan one block; returns 1 if it held a prime (recorded in the search)
+static int scan_block(prime_search *search, unsigned long block, prime_sieve_t *sieve, mpz_t candidate,
+                      gmp_randstate_t random, unsigned long *tested) {
+    unsigned long first = 2 * block * SEARCH_BLOCK_CANDIDATES;
+
+    mpz_add_ui(candidate, search->base, first);
+    int survivor = prime_sieve_start(sieve, candidate);
+    for (int i = 0; i < SEARCH_BLOCK_CANDIDATES; i++, survivor = prime_sieve_advance(sieve)) {
+        if (!survivor) continue;
+        if (atomic_load(&search->found_block) < block) return 0;  // cancelled
+
+        mpz_add_ui(candidate, search->base, first + sieve->offset);
+        if (mpz_sizeinbase(candidate, 2) != search->bits) return 0;
+        if (search->exponent != 0 && mpz_fdiv_ui(candidate, search->exponent) == 1) continue;
+        (*tested)++;
+        if (!confirm_candidate(search, candidate, first + sieve->offset, random)) continue;
+
+        pthread_mutex_lock(&search->lock);
+        if (block < atomic_load(&search->found_block)) {
+            mpz_set(search->prime, candidate);
+            atomic_store(&search->found_block, block);
+        }
+        pthread_mutex_unlock(&search->lock);
+        return 1;
+    }
+    return 0;
+}
+
+static void *search_worker_main(void *arg) {
+    search_worker *worker = arg;
+    search_job *job = worker->job;
+    prime_sieve_t *sieve = malloc(sizeof(*sieve));
+    gmp_randstate_t random;
+    mpz_t candidate;
+
+    if (worker->index > 0) bench_unpin();
+    if (sieve == NULL) return NULL;
+    gmp_randinit_mt(random);
+    mpz_init(candidate);
+
+    // Start on searches in turn by worker index, then help whichever is left
+    for (;;) {
+        prime_search *search = NULL;
+        for (int i = 0; i < job->search_count && search == NULL; i++) {
+            prime_search *next = &job->searches[(worker->index + i) % job->search_count];
+            if (!search_done(next)) search = next;
+        }
+        if (search == NULL) break;
+
+        unsigned long block = atomic_fetch_add(&search->next_block, 1);
+        if (block > atomic_load(&search->found_block)) continue;
+        scan_block(search, block, sieve, candidate, random, &worker->tested);
+    }
+
+    mpz_clear(candidate);
+    gmp_randclear(random);
+    free(sieve);
+    return NULL;
+}
+
+unsigned long prime_search_run(prime_search *searches, int search_count, int threads) {
+    search_worker workers[MAX_SEARCH_THREADS];
+    search_job job = {searches, search_count};
+    unsigned long tested = 0;
+    int started = 1;
+
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online < 1 ? 1 : (int)online;
+    }
+    if (threads > MAX_SEARCH_THREADS) threads = MAX_SEARCH_THREADS;
+    memset(workers, 0, sizeof(workers));
+    for (int i = 0; i < threads; i++) {
+        workers[i].job = &job;
+        workers[i].index = i;
+    }
+    // A helper that fails to start just leaves its share to the others
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, search_worker_main, &workers[i]) != 0) break;
+        started++;
+    }
+    search_worker_main(&workers[0]);
+    for (int i = 1; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    for (int i = 0; i < started; i++) {
+        tested += workers[i].tested;
+    }
+    return tested;
+}
+
+void prime_search_init(prime_search *search, gmp_randstate_t state, unsigned int bits, unsigned long exponent,
+                       primality_test_id test, int rounds) {
+    // Top two bits set, so p*q has exactly twice the bits; the third bit
+    // clear leaves 2^(bits-3) of headroom, far more than any prime gap
+    mpz_init(search->base);
+    mpz_urandomb(search->base, state, bits - 3);
+    mpz_setbit(search->base, bits - 1);
+    mpz_setbit(search->base, bits - 2);
+    mpz_setbit(search->base, 0);
+    search->bits = bits;
+    search->seed = gmp_urandomb_ui(state, 32);
+    search->exponent = exponent;
+    search->test = test;
+    search->rounds = rounds;
+    atomic_init(&search->next_block, 0);
+    atomic_init(&search->found_block, ULONG_MAX);
+    pthread_mutex_init(&search->lock, NULL);
+    mpz_init(search->prime);
+}
+
+void prime_search_clear(prime_search *search) {
+    pthread_mutex_destroy(&search->lock);
+    mpz_clears(search->base, search->prime, NULL);
+}
+
+// p and q of `bits` bits each, p != q, searched concurrently with the
+// selected primality test. Base and seeds come from global_state. Returns
+// the number of candidates tested.
+unsigned long generate_prime_pair(mpz_t p, mpz_t q, unsigned int bits, int rounds, int threads) {
+    prime_search searches[2];
+    unsigned long tested = 0;
+
+    do {
+        for (int i = 0; i < 2; i++) prime_search_init(&searches[i], global_state, bits, 0, primality_test, rounds);
+        tested += prime_search_run(searches, 2, threads);
+        mpz_set(p, searches[0].prime);
+        mpz_set(q, searches[1].prime);
+        for (int i = 0; i < 2; i++) prime_search_clear(&searches[i]);
+    } while (mpz_cmp(p, q) == 0);
+    return tested;
+}
+
+// Compare the reference search with the sieved search: Miller-Rabin
+// attempts, candidates and mean cycles per prime, 256 to 4096 bits
+void benchmark_prime_generation(int rounds) {
+    static const unsigned int sizes[] = {256, 512, 1024, 2048, 4096};
+    
+    init_sieve_primes();
+    printf("\n================================================================================\n");
+    printf("PRIME GENERATION BENCHMARK (random draws vs. incremental sieve)\n");
+    printf("================================================================================\n");
+    printf("Sieve: %d odd primes up to %u, %d Miller-Rabin rounds per accepted prime\n\n",
+           SIEVE_PRIME_COUNT, sieve_primes[SIEVE_PRIME_COUNT - 1], rounds);
+    printf("%6s | %-7s | %6s | %14s | %16s | %14s | %10s\n", "Bits", "Method", "Primes",
+           "Attempts/prime", "Candidates/prime", "Mcycles/prime", "ms/prime");
+    printf("-------+---------+--------+----------------+------------------+----------------+-----------\n");
+    
+    mpz_t prime;
+    mpz_init(prime);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        unsigned int bits = sizes[i];
+        unsigned long count = GENERATION_BENCH_PRIMES >> i;
+        double mean_ticks[2];
         
-    } while (!miller_rabin_test(prime, rounds));
+        if (count == 0) count = 1;
+        for (int sieved = 0; sieved <= 1; sieved++) {
+            unsigned long attempts = 0, candidates = 0;
+            uint64_t ticks = 0;
+            
+            for (unsigned long j = 0; j < count; j++) {
+                unsigned long examined;
+                uint64_t start = bench_start();
+                if (sieved) {
+                    attempts += sieve_prime_search(prime, bits, rounds, &examined);
+                } else {
+                    attempts += examined = random_prime_search(prime, bits, rounds);
+                }
+                ticks += bench_stop() - start;
+                candidates += examined;
+            }
+            
+            mean_ticks[sieved] = (double)ticks / count;
+            printf("%6u | %-7s | %6lu | %14.1f | %16.1f | %14.2f | %10.3f\n", bits,
+                   sieved ? "sieve" : "random", count, (double)attempts / count, (double)candidates / count,
+                   mean_ticks[sieved] / 1e6, bench_ticks_to_ns(mean_ticks[sieved]) / 1e6);
+        }
+        printf("%6u | speedup %.2fx\n", bits, mean_ticks[0] / mean_ticks[1]);
+    }
+    mpz_clear(prime);
+}
+
+// Miller-Rabin with `rounds` rounds against Baillie-PSW: cycles to accept
+// one prime, and sieved generation time per prime, 256 to 2048 bits
+void benchmark_primality_tests(int rounds) {
+    static const unsigned int sizes[] = {256, 512, 1024, 2048};
+    primality_test_id selected = primality_test;
+    
+    printf("\n================================================================================\n");
+    printf("PRIMALITY TESTS (Miller-Rabin, %d rounds vs. Baillie-PSW)\n", rounds);
+    printf("================================================================================\n");
+    printf("%6s | %-12s | %16s | %6s | %14s | %10s\n", "Bits", "Test", "Mcycles/accept", "Primes",
+           "Attempts/prime", "ms/prime");
+    printf("-------+--------------+------------------+--------+----------------+-----------\n");
     
-    printf(" Done! (Attempts: %lu)\n", attempts);
+    mpz_t prime;
+    mpz_init(prime);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        unsigned int bits = sizes[i];
+        unsigned long count = PRIMALITY_BENCH_PRIMES >> i;
+        double accept[PRIMALITY_TEST_COUNT], generate[PRIMALITY_TEST_COUNT];
+        
+        if (count == 0) count = 1;
+        for (int test = 0; test < PRIMALITY_TEST_COUNT; test++) {
+            unsigned long attempts = 0;
+            uint64_t ticks = 0;
+            
+            use_primality_test((primality_test_id)test);
+            for (unsigned long j = 0; j < count; j++) {
+                uint64_t start = bench_start();
+                attempts += sieve_prime_search(prime, bits, rounds, NULL);
+                ticks += bench_stop() - start;
+            }
+            generate[test] = (double)ticks / count;
+            
+            // The last prime found, accepted again: the cost every search pays once
+            bench_series series;
+            bench_summary summary;
+            if (bench_series_init(&series, "accept", count, 1) != 0) break;
+            for (size_t j = 0; j < bench_series_total(&series); j++) {
+                bench_region region;
+                bench_region_begin(&region);
+                is_probable_prime(prime, rounds);
+                bench_region_end(&series, &region);
+            }
+            bench_summarize(&series, &summary);
+            bench_series_free(&series);
+            accept[test] = summary.median;
+            
+            printf("%6u | %-12s | %16.3f | %6lu | %14.1f | %10.3f\n", bits, primality_test_names[test],
+                   accept[test] / 1e6, count, (double)attempts / count, bench_ticks_to_ns(generate[test]) / 1e6);
+        }
+        printf("%6u | speedup %.2fx to accept, %.2fx to generate\n", bits,
+               accept[PRIMALITY_MILLER_RABIN] / accept[PRIMALITY_BPSW],
+               generate[PRIMALITY_MILLER_RABIN] / generate[PRIMALITY_BPSW]);
+    }
+    use_primality_test(selected);
+    mpz_clear(prime);
 }
 
 //==============================================================================
 // ANALYSIS FUNCTIONS
 //==============================================================================
 
+// GMP allocation counter for the workspace comparison
+static unsigned long gmp_allocations = 0;
+static void *(*gmp_alloc_default)(size_t);
+static void *(*gmp_realloc_default)(void *, size_t, size_t);
+static void (*gmp_free_default)(void *, size_t);
+
+static void *counting_alloc(size_t size) {
+    gmp_allocations++;
+    return gmp_alloc_default(size);
+}
+
+static void *counting_realloc(void *ptr, size_t old_size, size_t new_size) {
+    gmp_allocations++;
+    return gmp_realloc_default(ptr, old_size, new_size);
+}
+
+static void count_gmp_allocations(int enable) {
+    if (enable) {
+        mp_get_memory_functions(&gmp_alloc_default, &gmp_realloc_default, &gmp_free_default);
+        mp_set_memory_functions(counting_alloc, counting_realloc, gmp_free_default);
+        gmp_allocations = 0;
+    } else {
+        mp_set_memory_functions(gmp_alloc_default, gmp_realloc_default, gmp_free_default);
+    }
+}
+
+// Compare the allocating round (miller_rabin_single_round) with the
+// workspace round (mr_ctx_round): cycles and GMP heap allocations per round
+void benchmark_round_workspace(mr_ctx_t *ctx) {
+    bench_series series[2] = {{0}};
+    unsigned long allocations[2];
+    
+    if ((bench_series_init(&series[0], "Allocating round", WORKSPACE_BENCH_ROUNDS, BENCH_WARMUP_RUNS) |
+         bench_series_init(&series[1], "Workspace round", WORKSPACE_BENCH_ROUNDS, BENCH_WARMUP_RUNS)) != 0) {
+        fprintf(stderr, "Could not allocate %d timing samples\n", WORKSPACE_BENCH_ROUNDS);
+        bench_series_free(&series[0]);
+        bench_series_free(&series[1]);
+        return;
+    }
+    
+    printf("Round workspace comparison (%d rounds each):\n", WORKSPACE_BENCH_ROUNDS);
+    for (int variant = 0; variant < 2; variant++) {
+        count_gmp_allocations(1);
+        for (size_t i = 0; i < bench_series_total(&series[variant]); i++) {
+            bench_region region;
+            bench_region_begin(&region);
+            if (variant == 0) {
+                miller_rabin_single_round(ctx->n, ctx->d, ctx->s, ctx->witness);
+            } else {
+                mr_ctx_round(ctx);
+            }
+            bench_region_end(&series[variant], &region);
+        }
+        count_gmp_allocations(0);
+        allocations[variant] = gmp_allocations;
+        bench_report(&series[variant], 1.0, "round");
+        printf("GMP heap allocations per round: %.2f\n",
+               (double)allocations[variant] / bench_series_total(&series[variant]));
+    }
+    
+    bench_summary before, after;
+    bench_summarize(&series[0], &before);
+    bench_summarize(&series[1], &after);
+    printf("Workspace speedup (median): %.3fx\n\n", before.median / after.median);
+    
+    bench_series_free(&series[0]);
+    bench_series_free(&series[1]);
+}
+
+// Median cycles of `runs` calls: variant 0 is a^d mod n, variant 1 a whole
+// round, both through whichever backend ctx was initialised with
+static double median_modexp_cycles(mr_ctx_t *ctx, int variant, unsigned long runs) {
+    bench_series series;
+    bench_summary summary;
+    
+    if (bench_series_init(&series, "modexp", runs, BENCH_WARMUP_RUNS) != 0) return 0.0;
+    mpz_urandomm(ctx->witness, global_state, ctx->range);
+    mpz_add_ui(ctx->witness, ctx->witness, 2);
+    for (size_t i = 0; i < bench_series_total(&series); i++) {
+        bench_region region;
+        bench_region_begin(&region);
+        if (variant == 1) {
+            mr_ctx_round(ctx);
+        } else if (ctx->mont != NULL) {
+            mont_powm_mpz(&ctx->mont->mont, ctx->x, ctx->witness, ctx->d);
+        } else {
+            mpz_powm(ctx->x, ctx->witness, ctx->d, ctx->n);
+        }
+        bench_region_end(&series, &region);
+    }
+    bench_summarize(&series, &summary);
+    bench_series_free(&series);
+    return summary.median;
+}
+
+// mpz_powm against the Montgomery engine at its specialized sizes
+void benchmark_modexp_backends(void) {
+    static const unsigned int sizes[] = {256, 512, 1024, 2048};
+    mr_modexp_backend selected = modexp_backend;
+    mont_ctx probe;
+    mpz_t n;
+    
+    mpz_init_set_ui(n, 5);
+    mont_ctx_init(&probe, n);
+    printf("\n================================================================================\n");
+    printf("MODULAR EXPONENTIATION BACKENDS (mpz_powm vs. Montgomery, %s kernels)\n", probe.kernel);
+    printf("================================================================================\n");
+    printf("Median cycles for a^d mod n with n-1 = 2^s * d, and for one Miller-Rabin round\n\n");
+    printf("%6s | %5s | %14s | %14s | %7s | %14s | %14s | %7s\n", "Bits", "Runs", "mpz_powm",
+           "Montgomery", "Speedup", "Round (GMP)", "Round (Mont)", "Speedup");
+    printf("-------+-------+----------------+----------------+---------+----------------+----------------+--------\n");
+    
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        unsigned int bits = sizes[i];
+        unsigned long runs = MODEXP_BENCH_RUNS >> i;
+        double cycles[2][2];
+        
+        mpz_urandomb(n, global_state, bits);
+        mpz_setbit(n, bits - 1);
+        mpz_setbit(n, 0);
+        for (int backend = 0; backend < MR_MODEXP_COUNT; backend++) {
+            mr_ctx_t ctx;
+            mr_use_modexp_backend((mr_modexp_backend)backend);
+            mr_ctx_init(&ctx, n);
+            cycles[backend][0] = median_modexp_cycles(&ctx, 0, runs);
+            cycles[backend][1] = median_modexp_cycles(&ctx, 1, runs);
+            mr_ctx_clear(&ctx);
+        }
+        printf("%6u | %5lu | %14.0f | %14.0f | %6.2fx | %14.0f | %14.0f | %6.2fx\n", bits, runs,
+               cycles[MR_MODEXP_GMP][0], cycles[MR_MODEXP_MONTGOMERY][0],
+               cycles[MR_MODEXP_GMP][0] / cycles[MR_MODEXP_MONTGOMERY][0],
+               cycles[MR_MODEXP_GMP][1], cycles[MR_MODEXP_MONTGOMERY][1],
+               cycles[MR_MODEXP_GMP][1] / cycles[MR_MODEXP_MONTGOMERY][1]);
+    }
+    mr_use_modexp_backend(selected);
+    mpz_clear(n);
+}
+
+//==============================================================================
+// PARALLEL TRIAL ENGINE
+//==============================================================================
+
+// Workers claim chunks from a shared counter. Every chunk reseeds the
+// claiming worker's generator from (seed, chunk), so which worker runs a
+// chunk, and how many workers there are, never changes its witnesses.
+typedef struct {
+    const __mpz_struct *n;
+    unsigned long trials;
+    unsigned long seed;
+    uint64_t *cycles;
+    atomic_ulong next_chunk;
+    atomic_ulong completed;
+} trial_job;
+
+typedef struct {
+    trial_job *job;
+    pthread_t thread;
+    int helper;               // runs on its own thread rather than the caller's
+    unsigned long passed;     // this worker's counter, merged after the join
+} trial_worker;
+
+static void seed_trial_chunk(gmp_randstate_t state, unsigned long seed, unsigned long chunk) {
+    mpz_t key;
+    mpz_init_set_ui(key, seed);
+    mpz_mul_2exp(key, key, 64);
+    mpz_add_ui(key, key, chunk);
+    gmp_randseed(state, key);
+    mpz_clear(key);
+}
+
+static void *trial_worker_main(void *arg) {
+    trial_worker *worker = arg;
+    trial_job *job = worker->job;
+    unsigned long chunks = (job->trials + TRIAL_CHUNK - 1) / TRIAL_CHUNK;
+    gmp_randstate_t state;
+    mr_ctx_t ctx;
+    
+    if (worker->helper) bench_unpin();
+    
+    gmp_randinit_mt(state);
+    mr_ctx_init(&ctx, job->n);
+    ctx.random = state;
+    
+    // Warm-up rounds (caches, branch predictors) are neither timed nor counted
+    seed_trial_chunk(state, job->seed, ULONG_MAX);
+    for (int i = 0; i < BENCH_WARMUP_RUNS; i++) {
+        mr_ctx_round(&ctx);
+    }
+    
+    for (;;) {
+        unsigned long chunk = atomic_fetch_add(&job->next_chunk, 1);
+        if (chunk >= chunks) break;
+        unsigned long first = chunk * TRIAL_CHUNK;
+        unsigned long last = first + TRIAL_CHUNK < job->trials ? first + TRIAL_CHUNK : job->trials;
+        
+        seed_trial_chunk(state, job->seed, chunk);
+        for (unsigned long i = first; i < last; i++) {
+            uint64_t start = bench_start();
+            int result = mr_ctx_round(&ctx);
+            uint64_t elapsed = bench_stop() - start;
+            if (job->cycles != NULL) {
+                job->cycles[i] = elapsed > bench_env.overhead ? elapsed - bench_env.overhead : 0;
+            }
+            worker->passed += (unsigned long)result;
+        }
+        
+        // Progress indicator
+        unsigned long done = atomic_fetch_add(&job->completed, last - first) + (last - first);
+        if (done % 100000 == 0 && done < job->trials) {
+            printf("Progress: %lu/%lu trials completed\n", done, job->trials);
+        }
+    }
+    
+    mr_ctx_clear(&ctx);
+    gmp_randclear(state);
+    return NULL;
+}
+
+// Threads a run of `trials` actually uses for a request of `threads`
+static int trial_thread_count(int threads, unsigned long trials) {
+    unsigned long chunks = (trials + TRIAL_CHUNK - 1) / TRIAL_CHUNK;
+    
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online < 1 ? 1 : (int)online;
+    }
+    if (threads > MAX_TRIAL_THREADS) threads = MAX_TRIAL_THREADS;
+    if ((unsigned long)threads > chunks) threads = chunks > 0 ? (int)chunks : 1;
+    return threads;
+}
+
+unsigned long mr_parallel_trials(const mpz_t n, unsigned long trials, unsigned long seed, int threads,
+                                 uint64_t *cycles) {
+    trial_worker workers[MAX_TRIAL_THREADS];
+    trial_job job = {.n = n, .trials = trials, .seed = seed, .cycles = cycles};
+    unsigned long passed = 0;
+    int started = 1;
+    
+    threads = trial_thread_count(threads, trials);
+    atomic_init(&job.next_chunk, 0);
+    atomic_init(&job.completed, 0);
+    
+    // The calling thread is worker 0; a helper that fails to start just
+    // leaves its share to the others
+    memset(workers, 0, sizeof(workers));
+    for (int i = 0; i < threads; i++) workers[i].job = &job;
+    for (int i = 1; i < threads; i++) {
+        workers[i].helper = 1;
+        if (pthread_create(&workers[i].thread, NULL, trial_worker_main, &workers[i]) != 0) break;
+        started++;
+    }
+    trial_worker_main(&workers[0]);
+    for (int i = 1; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    
+    for (int i = 0; i < started; i++) {
+        passed += workers[i].passed;
+    }
+    return passed;
+}
+
 // Run comprehensive Miller-Rabin analysis on composite number
 void analyze_miller_rabin_performance(const mpz_t n, analysis_stats_t *stats) {
-    mpz_t d, witness;
-    unsigned int s;
-    mpz_inits(d, witness, NULL);
-    
-    // Decompose n-1 = 2^s * d
-    decompose_n_minus_1(n, d, &s);
+    mr_ctx_t ctx;
+    mr_ctx_init(&ctx, n);
     
     printf("\n================================================================================\n");
     printf("MILLER-RABIN PERFORMANCE ANALYSIS\n");
@@ -171,46 +1024,50 @@ void analyze_miller_rabin_performance(const mpz_t n, analysis_stats_t *stats) {
     
     printf("Composite number n has %zu bits\n", mpz_sizeinbase(n, 2));
     printf("Decomposition: n-1 = 2^%u × d, where d has %zu bits\n", 
-           s, mpz_sizeinbase(d, 2));
-    printf("Running %d Miller-Rabin trials...\n\n", TRIAL_RUNS);
+           ctx.s, mpz_sizeinbase(ctx.d, 2));
+    
+    bench_print_environment();
+    printf("Modular exponentiation: %s\n", ctx.mont != NULL ? modexp_backend_names[MR_MODEXP_MONTGOMERY]
+                                                            : modexp_backend_names[MR_MODEXP_GMP]);
+    benchmark_round_workspace(&ctx);
     
+
     // Initialize statistics
     stats->total_trials = TRIAL_RUNS;
     stats->false_positives = 0;
-    stats->total_cycles = 0;
-    stats->min_time_ms = 1e9;
-    stats->max_time_ms = 0;
     stats->theoretical_bound = 0.25;  // 1/4
     
-    // Run trials with timing
-    clock_t start_time = clock();
-    
-    for (unsigned long i = 0; i < TRIAL_RUNS; i++) {
-        // Measure cycles for this trial
-        unsigned long long cycle_start = rdtsc();
-        int result = miller_rabin_single_round(n, d, s, witness);
-        unsigned long long cycle_end = rdtsc();
-        
-        stats->total_cycles += (cycle_end - cycle_start);
-        
-        if (result) {
-            stats->false_positives++;
-        }
-        
-        // Progress indicator
-        if (i % 100000 == 0 && i > 0) {
-            printf("Progress: %lu/%d trials completed\n", i, TRIAL_RUNS);
-        }
+    bench_series series;
+    if (bench_series_init(&series, "Miller-Rabin round", TRIAL_RUNS, 0) != 0) {
+        fprintf(stderr, "Could not allocate %d timing samples\n", TRIAL_RUNS);
+        exit(EXIT_FAILURE);
     }
     
-    clock_t end_time = clock();
-    double total_time_ms = ((double)(end_time - start_time)) / CLOCKS_PER_SEC * 1000.0;
+    // Trials draw from their own generators, seeded from global_state, so a
+    // fixed RABIN_SEED reproduces the counts whatever RABIN_THREADS is
+    const char *threads_override = getenv("RABIN_THREADS");
+    stats->threads = trial_thread_count(threads_override ? atoi(threads_override) : 0, TRIAL_RUNS);
+    stats->seed = gmp_urandomb_ui(global_state, 32);
+    printf("Running %d Miller-Rabin trials on %d threads (trial seed %lu)...\n\n", TRIAL_RUNS,
+           stats->threads, stats->seed);
+    
+    // Run trials with timing
+    struct timespec start_time, end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    stats->false_positives = mr_parallel_trials(n, TRIAL_RUNS, stats->seed, stats->threads, series.ticks);
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    series.count = TRIAL_RUNS;
+    double total_time_ms = (end_time.tv_sec - start_time.tv_sec) * 1000.0 +
+                           (end_time.tv_nsec - start_time.tv_nsec) / 1e6;
     
     // Calculate statistics
     stats->avg_time_ms = total_time_ms / TRIAL_RUNS;
     stats->empirical_rate = (double)stats->false_positives / stats->total_trials;
+    bench_summarize(&series, &stats->cycles);
+    stats->cycles.have_counters = 0;  // counter groups are per thread and only the caller's is open
     
-    mpz_clears(d, witness, NULL);
+    bench_series_free(&series);
+    mr_ctx_clear(&ctx);
 }
 
 // Print detailed analysis results
@@ -253,8 +1110,15 @@ void print_analysis_results(const analysis_stats_t *stats, const mpz_t p, const
     
     // Performance metrics
     printf("Performance Metrics:\n");
-    printf("  Average CPU cycles per trial: %.2f\n", (double)stats->total_cycles / stats->total_trials);
-    printf("  Average time per trial: %.6f ms\n", stats->avg_time_ms);
+    printf("  Median CPU cycles per trial: %.0f (95%% CI %.0f-%.0f)\n", stats->cycles.median,
+           stats->cycles.ci_low, stats->cycles.ci_high);
+    printf("  Cycle percentiles: p5 %.0f, p95 %.0f\n", stats->cycles.p5, stats->cycles.p95);
+    printf("  Mean CPU cycles per trial: %.2f (%zu outliers excluded)\n", stats->cycles.mean,
+           stats->cycles.outliers);
+    printf("  Median time per trial: %.3f us\n", bench_ticks_to_ns(stats->cycles.median) / 1000.0);
+    bench_report_counters("  Counters: ", &stats->cycles, 1.0, "trial");
+    printf("  Threads: %d (trial seed %lu)\n", stats->threads, stats->seed);
+    printf("  Average wall time per trial: %.6f ms\n", stats->avg_time_ms);
     printf("  Estimated trials per second: %.0f\n", 1000.0 / stats->avg_time_ms);
     printf("\n");
     
@@ -301,7 +1165,11 @@ void save_results_to_file(const analysis_stats_t *stats, const mpz_t p, const mp
     fprintf(fp, "  False positives: %lu\n", stats->false_positives);
     fprintf(fp, "  Empirical rate: %.8f\n", stats->empirical_rate);
     fprintf(fp, "  Theoretical bound: %.8f\n", stats->theoretical_bound);
-    fprintf(fp, "  Average cycles: %.2f\n", (double)stats->total_cycles / stats->total_trials);
+    fprintf(fp, "  Median cycles: %.0f (95%% CI %.0f-%.0f, p5 %.0f, p95 %.0f)\n", stats->cycles.median,
+            stats->cycles.ci_low, stats->cycles.ci_high, stats->cycles.p5, stats->cycles.p95);
+    fprintf(fp, "  Mean cycles (outliers excluded): %.2f\n", stats->cycles.mean);
+    fprintf(fp, "  Threads: %d, trial seed: %lu\n", stats->threads, stats->seed);
+    fprintf(fp, "  TSC frequency: %.3f GHz\n", bench_env.tsc_ghz);
     
     fclose(fp);
     printf("Results saved to 'miller_rabin_analysis.txt'\n");
@@ -340,14 +1208,20 @@ void print_theoretical_analysis(void) {
     printf("   - Recommended k for practice: %d (with safety margin)\n", min_rounds + 10);
 }
 
+#if !defined(BENCH_DRIVER) && !defined(RABIN_NO_MAIN)
 //==============================================================================
 // MAIN FUNCTION
 //==============================================================================
 
+BENCH_HOST_DEFINE;
+
 int main(void) {
     // Initialize random number generator
+    // RABIN_SEED fixes every random draw, so a run can be repeated exactly
+    const char *seed_override = getenv("RABIN_SEED");
     gmp_randinit_mt(global_state);
-    gmp_randseed_ui(global_state, time(NULL) ^ clock());
+    gmp_randseed_ui(global_state, seed_override ? strtoul(seed_override, NULL, 0) : (unsigned long)(time(NULL) ^ clock()));
+    bench_init();
     
     printf("Miller-Rabin Primality Test - Comprehensive Analysis\n");
     printf("====================================================\n");
@@ -366,18 +1240,23 @@ int main(void) {
     printf("PRIME GENERATION PHASE\n");
     printf("================================================================================\n");
     
-    // Generate two 256-bit primes
-    clock_t gen_start = clock();
-    generate_prime(p, PRIME_BITS, GENERATION_ROUNDS);
-    generate_prime(q, PRIME_BITS, GENERATION_ROUNDS);
-    clock_t gen_end = clock();
+    // Generate two 256-bit primes, searched concurrently on every online CPU
+    printf("Generating two %d-bit primes...", PRIME_BITS);
+    fflush(stdout);
+    double gen_start = bench_now_ns();
+    unsigned long tested = generate_prime_pair(p, q, PRIME_BITS, GENERATION_ROUNDS, 0);
+    double generation_time = (bench_now_ns() - gen_start) / 1e9;
+    printf(" Done! (%lu candidates tested)\n", tested);
     
     // Compute composite n = p × q
     mpz_mul(n, p, q);
     
-    double generation_time = ((double)(gen_end - gen_start)) / CLOCKS_PER_SEC;
     printf("\nPrime generation completed in %.2f seconds\n", generation_time);
     
+    benchmark_prime_generation(GENERATION_ROUNDS);
+    benchmark_primality_tests(GENERATION_ROUNDS);
+    benchmark_modexp_backends();
+    
     // Verify our generated numbers
     printf("\nVerification:\n");
     printf("  p is prime: %s\n", miller_rabin_test(p, 20) ? "YES" : "NO");
@@ -402,4 +1281,5 @@ int main(void) {
     gmp_randclear(global_state);
     
     return 0;
-}
\ No newline at end of file
+}
+#endif
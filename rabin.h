@@ -0,0 +1,116 @@
+#ifndef RABIN_H
+#define RABIN_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <gmp.h>
+
+// Miller-Rabin primality testing and prime generation from rabin.c. Build
+// rabin.c with -DBENCH_DRIVER or -DRABIN_NO_MAIN to leave its analysis main
+// out and link the functions into another program. Witnesses and candidates
+// are drawn from global_state, which the caller seeds; the _r variants,
+// bpsw_test() and prime_search_run() do not touch it and are safe to call
+// from several threads.
+
+extern gmp_randstate_t global_state;
+
+// Modular exponentiation behind every round. The Montgomery engine
+// (montgomery.h) is the default; moduli above its 2048-bit limit use GMP
+// whatever the selection.
+typedef enum {
+    MR_MODEXP_GMP,         // mpz_powm, then mpz_mul and mpz_mod per squaring
+    MR_MODEXP_MONTGOMERY,  // fixed-size Montgomery kernels for 4, 8, 16 and 32 limbs
+    MR_MODEXP_COUNT
+} mr_modexp_backend;
+
+// Applies to contexts initialised afterwards. Returns -1 for an unknown id.
+int mr_use_modexp_backend(mr_modexp_backend backend);
+const char *mr_modexp_backend_name(void);
+
+// Test that prime generation accepts candidates with. Miller-Rabin runs the
+// requested number of random-base rounds; Baillie-PSW ignores that count.
+typedef enum {
+    PRIMALITY_MILLER_RABIN,
+    PRIMALITY_BPSW,
+    PRIMALITY_TEST_COUNT
+} primality_test_id;
+
+int use_primality_test(primality_test_id test);
+const char *primality_test_name(void);
+
+struct mr_mont_state;
+
+// Miller-Rabin context for one modulus. Everything a round needs is computed
+// once here, and the working values are allocated at their final size, so
+// a round does no allocation of its own.
+typedef struct {
+    mpz_t n;
+    mpz_t n_minus_1;
+    mpz_t d;          // n-1 = 2^s * d, d odd
+    mpz_t range;      // n-3: witnesses are drawn from [0, n-4] and shifted by 2
+    mpz_t witness;    // witness of the latest round
+    mpz_t x;
+    mpz_t square;     // x^2 before reduction mod n
+    unsigned int s;
+    struct mr_mont_state *mont;  // Montgomery operands, or NULL when GMP runs this modulus
+    __gmp_randstate_struct *random;  // witness source: global_state unless the owner sets another
+} mr_ctx_t;
+
+void mr_ctx_init(mr_ctx_t *ctx, const mpz_t n);
+void mr_ctx_clear(mr_ctx_t *ctx);
+int mr_ctx_round(mr_ctx_t *ctx);
+int mr_ctx_round_base(mr_ctx_t *ctx, unsigned long base);
+
+// Runs `trials` random-witness rounds on odd n >= 5 over `threads` threads
+// (0: one per online CPU) and returns how many passed. Trials are cut into
+// fixed chunks, each drawing witnesses from its own generator seeded with
+// (seed, chunk index), so the count depends only on n, trials and seed. If
+// cycles is non-NULL it receives the TSC ticks of each trial, by trial index.
+unsigned long mr_parallel_trials(const mpz_t n, unsigned long trials, unsigned long seed, int threads,
+                                 uint64_t *cycles);
+
+int miller_rabin_single_round(const mpz_t n, const mpz_t d, unsigned int s, mpz_t witness);
+void decompose_n_minus_1(const mpz_t n, mpz_t d, unsigned int *s);
+int miller_rabin_test(const mpz_t n, int k);
+int miller_rabin_test_r(const mpz_t n, int k, gmp_randstate_t random);
+int bpsw_test(const mpz_t n);
+int is_probable_prime(const mpz_t n, int rounds);
+
+#define SEARCH_BLOCK_CANDIDATES 64    // Odd candidates per block a search worker claims
+#define MAX_SEARCH_THREADS 256
+
+// Concurrent prime search over sieved blocks of odd candidates from a random
+// base. Any number of searches share one set of threads, and each finds the
+// prime a one-thread search from the same base would, so the result does not
+// depend on the thread count.
+typedef struct {
+    mpz_t base;
+    unsigned int bits;
+    unsigned long seed;            // with the candidate offset, keys the random-base rounds
+    unsigned long exponent;        // candidates with p = 1 mod exponent are skipped; 0 for none
+    primality_test_id test;        // Baillie-PSW, or base 2 then `rounds` random-base rounds
+    int rounds;
+    atomic_ulong next_block;
+    atomic_ulong found_block;      // ULONG_MAX until a prime is found
+    pthread_mutex_t lock;
+    mpz_t prime;                   // the result, after prime_search_run()
+} prime_search;
+
+// Draws the base and seed from state. The base has its top two bits set, so
+// the product of two such primes has exactly 2*bits bits.
+void prime_search_init(prime_search *search, gmp_randstate_t state, unsigned int bits, unsigned long exponent,
+                       primality_test_id test, int rounds);
+void prime_search_clear(prime_search *search);
+
+// Runs the searches together on `threads` threads (0: one per online CPU),
+// the caller being one of them. Returns the number of candidates tested,
+// including speculative ones.
+unsigned long prime_search_run(prime_search *searches, int search_count, int threads);
+
+unsigned long random_prime_search(mpz_t prime, unsigned int bits, int rounds);
+unsigned long sieve_prime_search(mpz_t prime, unsigned int bits, int rounds, unsigned long *candidates);
+void generate_prime(mpz_t prime, unsigned int bits, int rounds);
+unsigned long generate_prime_pair(mpz_t p, mpz_t q, unsigned int bits, int rounds, int threads);
+
+#endif
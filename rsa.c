@@ -1,40 +1,632 @@
-
-
+#define _GNU_SOURCE
 #include <gmp.h>
 #include <stdio.h>
 #include <stdlib.h> // For exit()
+#include <string.h>
 #include <time.h>   // For seeding
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
 
-int main() {
+#include "bench_harness.h"
+#include "montgomery.h"
+#include "rabin.h"
+#include "rsa.h"
+
+// RSA key generation on the parallel, speculative prime search of rabin.c,
+// and the RSA primitives with CRT private operations.
+//
+//   gcc -O2 -DRABIN_NO_MAIN rsa.c rabin.c -lgmp -lm -pthread
+//
+// RSA_SEED fixes the random draws and RSA_THREADS the number of search
+// threads (default: one per online CPU). For a given seed the primes do not
+// depend on the thread count. RSA_TEST=miller-rabin confirms candidates
+// with Miller-Rabin instead of Baillie-PSW.
+
+#define MODULUS_BITS 2048             // Key generated by main
+#define RSA_BENCH_OPS 400             // Timed private operations at 1024 bits, halved per size step
+#define MILLER_RABIN_ROUNDS 40        // Rounds after the base-2 test when Miller-Rabin is selected
+#define KEYGEN_BENCH_KEYS 8           // Keys per point at 2048 bits, halved for larger moduli
+#define BATCH_BENCH_BITS 2048         // Key size of the batch signing benchmark
+#define BATCH_BENCH_MAX 1024          // Largest batch, from 1 in powers of 4
+
+static int online_threads(void) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) return 1;
+    return online > MAX_SEARCH_THREADS ? MAX_SEARCH_THREADS : (int)online;
+}
+
+// Test that confirms a sieve survivor: Baillie-PSW, or a base-2 strong test
+// followed by MILLER_RABIN_ROUNDS random-base rounds
+static primality_test_id key_test = PRIMALITY_BPSW;
+
+// p and q of modulus_bits/2 bits each, p != q, searched concurrently. The
+// public exponent is prime, so skipping p = 1 mod e makes p-1 coprime to it.
+// Everything is drawn from a generator seeded with `seed`, so the same seed
+// gives the same primes for any thread count. Returns candidates tested.
+unsigned long rsa_generate_primes(mpz_t p, mpz_t q, unsigned int modulus_bits, unsigned long seed, int threads) {
+    prime_search searches[2];
+    gmp_randstate_t state;
+    unsigned long tested = 0;
+
+    gmp_randinit_mt(state);
+    gmp_randseed_ui(state, seed);
+    do {
+        for (int i = 0; i < 2; i++) {
+            prime_search_init(&searches[i], state, modulus_bits / 2, RSA_PUBLIC_EXPONENT, key_test,
+                              MILLER_RABIN_ROUNDS);
+        }
+        tested += prime_search_run(searches, 2, threads);
+        mpz_set(p, searches[0].prime);
+        mpz_set(q, searches[1].prime);
+        for (int i = 0; i < 2; i++) prime_search_clear(&searches[i]);
+    } while (mpz_cmp(p, q) == 0);
+    gmp_randclear(state);
+    return tested;
+}
+
+//==============================================================================
+// RSA KEYS AND OPERATIONS
+//==============================================================================
+
+void rsa_key_init(rsa_key *key) {
+    key->bits = 0;
+    mpz_inits(key->n, key->e, key->d, key->p, key->q, key->dP, key->dQ, key->qInv, NULL);
+}
+
+void rsa_key_clear(rsa_key *key) {
+    mpz_clears(key->n, key->e, key->d, key->p, key->q, key->dP, key->dQ, key->qInv, NULL);
+}
+
+int rsa_key_from_primes(rsa_key *key, const mpz_t p, const mpz_t q) {
+    mpz_t p_minus_1, q_minus_1, lambda;
+    int status = 0;
+
+    mpz_inits(p_minus_1, q_minus_1, lambda, NULL);
+    mpz_set(key->p, p);
+    mpz_set(key->q, q);
+    mpz_mul(key->n, p, q);
+    key->bits = (unsigned int)mpz_sizeinbase(key->n, 2);
+    mpz_set_ui(key->e, RSA_PUBLIC_EXPONENT);
+
+    // d from Carmichael's lambda(n) = lcm(p-1, q-1), the smallest valid d
+    mpz_sub_ui(p_minus_1, p, 1);
+    mpz_sub_ui(q_minus_1, q, 1);
+    mpz_lcm(lambda, p_minus_1, q_minus_1);
+    if (mpz_invert(key->d, key->e, lambda) == 0 || mpz_invert(key->qInv, q, p) == 0) {
+        status = -1;
+    } else {
+        mpz_mod(key->dP, key->d, p_minus_1);
+        mpz_mod(key->dQ, key->d, q_minus_1);
+    }
+
+    mpz_clears(p_minus_1, q_minus_1, lambda, NULL);
+    return status;
+}
+
+int rsa_generate_key(rsa_key *key, unsigned int modulus_bits, unsigned long seed, int threads) {
+    mpz_t p, q;
+    int status;
+
+    mpz_inits(p, q, NULL);
+    rsa_generate_primes(p, q, modulus_bits, seed, threads);
+    status = rsa_key_from_primes(key, p, q);
+    mpz_clears(p, q, NULL);
+    return status;
+}
+
+int rsa_public(const rsa_key *key, mpz_t out, const mpz_t in) {
+    if (mpz_sgn(in) < 0 || mpz_cmp(in, key->n) >= 0) return -1;
+    mpz_powm(out, in, key->e, key->n);
+    return 0;
+}
+
+// Garner's recombination: m1 = in^dP mod p, m2 = in^dQ mod q,
+// h = qInv * (m1 - m2) mod p, out = m2 + h*q. Each exponentiation has half
+// the modulus and half the exponent of in^d mod n, so about an eighth of
+// the work with schoolbook multiplication, and around a quarter with GMP's
+// subquadratic kernels.
+int rsa_private(const rsa_key *key, mpz_t out, const mpz_t in) {
+    mpz_t m1, m2, h;
+
+    if (mpz_sgn(in) < 0 || mpz_cmp(in, key->n) >= 0) return -1;
+    mpz_inits(m1, m2, h, NULL);
+    mpz_mod(h, in, key->p);
+    mpz_powm(m1, h, key->dP, key->p);
+    mpz_mod(h, in, key->q);
+    mpz_powm(m2, h, key->dQ, key->q);
+
+    mpz_sub(h, m1, m2);
+    mpz_mul(h, h, key->qInv);
+    mpz_mod(h, h, key->p);
+    mpz_mul(h, h, key->q);
+    mpz_add(out, m2, h);
+
+    mpz_clears(m1, m2, h, NULL);
+    return 0;
+}
+
+int rsa_private_no_crt(const rsa_key *key, mpz_t out, const mpz_t in) {
+    if (mpz_sgn(in) < 0 || mpz_cmp(in, key->n) >= 0) return -1;
+    mpz_powm(out, in, key->d, key->n);
+    return 0;
+}
+
+//==============================================================================
+// PRIVATE-KEY CONTEXT AND BATCHES
+//==============================================================================
+
+// Working values of one private operation, allocated once at full size
+typedef struct {
+    mpz_t m1;
+    mpz_t m2;
+    mpz_t h;
+} rsa_scratch;
+
+struct rsa_private_ctx {
+    const rsa_key *key;
+    mont_ctx mont_p;              // valid when have_mont; p and q up to 2048 bits
+    mont_ctx mont_q;
+    mont_fixed_exp dP_digits;     // dP and dQ recoded over the bit lengths of p and q
+    mont_fixed_exp dQ_digits;
+    int have_mont;
+    int threads;
+    rsa_scratch *scratch;         // one per thread, the caller's first
+    pthread_t *helpers;           // threads - 1 pool threads
+    int helpers_started;
+
+    // The batch in progress. Helpers wake when generation changes and
+    // claim messages from next until count is reached.
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;
+    pthread_cond_t job_done;
+    unsigned long generation;
+    int busy_helpers;
+    int shutdown;
+    mpz_t *out;
+    mpz_t *in;
+    size_t count;
+    atomic_size_t next;
+    atomic_int rejected;
+};
+
+typedef struct {
+    rsa_private_ctx *ctx;
+    int index;
+} rsa_helper_arg;
+
+// The CRT operation of rsa_private() with cached Montgomery contexts. The
+// exponentiations by the secret dP and dQ use the fixed window, so their
+// sequence of multiplications does not depend on the key; without Montgomery
+// contexts, GMP's mpz_powm_sec gives the same property.
+static int ctx_private(const rsa_private_ctx *ctx, rsa_scratch *scratch, mpz_t out, const mpz_t in) {
+    const rsa_key *key = ctx->key;
+
+    if (mpz_sgn(in) < 0 || mpz_cmp(in, key->n) >= 0) return -1;
+    mpz_mod(scratch->h, in, key->p);
+    if (ctx->have_mont) mont_powm_fixed_mpz(&ctx->mont_p, scratch->m1, scratch->h, &ctx->dP_digits);
+    else mpz_powm_sec(scratch->m1, scratch->h, key->dP, key->p);
+    mpz_mod(scratch->h, in, key->q);
+    if (ctx->have_mont) mont_powm_fixed_mpz(&ctx->mont_q, scratch->m2, scratch->h, &ctx->dQ_digits);
+    else mpz_powm_sec(scratch->m2, scratch->h, key->dQ, key->q);
+
+    mpz_sub(scratch->h, scratch->m1, scratch->m2);
+    mpz_mul(scratch->h, scratch->h, key->qInv);
+    mpz_mod(scratch->h, scratch->h, key->p);
+    mpz_mul(scratch->h, scratch->h, key->q);
+    mpz_add(out, scratch->m2, scratch->h);
+    return 0;
+}
+
+// Claims messages of the current batch until none are left
+static void batch_share(rsa_private_ctx *ctx, rsa_scratch *scratch) {
+    for (;;) {
+        size_t i = atomic_fetch_add(&ctx->next, 1);
+        if (i >= ctx->count) break;
+        if (ctx_private(ctx, scratch, ctx->out[i], ctx->in[i]) != 0) atomic_store(&ctx->rejected, 1);
+    }
+}
+
+static void *batch_helper_main(void *arg) {
+    rsa_helper_arg *helper = arg;
+    rsa_private_ctx *ctx = helper->ctx;
+    rsa_scratch *scratch = &ctx->scratch[helper->index];
+    unsigned long seen = 0;
+
+    free(helper);
+    bench_unpin();
+    pthread_mutex_lock(&ctx->lock);
+    for (;;) {
+        while (ctx->generation == seen && !ctx->shutdown) {
+            pthread_cond_wait(&ctx->job_ready, &ctx->lock);
+        }
+        if (ctx->shutdown) break;
+        seen = ctx->generation;
+        pthread_mutex_unlock(&ctx->lock);
+
+        batch_share(ctx, scratch);
+
+        pthread_mutex_lock(&ctx->lock);
+        if (--ctx->busy_helpers == 0) pthread_cond_signal(&ctx->job_done);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return NULL;
+}
+
+rsa_private_ctx *rsa_private_ctx_new(const rsa_key *key, int threads) {
+    rsa_private_ctx *ctx = calloc(1, sizeof(*ctx));
+    mp_bitcnt_t bits = mpz_sizeinbase(key->n, 2) + 2 * GMP_NUMB_BITS;
+
+    if (ctx == NULL) return NULL;
+    if (threads <= 0) threads = online_threads();
+    if (threads > MAX_SEARCH_THREADS) threads = MAX_SEARCH_THREADS;
+    ctx->key = key;
+    ctx->threads = threads;
+    ctx->have_mont = mont_ctx_init(&ctx->mont_p, key->p) == 0 && mont_ctx_init(&ctx->mont_q, key->q) == 0 &&
+                     mont_fixed_exp_init(&ctx->dP_digits, key->dP, mpz_sizeinbase(key->p, 2)) == 0 &&
+                     mont_fixed_exp_init(&ctx->dQ_digits, key->dQ, mpz_sizeinbase(key->q, 2)) == 0;
+    ctx->scratch = malloc(threads * sizeof(rsa_scratch));
+    ctx->helpers = malloc(threads * sizeof(pthread_t));
+    if (ctx->scratch == NULL || ctx->helpers == NULL) {
+        free(ctx->scratch);
+        free(ctx->helpers);
+        free(ctx);
+        return NULL;
+    }
+    for (int i = 0; i < threads; i++) {
+        mpz_init2(ctx->scratch[i].m1, bits);
+        mpz_init2(ctx->scratch[i].m2, bits);
+        mpz_init2(ctx->scratch[i].h, 2 * bits);
+    }
+
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->job_ready, NULL);
+    pthread_cond_init(&ctx->job_done, NULL);
+    // A helper that fails to start just leaves its share to the others
+    for (int i = 1; i < threads; i++) {
+        rsa_helper_arg *helper = malloc(sizeof(*helper));
+        if (helper == NULL) break;
+        helper->ctx = ctx;
+        helper->index = i;
+        if (pthread_create(&ctx->helpers[i - 1], NULL, batch_helper_main, helper) != 0) {
+            free(helper);
+            break;
+        }
+        ctx->helpers_started++;
+    }
+    return ctx;
+}
+
+void rsa_private_ctx_free(rsa_private_ctx *ctx) {
+    if (ctx == NULL) return;
+    pthread_mutex_lock(&ctx->lock);
+    ctx->shutdown = 1;
+    pthread_cond_broadcast(&ctx->job_ready);
+    pthread_mutex_unlock(&ctx->lock);
+    for (int i = 0; i < ctx->helpers_started; i++) {
+        pthread_join(ctx->helpers[i], NULL);
+    }
+    for (int i = 0; i < ctx->threads; i++) {
+        mpz_clears(ctx->scratch[i].m1, ctx->scratch[i].m2, ctx->scratch[i].h, NULL);
+    }
+    pthread_mutex_destroy(&ctx->lock);
+    pthread_cond_destroy(&ctx->job_ready);
+    pthread_cond_destroy(&ctx->job_done);
+    free(ctx->scratch);
+    free(ctx->helpers);
+    free(ctx);
+}
+
+int rsa_private_ctx_op(rsa_private_ctx *ctx, mpz_t out, const mpz_t in) {
+    return ctx_private(ctx, &ctx->scratch[0], out, in);
+}
+
+int rsa_private_batch(rsa_private_ctx *ctx, mpz_t *out, mpz_t *in, size_t count) {
+    ctx->out = out;
+    ctx->in = in;
+    ctx->count = count;
+    atomic_store(&ctx->next, 0);
+    atomic_store(&ctx->rejected, 0);
+
+    // A single message is not worth waking the pool for
+    if (count < 2 || ctx->helpers_started == 0) {
+        batch_share(ctx, &ctx->scratch[0]);
+        return atomic_load(&ctx->rejected) ? -1 : 0;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->busy_helpers = ctx->helpers_started;
+    ctx->generation++;
+    pthread_cond_broadcast(&ctx->job_ready);
+    pthread_mutex_unlock(&ctx->lock);
+
+    batch_share(ctx, &ctx->scratch[0]);
+
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->busy_helpers > 0) {
+        pthread_cond_wait(&ctx->job_done, &ctx->lock);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return atomic_load(&ctx->rejected) ? -1 : 0;
+}
+
+//==============================================================================
+// BENCHMARK
+//==============================================================================
+
+// Thread counts 1, 2, 4, ... up to max_threads, always ending on max_threads
+// itself so the full machine is measured even when it is not a power of two.
+static int next_thread_count(int threads, int max_threads) {
+    return threads < max_threads && threads * 2 > max_threads ? max_threads : threads * 2;
+}
+
+// Key generation latency per thread count for 2048, 3072 and 4096-bit
+// moduli. Key k of a size uses seed + k at every thread count, so each row
+// must produce the primes of the one-thread row.
+void benchmark_keygen_latency(unsigned long seed) {
+    static const unsigned int sizes[] = {2048, 3072, 4096};
+    int max_threads = online_threads();
+
+    printf("\n================================================================================\n");
+    printf("RSA KEY GENERATION LATENCY (p and q searched concurrently, %s)\n",
+           key_test == PRIMALITY_BPSW ? "Baillie-PSW" : "Miller-Rabin");
+    printf("================================================================================\n");
+    printf("Seed %lu, %d online CPUs, blocks of %d odd candidates\n\n", seed, online_threads(),
+           SEARCH_BLOCK_CANDIDATES);
+    printf("%8s | %7s | %4s | %12s | %12s | %14s | %7s | %13s\n", "Modulus", "Threads", "Keys", "Median ms",
+           "Mean ms", "Tested/key", "Speedup", "Same primes");
+    printf("---------+---------+------+--------------+--------------+----------------+---------+--------------\n");
+
+    mpz_t p, q;
+    mpz_inits(p, q, NULL);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        unsigned int bits = sizes[i];
+        unsigned long keys = KEYGEN_BENCH_KEYS >> i;
+        size_t initialized = 0;    // entries of reference holding a prime
+        double single_median = 0.0;
+
+        if (keys == 0) keys = 1;
+        mpz_t *reference = malloc(2 * keys * sizeof(mpz_t));
+        if (reference == NULL) break;
+        for (int threads = 1; threads <= max_threads; threads = next_thread_count(threads, max_threads)) {
+            bench_series series;
+            bench_summary summary;
+            unsigned long tested = 0;
+            int same = 1;
+
+            if (bench_series_init(&series, "keygen", keys, 0) != 0) break;
+            for (unsigned long k = 0; k < keys; k++) {
+                uint64_t start = bench_start();
+                tested += rsa_generate_primes(p, q, bits, seed + k, threads);
+                bench_series_add(&series, start, bench_stop());
+
+                if (threads == 1) {
+                    mpz_init_set(reference[2 * k], p);
+                    mpz_init_set(reference[2 * k + 1], q);
+                    initialized += 2;
+                } else {
+                    same &= mpz_cmp(reference[2 * k], p) == 0 && mpz_cmp(reference[2 * k + 1], q) == 0;
+                }
+            }
+            bench_summarize(&series, &summary);
+            bench_series_free(&series);
+            if (threads == 1) single_median = summary.median;
+
+            printf("%8u | %7d | %4lu | %12.2f | %12.2f | %14.1f | %6.2fx | %13s\n", bits, threads, keys,
+                   bench_ticks_to_ns(summary.median) / 1e6, bench_ticks_to_ns(summary.mean) / 1e6,
+                   (double)tested / keys, single_median / summary.median,
+                   threads == 1 ? "(reference)" : same ? "yes" : "NO");
+        }
+        for (size_t k = 0; k < initialized; k++) mpz_clear(reference[k]);
+        free(reference);
+    }
+    mpz_clears(p, q, NULL);
+}
+
+// Private operations (sign/decrypt) with and without the CRT, and public
+// operations (verify/encrypt) with e = 65537, on one key per size. Every
+// timed private result is checked against the public operation.
+void benchmark_rsa_throughput(unsigned long seed) {
+    static const unsigned int sizes[] = {1024, 2048, 3072, 4096};
     gmp_randstate_t state;
-    gmp_randinit_default(state);
+    rsa_key key;
+    mpz_t message, result, check;
 
-    // Seed the generator (using time for simplicity, but for security, use a better source)
-    gmp_randseed_ui(state, time(NULL));
+    printf("\n================================================================================\n");
+    printf("RSA THROUGHPUT (raw RSA, e = %d, operations per second)\n", RSA_PUBLIC_EXPONENT);
+    printf("================================================================================\n");
+    printf("%8s | %5s | %16s | %16s | %7s | %16s\n", "Modulus", "Ops", "Private (CRT)", "Private (d)",
+           "CRT", "Public");
+    printf("---------+-------+------------------+------------------+---------+-----------------\n");
 
-    mpz_t prime_candidate, prime;
-    mpz_inits(prime_candidate, prime, NULL);
+    gmp_randinit_mt(state);
+    gmp_randseed_ui(state, seed);
+    rsa_key_init(&key);
+    mpz_inits(message, result, check, NULL);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        unsigned long ops = RSA_BENCH_OPS >> i;
+        double median[3];
+        int verified = 1;
 
-    // Generate a random 512-bit number
-    mpz_urandomb(prime_candidate, state, 511);
-    mpz_setbit(prime_candidate, 511); // Ensure it's a 512-bit number
-    mpz_setbit(prime_candidate, 0);    // Ensure it's odd
+        if (rsa_generate_key(&key, sizes[i], seed + i, online_threads()) != 0) continue;
+        for (int op = 0; op < 3; op++) {
+            bench_series series;
+            bench_summary summary;
 
-    // Find the next prime number
-    mpz_nextprime(prime, prime_candidate);
+            // Public operations are cheap: time more of them
+            if (bench_series_init(&series, "rsa", op == 2 ? 8 * ops : ops, BENCH_WARMUP_RUNS) != 0) break;
+            for (size_t run = 0; run < bench_series_total(&series); run++) {
+                mpz_urandomm(message, state, key.n);
+                bench_region region;
+                bench_region_begin(&region);
+                if (op == 0) rsa_private(&key, result, message);
+                else if (op == 1) rsa_private_no_crt(&key, result, message);
+                else rsa_public(&key, result, message);
+                bench_region_end(&series, &region);
+
+                if (op < 2) {
+                    rsa_public(&key, check, result);
+                    verified &= mpz_cmp(check, message) == 0;
+                }
+            }
+            bench_summarize(&series, &summary);
+            bench_series_free(&series);
+            median[op] = summary.median;
+        }
+
+        printf("%8u | %5lu | %16.1f | %16.1f | %6.2fx | %16.1f%s\n", key.bits, ops,
+               1e9 / bench_ticks_to_ns(median[0]), 1e9 / bench_ticks_to_ns(median[1]), median[1] / median[0],
+               1e9 / bench_ticks_to_ns(median[2]), verified ? "" : "  RESULTS WRONG");
+    }
+    mpz_clears(message, result, check, NULL);
+    rsa_key_clear(&key);
+    gmp_randclear(state);
+}
+
+// Signatures per second at batch sizes 1 to BATCH_BENCH_MAX on one key:
+// rsa_private() per message, the context on one thread, and the context's
+// pool. Each point signs at least 256 messages; batch outputs are checked
+// against rsa_private().
+void benchmark_batch_signing(unsigned long seed) {
+    enum { PER_MESSAGE, CONTEXT_SINGLE, CONTEXT_POOL, VARIANTS };
+    int pool_threads = online_threads();
+    rsa_private_ctx *contexts[VARIANTS] = {NULL};
+    gmp_randstate_t state;
+    rsa_key key;
+    mpz_t in[BATCH_BENCH_MAX], out[BATCH_BENCH_MAX], check;
+
+    rsa_key_init(&key);
+    if (rsa_generate_key(&key, BATCH_BENCH_BITS, seed, pool_threads) != 0) {
+        rsa_key_clear(&key);
+        return;
+    }
+    contexts[CONTEXT_SINGLE] = rsa_private_ctx_new(&key, 1);
+    contexts[CONTEXT_POOL] = rsa_private_ctx_new(&key, pool_threads);
+    if (contexts[CONTEXT_SINGLE] == NULL || contexts[CONTEXT_POOL] == NULL) {
+        rsa_private_ctx_free(contexts[CONTEXT_SINGLE]);
+        rsa_private_ctx_free(contexts[CONTEXT_POOL]);
+        rsa_key_clear(&key);
+        return;
+    }
+    gmp_randinit_mt(state);
+    gmp_randseed_ui(state, seed);
+    mpz_init(check);
+    for (int i = 0; i < BATCH_BENCH_MAX; i++) {
+        mpz_init(out[i]);
+        mpz_init(in[i]);
+        mpz_urandomm(in[i], state, key.n);
+    }
+
+    printf("\n================================================================================\n");
+    printf("BATCH SIGNING (%u-bit key, %s Montgomery contexts for p and q)\n", key.bits,
+           contexts[CONTEXT_POOL]->have_mont ? contexts[CONTEXT_POOL]->mont_p.kernel : "no");
+    printf("================================================================================\n");
+    printf("%6s | %4s | %18s | %18s | %18s | %7s\n", "Batch", "Runs", "rsa_private sig/s", "Context sig/s",
+           "Pool sig/s", "Speedup");
+    printf("-------+------+--------------------+--------------------+--------------------+--------\n");
+
+    for (int size = 1; size <= BATCH_BENCH_MAX; size *= 4) {
+        int runs = size >= 256 ? 1 : 256 / size;
+        double rate[VARIANTS];
+        int verified = 1;
+
+        for (int variant = 0; variant < VARIANTS; variant++) {
+            bench_series series;
+            bench_summary summary;
+
+            if (bench_series_init(&series, "batch", runs, 0) != 0) break;
+            for (int run = 0; run < runs; run++) {
+                uint64_t start = bench_start();
+                if (variant == PER_MESSAGE) {
+                    for (int i = 0; i < size; i++) rsa_private(&key, out[i], in[i]);
+                } else {
+                    rsa_private_batch(contexts[variant], out, in, size);
+                }
+                bench_series_add(&series, start, bench_stop());
+            }
+            bench_summarize(&series, &summary);
+            bench_series_free(&series);
+            rate[variant] = size * 1e9 / bench_ticks_to_ns(summary.median);
+
+            for (int i = 0; i < size; i++) {
+                rsa_public(&key, check, out[i]);
+                verified &= mpz_cmp(check, in[i]) == 0;
+            }
+        }
+        printf("%6d | %4d | %18.1f | %18.1f | %18.1f | %6.2fx%s\n", size, runs, rate[PER_MESSAGE],
+               rate[CONTEXT_SINGLE], rate[CONTEXT_POOL], rate[CONTEXT_POOL] / rate[PER_MESSAGE],
+               verified ? "" : "  RESULTS WRONG");
+    }
+    printf("Pool: %d threads\n", pool_threads);
+
+    for (int i = 0; i < BATCH_BENCH_MAX; i++) mpz_clears(in[i], out[i], NULL);
+    mpz_clear(check);
+    gmp_randclear(state);
+    rsa_private_ctx_free(contexts[CONTEXT_SINGLE]);
+    rsa_private_ctx_free(contexts[CONTEXT_POOL]);
+    rsa_key_clear(&key);
+}
+
+#ifndef BENCH_DRIVER
+//==============================================================================
+// MAIN FUNCTION
+//==============================================================================
+
+BENCH_HOST_DEFINE;
+
+int main() {
+    const char *seed_override = getenv("RSA_SEED");
+    const char *threads_override = getenv("RSA_THREADS");
+    unsigned long seed = seed_override ? strtoul(seed_override, NULL, 0) : (unsigned long)time(NULL);
+    int threads = threads_override ? atoi(threads_override) : online_threads();
+    const char *test_override = getenv("RSA_TEST");
+    if (test_override != NULL && strcmp(test_override, "miller-rabin") == 0) key_test = PRIMALITY_MILLER_RABIN;
+
+    gmp_randinit_mt(global_state);
+    gmp_randseed_ui(global_state, seed);
+    bench_init();
+
+    rsa_key key;
+    mpz_t p, q, message, ciphertext, decrypted;
+    rsa_key_init(&key);
+    mpz_inits(p, q, message, ciphertext, decrypted, NULL);
+
+    uint64_t start = bench_start();
+    unsigned long tested = rsa_generate_primes(p, q, MODULUS_BITS, seed, threads);
+    uint64_t ticks = bench_stop() - start;
 
     // (Optional) Perform an additional primality test
     int reps = 25; // Number of Miller-Rabin iterations
-    if (mpz_probab_prime_p(prime, reps) == 0) {
-        fprintf(stderr, "Error: mpz_nextprime returned a composite number!\n");
+    if (mpz_probab_prime_p(p, reps) == 0 || mpz_probab_prime_p(q, reps) == 0) {
+        fprintf(stderr, "Error: the prime search returned a composite number!\n");
+        exit(EXIT_FAILURE);
+    }
+    if (rsa_key_from_primes(&key, p, q) != 0) {
+        fprintf(stderr, "Error: e = %d is not invertible for these primes!\n", RSA_PUBLIC_EXPONENT);
         exit(EXIT_FAILURE);
-    } else {
-        printf("Found a 512-bit prime:\n");
-        gmp_printf("%Zd\n", prime);
     }
+    printf("Found two %u-bit primes on %d threads in %.2f ms (%lu candidates tested, seed %lu):\n",
+           MODULUS_BITS / 2, threads, bench_ticks_to_ns(ticks) / 1e6, tested, seed);
+    gmp_printf("p = %Zx\nq = %Zx\n", key.p, key.q);
+    printf("n = p*q has %u bits, e = %d, d has %zu bits\n", key.bits, RSA_PUBLIC_EXPONENT,
+           mpz_sizeinbase(key.d, 2));
 
-mpz_clears(prime_candidate, prime, NULL);
-    gmp_randclear(state);
+    // Round trip of a short message read as a big-endian integer
+    const char *text = "RSA with CRT private operations";
+    mpz_import(message, strlen(text), 1, 1, 0, 0, text);
+    rsa_public(&key, ciphertext, message);
+    rsa_private(&key, decrypted, ciphertext);
+    gmp_printf("Encrypted \"%s\": %Zx\n", text, ciphertext);
+    printf("Decrypted with CRT: %s\n", mpz_cmp(message, decrypted) == 0 ? "matches" : "MISMATCH");
+
+    benchmark_keygen_latency(seed);
+    benchmark_rsa_throughput(seed);
+    benchmark_batch_signing(seed);
+
+    mpz_clears(p, q, message, ciphertext, decrypted, NULL);
+    rsa_key_clear(&key);
+    gmp_randclear(global_state);
 
     return 0;
 }
+#endif
@@ -0,0 +1,76 @@
+#ifndef RSA_H
+#define RSA_H
+
+#include <gmp.h>
+
+// RSA key generation and the raw RSA primitives from rsa.c. Build rsa.c
+// with -DBENCH_DRIVER to leave its main out and link it into another
+// program (rabin.c must be linked too). The operations are textbook RSA on
+// integers below n: padding, if any, is the caller's job.
+
+#define RSA_PUBLIC_EXPONENT 65537
+
+typedef struct {
+    unsigned int bits;  // of n
+    mpz_t n;
+    mpz_t e;
+    mpz_t d;            // e^-1 mod lcm(p-1, q-1)
+    mpz_t p;
+    mpz_t q;
+    mpz_t dP;           // d mod (p-1)
+    mpz_t dQ;           // d mod (q-1)
+    mpz_t qInv;         // q^-1 mod p
+} rsa_key;
+
+void rsa_key_init(rsa_key *key);
+void rsa_key_clear(rsa_key *key);
+
+// p and q for a modulus_bits-bit n, with p-1 and q-1 coprime to e. Returns
+// the number of candidates tested.
+unsigned long rsa_generate_primes(mpz_t p, mpz_t q, unsigned int modulus_bits, unsigned long seed, int threads);
+
+// Fills in the whole key from two distinct primes; -1 if e is not invertible
+int rsa_key_from_primes(rsa_key *key, const mpz_t p, const mpz_t q);
+
+// Deterministic for a given seed, whatever the thread count. Returns 0, or
+// -1 if the key could not be completed.
+int rsa_generate_key(rsa_key *key, unsigned int modulus_bits, unsigned long seed, int threads);
+
+// out = in^e mod n (encrypt, verify). Returns -1 if in >= n.
+int rsa_public(const rsa_key *key, mpz_t out, const mpz_t in);
+
+// out = in^d mod n (decrypt, sign) through the CRT: two half-size
+// exponentiations with dP and dQ, recombined with qInv. Returns -1 if in >= n.
+// Uses GMP's variable-time mpz_powm, so its timing depends on the private
+// exponent; signing with an exposed key should go through a context.
+int rsa_private(const rsa_key *key, mpz_t out, const mpz_t in);
+
+// The same result as rsa_private, straight from d; the reference it is
+// measured and checked against
+int rsa_private_no_crt(const rsa_key *key, mpz_t out, const mpz_t in);
+
+// Context for many private operations with one key. The Montgomery
+// parameters of p and q are computed once, every thread owns preallocated
+// scratch, and batches run on a pool of threads kept for the context's
+// lifetime. The key must outlive the context. One context serves one
+// caller at a time.
+//
+// The exponentiations by dP and dQ use a fixed window over exponents
+// recoded when the context is created, selecting table entries without
+// secret-dependent addresses, so their timing does not follow the bits of
+// the private exponent. The input reduction and the CRT recombination still
+// use GMP's ordinary (variable-time) arithmetic.
+typedef struct rsa_private_ctx rsa_private_ctx;
+
+// threads <= 0: one per online CPU. Returns NULL if out of memory.
+rsa_private_ctx *rsa_private_ctx_new(const rsa_key *key, int threads);
+void rsa_private_ctx_free(rsa_private_ctx *ctx);
+
+// rsa_private() through the context, on the calling thread
+int rsa_private_ctx_op(rsa_private_ctx *ctx, mpz_t out, const mpz_t in);
+
+// out[i] = in[i]^d mod n for every i, spread over the pool. Returns -1 if
+// any input was out of range (its output is left unchanged), else 0.
+int rsa_private_batch(rsa_private_ctx *ctx, mpz_t *out, mpz_t *in, size_t count);
+
+#endif
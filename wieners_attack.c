@@ -1,136 +1,369 @@
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
 #include <gmp.h>
 
+// Wiener's attack on RSA keys with a small private exponent, interactively
+// for one key or as a batch scan over a file of public keys.
+//
+// Build: gcc -O2 wieners_attack.c -lgmp -pthread
+//
+// Batch mode: wieners_attack -b keys.txt [-o vulnerable.txt] [-t threads]
+// Every line of the input holds N and e, decimal or 0x-prefixed hex,
+// separated by spaces or a comma; blank lines and lines starting with '#' are
+// skipped. Only the vulnerable keys are written out, one per line as
+// "line N e d p q". Lines are handed out in chunks to a pool of threads, so
+// the output is not in input order. The keys/sec summary goes to stderr.
+
 #define MAX_CF_TERMS 2048 // Should be enough for continued fraction terms for normal key sizes
+#define SCAN_CHUNK_LINES 64
+#define MAX_SCAN_THREADS 64
 
-// Function to run Wiener's attack given N and e
-void run_attack(mpz_t N, mpz_t e) {
+// Working values of one attack, allocated once per thread and reused for
+// every key it checks
+typedef struct {
+    mpz_t num, den, q, r, limit;
+    mpz_t p_prev2, p_prev1, p_curr;
+    mpz_t q_prev2, q_prev1, q_curr;
+    mpz_t lhs, phi, S, discr, sqrt_discr, tmp;
+} wiener_scratch;
+
+static void wiener_scratch_init(wiener_scratch *s) {
+    mpz_inits(s->num, s->den, s->q, s->r, s->limit, s->p_prev2, s->p_prev1, s->p_curr, s->q_prev2, s->q_prev1,
+              s->q_curr, s->lhs, s->phi, s->S, s->discr, s->sqrt_discr, s->tmp, NULL);
+}
+
+static void wiener_scratch_clear(wiener_scratch *s) {
+    mpz_clears(s->num, s->den, s->q, s->r, s->limit, s->p_prev2, s->p_prev1, s->p_curr, s->q_prev2, s->q_prev1,
+               s->q_curr, s->lhs, s->phi, s->S, s->discr, s->sqrt_discr, s->tmp, NULL);
+}
+
+// Looks for d among the convergents of e/N. Returns 1 and sets d, p and q if
+// N = p*q was factored, else 0.
+static int wiener_recover(wiener_scratch *s, const mpz_t N, const mpz_t e, mpz_t d, mpz_t p, mpz_t q) {
     // If e < N, we will work with N/e instead of e/N and later swap k and d
     int use_reciprocal = (mpz_cmp(e, N) < 0);
 
-    mpz_t num, den, q, r;
-    mpz_inits(num, den, q, r, NULL);
-
     if (!use_reciprocal) {
-        mpz_set(num, e);
-        mpz_set(den, N);
+        mpz_set(s->num, e);
+        mpz_set(s->den, N);
     } else {
-        mpz_set(num, N);
-        mpz_set(den, e);
-    }
-    
-    // Array to store continued fraction terms a[0], a[1], ...
-    mpz_t a[MAX_CF_TERMS];
-    int cf_len = 0;
-    for (int i = 0; i < MAX_CF_TERMS; ++i) mpz_init(a[i]);
-
-    // Euclidean algorithm to get continued fraction expansion
-    while (mpz_cmp_ui(den, 0) != 0 && cf_len < MAX_CF_TERMS) {
-        mpz_fdiv_q(q, num, den);
-        mpz_set(a[cf_len++], q);
-        mpz_mod(r, num, den);
-        mpz_set(num, den);
-        mpz_set(den, r);
+        mpz_set(s->num, N);
+        mpz_set(s->den, e);
     }
 
-    // Variables for convergent generation (p/q form)
-    mpz_t p_prev2, p_prev1, p_curr;
-    mpz_t q_prev2, q_prev1, q_curr;
-    mpz_inits(p_prev2, p_prev1, p_curr, q_prev2, q_prev1, q_curr, NULL);
-    mpz_set_ui(p_prev2, 0);
-    mpz_set_ui(p_prev1, 1);
-    mpz_set_ui(q_prev2, 1);
-    mpz_set_ui(q_prev1, 0);
+    // A convergent k/d of e/N is within 1/d^2 of it, while a real key has
+    // |e/N - k/d| = |k(p+q-1) - 1| / dN with p+q >= 2*sqrt(N). Both hold only
+    // for d <= sqrt(N), so the search stops there.
+    mpz_sqrt(s->limit, N);
 
-     // Extra vars for testing each convergent
-    mpz_t cand_k, cand_d, lhs, phi, S, discr, sqrt_discr, p, qv, tmp, one, prod;
-    mpz_inits(cand_k, cand_d, lhs, phi, S, discr, sqrt_discr, p, qv, tmp, one, prod, NULL);
-    mpz_set_ui(one, 1);
+    // Variables for convergent generation (p/q form)
+    mpz_set_ui(s->p_prev2, 0);
+    mpz_set_ui(s->p_prev1, 1);
+    mpz_set_ui(s->q_prev2, 1);
+    mpz_set_ui(s->q_prev1, 0);
 
-    int found = 0;
+    // Euclidean algorithm, one continued fraction term a[i] = q at a time;
+    // each term is turned into the next convergent and tested right away
+    for (int i = 0; i < MAX_CF_TERMS && mpz_sgn(s->den) != 0; ++i) {
+        mpz_fdiv_qr(s->q, s->r, s->num, s->den);
+        mpz_swap(s->num, s->den);
+        mpz_swap(s->den, s->r);
 
-    // Loop through each CF term and test
-    for (int i = 0; i < cf_len; ++i) {
         // Generate next convergent
-        mpz_mul(tmp, a[i], p_prev1);
-        mpz_add(p_curr, tmp, p_prev2);
+        mpz_mul(s->tmp, s->q, s->p_prev1);
+        mpz_add(s->p_curr, s->tmp, s->p_prev2);
 
-        mpz_mul(tmp, a[i], q_prev1);
-        mpz_add(q_curr, tmp, q_prev2);
+        mpz_mul(s->tmp, s->q, s->q_prev1);
+        mpz_add(s->q_curr, s->tmp, s->q_prev2);
 
         // Shift previous values for next iteration
-        mpz_set(p_prev2, p_prev1);
-        mpz_set(p_prev1, p_curr);
-        mpz_set(q_prev2, q_prev1);
-        mpz_set(q_prev1, q_curr);
+        mpz_swap(s->p_prev2, s->p_prev1);
+        mpz_swap(s->p_prev1, s->p_curr);
+        mpz_swap(s->q_prev2, s->q_prev1);
+        mpz_swap(s->q_prev1, s->q_curr);
 
         // Depending on reciprocal choice, set candidate k and d
-        if (!use_reciprocal) {
-            mpz_set(cand_k, p_curr);
-            mpz_set(cand_d, q_curr);
-        } else {
-            mpz_set(cand_k, q_curr);
-            mpz_set(cand_d, p_curr);
-        }
+        const __mpz_struct *cand_k = use_reciprocal ? s->q_prev1 : s->p_prev1;
+        const __mpz_struct *cand_d = use_reciprocal ? s->p_prev1 : s->q_prev1;
 
         // If d is zero, skip (invalid)
-        if (mpz_cmp_ui(cand_d, 0) == 0)
+        if (mpz_sgn(cand_d) == 0)
             continue;
+        if (mpz_cmp(cand_d, s->limit) > 0)
+            break;
 
         // ed - 1 must be divisible by k
-        mpz_mul(lhs, e, cand_d);
-        mpz_sub_ui(lhs, lhs, 1);
+        mpz_mul(s->lhs, e, cand_d);
+        mpz_sub_ui(s->lhs, s->lhs, 1);
 
-        if (!mpz_divisible_p(lhs, cand_k))
+        if (mpz_sgn(cand_k) == 0 || !mpz_divisible_p(s->lhs, cand_k))
             continue;
 
         // phi(N) candidate
-        mpz_divexact(phi, lhs, cand_k);
+        mpz_divexact(s->phi, s->lhs, cand_k);
 
         // S = p + q
-        mpz_sub(S, N, phi);
-        mpz_add(S, S, one);
+        mpz_sub(s->S, N, s->phi);
+        mpz_add_ui(s->S, s->S, 1);
 
         // discriminant = S^2 - 4N
-        mpz_mul(discr, S, S);
-        mpz_mul_ui(tmp, N, 4);
-        mpz_sub(discr, discr, tmp);
+        mpz_mul(s->discr, s->S, s->S);
+        mpz_submul_ui(s->discr, N, 4);
 
         // Negative discriminant or not perfect square => not valid
-        if (mpz_sgn(discr) < 0 || !mpz_perfect_square_p(discr))
+        if (mpz_sgn(s->discr) < 0 || !mpz_perfect_square_p(s->discr))
             continue;
 
-        mpz_sqrt(sqrt_discr, discr);
+        mpz_sqrt(s->sqrt_discr, s->discr);
 
         // Solve for p and q
-        mpz_add(tmp, S, sqrt_discr);
-        mpz_fdiv_q_2exp(p, tmp, 1); // divide by 2
+        mpz_add(s->tmp, s->S, s->sqrt_discr);
+        mpz_fdiv_q_2exp(p, s->tmp, 1); // divide by 2
 
-        mpz_sub(tmp, S, sqrt_discr);
-        mpz_fdiv_q_2exp(qv, tmp, 1);    // divide by 2
+        mpz_sub(s->tmp, s->S, s->sqrt_discr);
+        mpz_fdiv_q_2exp(q, s->tmp, 1);    // divide by 2
 
         // Check if p*q == N (extra safety)
-        mpz_mul(prod, p, qv);
-        if (mpz_cmp(prod, N) == 0) {
-            printf("\n[+] SUCCESS: recovered keys\n");
-            gmp_printf("    private d = %Zd\n", cand_d);
-            gmp_printf("    p = %Zd\n", p);
-            gmp_printf("    q = %Zd\n", qv);
-            found = 1;
-            break;
+        mpz_mul(s->tmp, p, q);
+        if (mpz_cmp(s->tmp, N) == 0) {
+            mpz_set(d, cand_d);
+            return 1;
         }
     }
+    return 0;
+}
 
-    if (!found) {
+// Function to run Wiener's attack given N and e
+void run_attack(mpz_t N, mpz_t e) {
+    wiener_scratch scratch;
+    mpz_t d, p, q;
+
+    wiener_scratch_init(&scratch);
+    mpz_inits(d, p, q, NULL);
+
+    if (mpz_sgn(N) > 0 && mpz_sgn(e) > 0 && wiener_recover(&scratch, N, e, d, p, q)) {
+        printf("\n[+] SUCCESS: recovered keys\n");
+        gmp_printf("    private d = %Zd\n", d);
+        gmp_printf("    p = %Zd\n", p);
+        gmp_printf("    q = %Zd\n", q);
+    } else {
         printf("\n[-] No solution found. Either d is not small enough or inputs are invalid.\n");
     }
 
-    for (int i = 0; i < MAX_CF_TERMS; ++i) mpz_clear(a[i]);
-    mpz_clears(num, den, q, r, p_prev2, p_prev1, p_curr, q_prev2, q_prev1, q_curr,
-               cand_k, cand_d, lhs, phi, S, discr, sqrt_discr, p, qv, tmp, one, prod, NULL);
+    mpz_clears(d, p, q, NULL);
+    wiener_scratch_clear(&scratch);
+}
+
+//==============================================================================
+// BATCH SCAN
+//==============================================================================
+
+typedef struct {
+    FILE *in;
+    FILE *out;
+    pthread_mutex_t in_lock;    // guards in, next_line and input_error
+    pthread_mutex_t out_lock;   // guards out
+    unsigned long next_line;
+    int input_error;
+    atomic_ulong keys;
+    atomic_ulong vulnerable;
+    atomic_ulong malformed;
+} scan_job;
+
+typedef struct {
+    unsigned long keys;
+    unsigned long vulnerable;
+    unsigned long malformed;
+    int threads;
+    double seconds;
+} scan_stats;
+
+typedef struct {
+    char *line[SCAN_CHUNK_LINES];
+    size_t capacity[SCAN_CHUNK_LINES];
+} scan_chunk;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Reads up to SCAN_CHUNK_LINES lines; returns how many, and the number of
+// the first one through first_line
+static int read_chunk(scan_job *job, scan_chunk *chunk, unsigned long *first_line) {
+    int count = 0;
+
+    pthread_mutex_lock(&job->in_lock);
+    *first_line = job->next_line;
+    while (count < SCAN_CHUNK_LINES && getline(&chunk->line[count], &chunk->capacity[count], job->in) >= 0) {
+        count++;
+    }
+    if (count < SCAN_CHUNK_LINES && ferror(job->in)) job->input_error = 1;
+    job->next_line += count;
+    pthread_mutex_unlock(&job->in_lock);
+    return count;
+}
+
+// Splits "N e" or "N,e" in place. Returns 1 for a key, 0 for a line to skip,
+// -1 for a malformed line.
+static int parse_key_line(char *line, mpz_t N, mpz_t e) {
+    char *save = NULL;
+    char *n_text = strtok_r(line, " \t,\r\n", &save);
+    if (n_text == NULL || n_text[0] == '#') return 0;
+
+    char *e_text = strtok_r(NULL, " \t,\r\n", &save);
+    if (e_text == NULL || strtok_r(NULL, " \t,\r\n", &save) != NULL) return -1;
+    if (mpz_set_str(N, n_text, 0) != 0 || mpz_set_str(e, e_text, 0) != 0) return -1;
+    return mpz_cmp_ui(N, 4) > 0 && mpz_sgn(e) > 0 ? 1 : -1;
+}
+
+static void *scan_worker(void *arg) {
+    scan_job *job = arg;
+    wiener_scratch scratch;
+    scan_chunk chunk = {{NULL}, {0}};
+    mpz_t N, e, d, p, q;
+    unsigned long first_line;
+    int count;
+
+    wiener_scratch_init(&scratch);
+    mpz_inits(N, e, d, p, q, NULL);
+
+    while ((count = read_chunk(job, &chunk, &first_line)) > 0) {
+        unsigned long keys = 0, vulnerable = 0, malformed = 0;
+
+        for (int i = 0; i < count; i++) {
+            int parsed = parse_key_line(chunk.line[i], N, e);
+            if (parsed < 0) malformed++;
+            if (parsed <= 0) continue;
+
+            keys++;
+            if (!wiener_recover(&scratch, N, e, d, p, q)) continue;
+            vulnerable++;
+            pthread_mutex_lock(&job->out_lock);
+            gmp_fprintf(job->out, "%lu %Zd %Zd %Zd %Zd %Zd\n", first_line + i + 1, N, e, d, p, q);
+            pthread_mutex_unlock(&job->out_lock);
+        }
+        atomic_fetch_add(&job->keys, keys);
+        atomic_fetch_add(&job->vulnerable, vulnerable);
+        atomic_fetch_add(&job->malformed, malformed);
+    }
+
+    for (int i = 0; i < SCAN_CHUNK_LINES; i++) free(chunk.line[i]);
+    mpz_clears(N, e, d, p, q, NULL);
+    wiener_scratch_clear(&scratch);
+    return NULL;
+}
+
+// Checks every key in in and writes the vulnerable ones to out. threads <= 0:
+// one per online CPU. Returns 0, or -1 if the input could not be read.
+int scan_keys(FILE *in, FILE *out, int threads, scan_stats *stats) {
+    pthread_t helpers[MAX_SCAN_THREADS];
+    int started = 0;
+    scan_job job;
+
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online < 1 ? 1 : (int)online;
+    }
+    if (threads > MAX_SCAN_THREADS) threads = MAX_SCAN_THREADS;
+
+    job.in = in;
+    job.out = out;
+    pthread_mutex_init(&job.in_lock, NULL);
+    pthread_mutex_init(&job.out_lock, NULL);
+    job.next_line = 0;
+    job.input_error = 0;
+    atomic_init(&job.keys, 0);
+    atomic_init(&job.vulnerable, 0);
+    atomic_init(&job.malformed, 0);
+
+    double start = now_seconds();
+    // The caller is worker 0; a helper that fails to start leaves its lines
+    // to the others
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&helpers[started], NULL, scan_worker, &job) == 0) started++;
+    }
+    scan_worker(&job);
+    for (int t = 0; t < started; t++) pthread_join(helpers[t], NULL);
+    fflush(out);
+
+    stats->seconds = now_seconds() - start;
+    stats->threads = started + 1;
+    stats->keys = atomic_load(&job.keys);
+    stats->vulnerable = atomic_load(&job.vulnerable);
+    stats->malformed = atomic_load(&job.malformed);
+    pthread_mutex_destroy(&job.in_lock);
+    pthread_mutex_destroy(&job.out_lock);
+    return job.input_error ? -1 : 0;
+}
+
+static int scan_file(const char *in_path, const char *out_path, int threads) {
+    FILE *in = fopen(in_path, "r");
+    if (in == NULL) {
+        perror(in_path);
+        return 1;
+    }
+    FILE *out = out_path != NULL ? fopen(out_path, "w") : stdout;
+    if (out == NULL) {
+        perror(out_path);
+        fclose(in);
+        return 1;
+    }
+
+    scan_stats stats;
+    int rc = scan_keys(in, out, threads, &stats);
+    if (rc != 0) fprintf(stderr, "%s: read error, scan incomplete\n", in_path);
+    fprintf(stderr, "Scanned %lu keys in %.3f s on %d threads: %.1f keys/s, %lu vulnerable, %lu malformed lines\n",
+            stats.keys, stats.seconds, stats.threads, stats.seconds > 0 ? stats.keys / stats.seconds : 0.0,
+            stats.vulnerable, stats.malformed);
+
+    fclose(in);
+    if (out != stdout && fclose(out) != 0) {
+        perror(out_path);
+        rc = -1;
+    }
+    return rc != 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s                   interactive menu\n"
+            "       %s -b keys.txt [-o vulnerable.txt] [-t threads]\n"
+            "  -b  scan every (N, e) line of keys.txt\n"
+            "  -o  write the vulnerable keys here instead of stdout\n"
+            "  -t  scanning threads, default one per online CPU\n",
+            program, program);
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+    const char *batch_path = NULL, *out_path = NULL;
+    int threads = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:o:t:")) != -1) {
+        switch (opt) {
+        case 'b': batch_path = optarg; break;
+        case 'o': out_path = optarg; break;
+        case 't': threads = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind != argc || (batch_path == NULL && (out_path != NULL || threads != 0))) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (batch_path != NULL) return scan_file(batch_path, out_path, threads);
+
     mpz_t N, e;
     mpz_inits(N, e, NULL);
 
@@ -138,9 +371,20 @@ int main(void) {
     printf("Select mode:\n");
     printf("  1) Manual input\n");
     printf("  2) Paper example (p=113, q=79, d=5, e=6989)\n");
+    printf("  3) Batch scan of a key file\n");
     printf("Choice: ");
     int choice;
-    scanf("%d", &choice);
+    if (scanf("%d", &choice) != 1) choice = 2;
+
+    if (choice == 3) {
+        char in_name[4096], out_name[4096];
+        printf("Key file (one \"N e\" per line): ");
+        if (scanf("%4095s", in_name) != 1) return 1;
+        printf("Output file for vulnerable keys: ");
+        if (scanf("%4095s", out_name) != 1) return 1;
+        mpz_clears(N, e, NULL);
+        return scan_file(in_name, out_name, 0);
+    }
 
     if (choice == 1) {
         printf("Enter modulus N: ");
@@ -154,5 +398,6 @@ int main(void) {
     }
 
     run_attack(N, e);
+    mpz_clears(N, e, NULL);
     return 0;
 }